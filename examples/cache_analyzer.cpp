@@ -5,14 +5,16 @@
 #include <algorithm>
 #include "core/engine.hpp"
 #include "tools/cache_sim.hpp"
+#include "tools/stack_distance.hpp"
 
 // For generating spectrograms
 struct SpectrogramConfig {
-    uint32_t time_bins;     // Number of time divisions
-    uint32_t addr_bins;     // Number of address space divisions
-    uint32_t color_max;     // Maximum intensity value
+    uint32_t time_bins{0};  // Maximum number of time divisions
+    uint32_t addr_bins{0};  // Maximum number of address space divisions
+    uint32_t color_max{0};  // Maximum intensity value
 };
 
+template <typename Policy>
 class CacheAnalyzer {
 public:
     CacheAnalyzer(const rvpin::tools::CacheConfig& cache_config,
@@ -20,61 +22,40 @@ public:
         : cache_(cache_config), spec_config_(spec_config) {}
     
     void onMemoryAccess(uint64_t addr, bool is_write, uint32_t size) {
-        cache_.access(addr, is_write, size);
+        cache_.access(0, addr, is_write, size);
     }
     
+    // The cache bins accesses as they happen (see AccessHistogram), so
+    // this only crops the address axis to the rows that were touched
     void generateSpectrogram(const std::string& filename) {
-        const auto& access_pattern = cache_.getAccessPattern();
-        if (access_pattern.empty()) return;
-        
-        // Find time range
-        uint64_t min_time = access_pattern[0].time;
-        uint64_t max_time = access_pattern[0].time;
-        uint64_t min_addr = access_pattern[0].address;
-        uint64_t max_addr = access_pattern[0].address;
-        
-        for (const auto& access : access_pattern) {
-            min_time = std::min(min_time, access.time);
-            max_time = std::max(max_time, access.time);
-            min_addr = std::min(min_addr, access.address);
-            max_addr = std::max(max_addr, access.address);
-        }
-        
-        // Create bins
-        std::vector<std::vector<uint32_t>> bins(
-            spec_config_.time_bins,
-            std::vector<uint32_t>(spec_config_.addr_bins));
-        
-        // Fill bins
-        double time_scale = static_cast<double>(spec_config_.time_bins) / (max_time - min_time);
-        double addr_scale = static_cast<double>(spec_config_.addr_bins) / (max_addr - min_addr);
-        
-        for (const auto& access : access_pattern) {
-            int time_bin = static_cast<int>((access.time - min_time) * time_scale);
-            int addr_bin = static_cast<int>((access.address - min_addr) * addr_scale);
-            
-            time_bin = std::min(time_bin, static_cast<int>(spec_config_.time_bins) - 1);
-            addr_bin = std::min(addr_bin, static_cast<int>(spec_config_.addr_bins) - 1);
-            
-            bins[time_bin][addr_bin]++;
+        const auto* histogram = cache_.getAccessHistogram();
+        if (!histogram || histogram->empty()) return;
+
+        const uint32_t time_bins = histogram->getTimeBins();
+        uint32_t min_addr_bin = histogram->getAddrBins();
+        uint32_t max_addr_bin = 0;
+        uint64_t max_count = 0;
+        for (uint32_t x = 0; x < time_bins; x++) {
+            for (uint32_t y = 0; y < histogram->getAddrBins(); y++) {
+                uint64_t count = histogram->count(x, y);
+                if (count != 0) {
+                    min_addr_bin = std::min(min_addr_bin, y);
+                    max_addr_bin = std::max(max_addr_bin, y);
+                    max_count = std::max(max_count, count);
+                }
+            }
         }
-        
+
         // Normalize and write to PGM file
         std::ofstream out(filename);
-        out << "P2\n" << spec_config_.time_bins << " " << spec_config_.addr_bins << "\n"
+        out << "P2\n" << time_bins << " " << max_addr_bin - min_addr_bin + 1 << "\n"
             << spec_config_.color_max << "\n";
-        
-        // Find maximum count for normalization
-        uint32_t max_count = 0;
-        for (const auto& row : bins) {
-            max_count = std::max(max_count, *std::max_element(row.begin(), row.end()));
-        }
-        
+
         // Write normalized values
-        for (int y = spec_config_.addr_bins - 1; y >= 0; y--) {
-            for (uint32_t x = 0; x < spec_config_.time_bins; x++) {
+        for (uint32_t y = max_addr_bin + 1; y-- > min_addr_bin;) {
+            for (uint32_t x = 0; x < time_bins; x++) {
                 uint32_t normalized = static_cast<uint32_t>(
-                    static_cast<double>(bins[x][y]) / max_count * spec_config_.color_max);
+                    static_cast<double>(histogram->count(x, y)) / max_count * spec_config_.color_max);
                 out << normalized << " ";
             }
             out << "\n";
@@ -106,15 +87,110 @@ public:
     }
     
 private:
-    rvpin::tools::Cache cache_;
+    rvpin::tools::BasicCache<Policy> cache_;
     SpectrogramConfig spec_config_;
 };
 
+template <typename Policy>
+static int analyze(int argc, char* argv[], const rvpin::tools::CacheConfig& cache_config,
+                   const SpectrogramConfig& spec_config) {
+    // Create analyzer
+    CacheAnalyzer<Policy> analyzer(cache_config, spec_config);
+    
+    // Initialize Spike and RVPin
+    auto& engine = rvpin::Engine::getInstance();
+    if (!engine.initialize(argc, argv)) {
+        std::cerr << "Failed to initialize engine\n";
+        return 1;
+    }
+    
+    // Register memory access callback
+    engine.registerMemoryAccess(
+        [&analyzer](uint64_t addr, bool is_write, uint32_t size) {
+            analyzer.onMemoryAccess(addr, is_write, size);
+        });
+    
+    // Run the program
+    int exit_code = engine.run();
+    std::cout << "Program exited with code " << exit_code << "\n";
+    
+    // Generate results
+    std::cout << "\nReplacement policy: " << Policy::NAME << "\n";
+    analyzer.printStats();
+    analyzer.generateSpectrogram("cache_access_pattern.pgm");
+    
+    std::cout << "\nGenerated spectrogram in 'cache_access_pattern.pgm'\n";
+    return 0;
+}
+
+// Every geometry in config from one run, written as CSV
+static int sweep(int argc, char* argv[], const rvpin::tools::StackDistanceConfig& config) {
+    rvpin::tools::StackDistanceProfiler profiler(config);
+
+    auto& engine = rvpin::Engine::getInstance();
+    if (!engine.initialize(argc, argv)) {
+        std::cerr << "Failed to initialize engine\n";
+        return 1;
+    }
+
+    engine.registerMemoryAccess(
+        [&profiler](uint64_t addr, bool is_write, uint32_t) {
+            profiler.access(addr, is_write);
+        });
+
+    int exit_code = engine.run();
+    std::cout << "Program exited with code " << exit_code << "\n";
+
+    std::ofstream out("cache_sweep.csv");
+    out << "sets,ways,size_bytes,accesses,misses,evictions,miss_ratio\n";
+    for (uint32_t sets : profiler.getSetCounts()) {
+        for (uint32_t ways = 1; ways <= config.max_associativity; ways++) {
+            const auto stats = profiler.getStats(sets, ways);
+            out << sets << "," << ways << "," << profiler.getCacheConfig(sets, ways).size << ","
+                << stats.reads + stats.writes << ","
+                << stats.read_misses + stats.write_misses << ","
+                << stats.evictions << "," << profiler.getMissRatio(sets, ways) << "\n";
+        }
+    }
+
+    std::cout << "\nAccesses: " << profiler.getAccesses()
+              << ", cold misses: " << profiler.getColdMisses() << "\n";
+    std::cout << "Generated LRU miss ratios for " << profiler.getSetCounts().size()
+              << " set counts x " << config.max_associativity
+              << " associativities in 'cache_sweep.csv'\n";
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <program>\n";
+    // Replacement policy names follow champsim_config.json
+    std::string replacement = "lru";
+    bool sweep_mode = false;
+    int arg = 1;
+    for (; arg < argc; arg++) {
+        const std::string option = argv[arg];
+        if (option == "--replacement" && arg + 1 < argc) {
+            replacement = argv[++arg];
+        } else if (option == "--sweep") {
+            sweep_mode = true;
+        } else {
+            break;
+        }
+    }
+    if (argc - arg != 1) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--replacement lru|plru|srrip|brrip|random|fifo] [--sweep] <program>\n"
+                  << "  --sweep  LRU miss ratios for 16-16384 sets x 1-16 ways in one run\n";
         return 1;
     }
+
+    if (sweep_mode) {
+        rvpin::tools::StackDistanceConfig sweep_config;
+        sweep_config.line_size = 64;
+        sweep_config.min_sets = 16;
+        sweep_config.max_sets = 16384;
+        sweep_config.max_associativity = 16;
+        return sweep(argc - arg, argv + arg, sweep_config);
+    }
     
     // Configure cache
     rvpin::tools::CacheConfig cache_config{
@@ -131,33 +207,18 @@ int main(int argc, char* argv[]) {
         .addr_bins = 1000,      // 1000 address space divisions
         .color_max = 255        // 8-bit grayscale
     };
+
+    // The cache bins accesses for the spectrogram as the program runs
+    cache_config.recording.mode = rvpin::tools::AccessRecordingConfig::Mode::HISTOGRAM;
+    cache_config.recording.time_bins = spec_config.time_bins;
+    cache_config.recording.addr_bins = spec_config.addr_bins;
     
-    // Create analyzer
-    CacheAnalyzer analyzer(cache_config, spec_config);
-    
-    // Initialize Spike and RVPin
-    auto& engine = rvpin::Engine::getInstance();
-    if (!engine.initialize(argc - 1, argv + 1)) {
-        std::cerr << "Failed to initialize engine\n";
-        return 1;
-    }
-    
-    // Register memory access callback
-    engine.registerMemoryAccess(
-        [&analyzer](uint64_t addr, bool is_write, uint32_t size) {
-            analyzer.onMemoryAccess(addr, is_write, size);
+    try {
+        return rvpin::tools::visitReplacementPolicy(replacement, [&](auto policy) {
+            return analyze<decltype(policy)>(argc - arg, argv + arg, cache_config, spec_config);
         });
-    
-    // Run the program
-    if (engine.run() != 0) {
-        std::cerr << "Failed to run program\n";
+    } catch (const std::invalid_argument& e) {
+        std::cerr << e.what() << "\n";
         return 1;
     }
-    
-    // Generate results
-    analyzer.printStats();
-    analyzer.generateSpectrogram("cache_access_pattern.pgm");
-    
-    std::cout << "\nGenerated spectrogram in 'cache_access_pattern.pgm'\n";
-    return 0;
 }
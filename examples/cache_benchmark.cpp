@@ -0,0 +1,152 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "tools/cache_sim.hpp"
+
+// Replays the memory accesses of cache_test.cpp against tools::Cache with
+// each replacement policy and reports simulated accesses per second.
+// Every `sum += a[i]` in the test loads the element, then loads and
+// stores the volatile accumulator.
+
+namespace {
+
+constexpr uint64_t ARRAY_SIZE = 256 * 1024;
+constexpr uint64_t STRIDE_SIZE = 64;
+constexpr uint64_t BLOCK_SIZE = 4096;
+
+// Data layout of the test program
+constexpr uint64_t SEQUENTIAL_ARRAY = 0x20000;
+constexpr uint64_t RANDOM_ARRAY = SEQUENTIAL_ARRAY + ARRAY_SIZE;
+constexpr uint64_t STRIDE_ARRAY = RANDOM_ARRAY + ARRAY_SIZE;
+constexpr uint64_t MATRIX = STRIDE_ARRAY + ARRAY_SIZE;
+constexpr uint64_t SUM = MATRIX + 512 * 512;
+
+struct Access {
+    uint64_t addr;
+    bool is_write;
+    uint32_t size;
+};
+
+class Workload {
+public:
+    std::vector<Access> build() {
+        for (uint64_t i = 0; i < ARRAY_SIZE; i++) {
+            store(SEQUENTIAL_ARRAY + i);
+            store(RANDOM_ARRAY + i);
+            store(STRIDE_ARRAY + i);
+        }
+        for (uint64_t i = 0; i < 512 * 512; i++) {
+            store(MATRIX + i);
+        }
+
+        // test_sequential_access
+        for (uint64_t i = 0; i < ARRAY_SIZE; i++) {
+            accumulate(SEQUENTIAL_ARRAY + i);
+        }
+        // test_random_access
+        std::srand(1);
+        for (uint64_t i = 0; i < ARRAY_SIZE; i++) {
+            accumulate(RANDOM_ARRAY + std::rand() % ARRAY_SIZE);
+        }
+        // test_strided_access
+        for (uint64_t stride = 1; stride <= STRIDE_SIZE; stride *= 2) {
+            for (uint64_t i = 0; i < ARRAY_SIZE; i += stride) {
+                accumulate(STRIDE_ARRAY + i);
+            }
+        }
+        // test_block_access
+        for (uint64_t block = 0; block < ARRAY_SIZE; block += BLOCK_SIZE) {
+            for (int repeat = 0; repeat < 3; repeat++) {
+                for (uint64_t i = 0; i < BLOCK_SIZE; i++) {
+                    accumulate(SEQUENTIAL_ARRAY + block + i);
+                }
+            }
+        }
+        // test_matrix_operations
+        for (uint64_t i = 0; i < 512; i++) {
+            for (uint64_t j = 0; j < 512; j++) {
+                accumulate(MATRIX + i * 512 + j);
+            }
+        }
+        for (uint64_t j = 0; j < 512; j++) {
+            for (uint64_t i = 0; i < 512; i++) {
+                accumulate(MATRIX + i * 512 + j);
+            }
+        }
+        for (uint64_t i = 0; i < 512; i++) {
+            accumulate(MATRIX + i * 512 + i);
+        }
+        // test_cache_thrashing
+        for (int repeat = 0; repeat < 1000; repeat++) {
+            for (uint64_t i = 0; i < ARRAY_SIZE; i += 16384) {
+                accumulate(SEQUENTIAL_ARRAY + i);
+            }
+        }
+        return std::move(accesses_);
+    }
+
+private:
+    void store(uint64_t addr) { accesses_.push_back({addr, true, 1}); }
+
+    void accumulate(uint64_t addr) {
+        accesses_.push_back({addr, false, 1});
+        accesses_.push_back({SUM, false, 8});
+        accesses_.push_back({SUM, true, 8});
+    }
+
+    std::vector<Access> accesses_;
+};
+
+} // namespace
+
+template <typename Policy>
+static void run(const rvpin::tools::CacheConfig& config, const std::vector<Access>& accesses,
+                int repeats) {
+    double best = 0;
+    rvpin::tools::CacheStats stats;
+    for (int r = 0; r < repeats; r++) {
+        rvpin::tools::BasicCache<Policy> cache(config);
+        auto start = std::chrono::steady_clock::now();
+        for (const Access& a : accesses) {
+            cache.access(0, a.addr, a.is_write, a.size);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::max(best, accesses.size() / elapsed.count());
+        stats = cache.getStats();
+    }
+
+    std::cout << std::left << std::setw(8) << Policy::NAME << std::right
+              << std::setw(10) << stats.read_hits + stats.write_hits
+              << std::setw(10) << stats.read_misses + stats.write_misses
+              << std::setw(10) << stats.evictions
+              << std::setw(12) << std::fixed << std::setprecision(1) << best / 1e6 << "\n";
+}
+
+int main(int argc, char* argv[]) {
+    int repeats = argc > 1 ? std::atoi(argv[1]) : 5;
+    const char* only = argc > 2 ? argv[2] : nullptr;
+    std::vector<Access> accesses = Workload().build();
+
+    rvpin::tools::CacheConfig config{};
+    config.line_size = 64;
+    config.size = 32 * 1024;
+    config.associativity = 8;
+    config.write_back = true;
+    config.write_allocate = true;
+
+    std::cout << "Accesses: " << accesses.size() << "\n";
+    std::cout << "Policy        Hits    Misses Evictions  M access/s\n";
+    const char* policies[] = {"lru", "plru", "srrip", "brrip", "random", "fifo"};
+    for (const char* name : policies) {
+        if (only && std::string(only) != name) {
+            continue;
+        }
+        rvpin::tools::visitReplacementPolicy(name, [&](auto policy) {
+            run<decltype(policy)>(config, accesses, repeats);
+        });
+    }
+    return 0;
+}
@@ -0,0 +1,137 @@
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include "api/instrumentation.hpp"
+#include "core/engine.hpp"
+#include "tools/cache_hierarchy.hpp"
+
+// Runs a program through the cache hierarchy described by a ChampSim
+// configuration and reports hits and misses for every level, so L2 and
+// LLC miss rates come out of a single run.
+
+template <typename Policy>
+class HierarchyAnalyzer {
+public:
+    explicit HierarchyAnalyzer(const rvpin::tools::CacheHierarchyConfig& config)
+        : hierarchy_(config), line_shift_(__builtin_ctz(config.block_size)) {}
+
+    // Instrumentation: one fetch per instruction cache line a block
+    // touches, and one access per load or store
+    void instrument(rvpin::api::BlockHandle& block) {
+        uint64_t line = ~0ull;
+        for (size_t i = 0; i < block.getNumInstructions(); i++) {
+            rvpin::api::InsHandle ins = block.getInstruction(i);
+            if ((ins.getAddress() >> line_shift_) != line) {
+                line = ins.getAddress() >> line_shift_;
+                ins.insertCall<onFetch>(rvpin::api::IPoint::BEFORE, this,
+                                        rvpin::api::IArg::instPtr());
+            }
+            if (ins.isMemoryRead()) {
+                ins.insertCall<onLoad>(rvpin::api::IPoint::BEFORE, this,
+                                       rvpin::api::IArg::instPtr(),
+                                       rvpin::api::IArg::memoryEa(),
+                                       rvpin::api::IArg::memorySize());
+            }
+            if (ins.isMemoryWrite()) {
+                ins.insertCall<onStore>(rvpin::api::IPoint::BEFORE, this,
+                                        rvpin::api::IArg::instPtr(),
+                                        rvpin::api::IArg::memoryEa(),
+                                        rvpin::api::IArg::memorySize());
+            }
+        }
+    }
+
+    static void onFetch(HierarchyAnalyzer* analyzer, uint64_t pc) {
+        analyzer->hierarchy_.fetch(pc);
+    }
+
+    static void onLoad(HierarchyAnalyzer* analyzer, uint64_t pc, uint64_t addr, uint32_t size) {
+        analyzer->hierarchy_.access(pc, addr, false, size);
+    }
+
+    static void onStore(HierarchyAnalyzer* analyzer, uint64_t pc, uint64_t addr, uint32_t size) {
+        analyzer->hierarchy_.access(pc, addr, true, size);
+    }
+
+    void printStats() const {
+        std::cout << "\nLevel      Accesses        Hits      Misses   Miss rate  Writebacks\n";
+        for (size_t level = 0; level < hierarchy_.getNumLevels(); level++) {
+            const auto& stats = hierarchy_.getLevelStats(level);
+            const uint64_t accesses = stats.reads + stats.writes;
+            const uint64_t misses = stats.read_misses + stats.write_misses;
+            std::cout << std::left << std::setw(6) << hierarchy_.getLevelName(level) << std::right
+                      << std::setw(13) << accesses
+                      << std::setw(12) << stats.read_hits + stats.write_hits
+                      << std::setw(12) << misses
+                      << std::setw(11) << std::fixed << std::setprecision(2)
+                      << (accesses ? 100.0 * misses / accesses : 0.0) << "%"
+                      << std::setw(12) << stats.writebacks << "\n";
+        }
+        const auto& memory = hierarchy_.getMemoryStats();
+        std::cout << "\nMemory reads: " << memory.reads << "\n";
+        std::cout << "Memory writes: " << memory.writes << "\n";
+    }
+
+private:
+    rvpin::tools::BasicCacheHierarchy<Policy> hierarchy_;
+    uint32_t line_shift_;
+};
+
+template <typename Policy>
+static int analyze(int argc, char* argv[], const rvpin::tools::CacheHierarchyConfig& config) {
+    HierarchyAnalyzer<Policy> analyzer(config);
+
+    auto& engine = rvpin::Engine::getInstance();
+    if (!engine.initialize(argc, argv)) {
+        std::cerr << "Failed to initialize engine\n";
+        return 1;
+    }
+
+    engine.registerBlockInstrumentation([&analyzer](rvpin::api::BlockHandle& block) {
+        analyzer.instrument(block);
+    });
+
+    int exit_code = engine.run();
+    std::cout << "Program exited with code " << exit_code << "\n";
+    std::cout << "\nReplacement policy: " << Policy::NAME
+              << ", inclusion: " << rvpin::tools::inclusionPolicyName(config.inclusion) << "\n";
+    analyzer.printStats();
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    std::string config_path = "champsim_config.json";
+    std::string inclusion;
+    int arg = 1;
+    while (arg + 1 < argc && std::string(argv[arg]).rfind("--", 0) == 0) {
+        const std::string option = argv[arg];
+        if (option == "--config") {
+            config_path = argv[arg + 1];
+        } else if (option == "--inclusion") {
+            inclusion = argv[arg + 1];
+        } else {
+            break;
+        }
+        arg += 2;
+    }
+    if (arg >= argc) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--config champsim_config.json] [--inclusion nine|inclusive|exclusive]"
+                  << " <program> [args...]\n";
+        return 1;
+    }
+
+    try {
+        rvpin::tools::CacheHierarchyConfig config =
+            rvpin::tools::loadCacheHierarchyConfig(config_path);
+        if (!inclusion.empty()) {
+            config.inclusion = rvpin::tools::parseInclusionPolicy(inclusion);
+        }
+        return rvpin::tools::visitCacheHierarchyPolicy(config, [&](auto policy) {
+            return analyze<decltype(policy)>(argc - arg, argv + arg, config);
+        });
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+}
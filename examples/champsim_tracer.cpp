@@ -0,0 +1,348 @@
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "api/instrumentation.hpp"
+#include "core/engine.hpp"
+#include "tools/champsim_tracer.hpp"
+#include "tools/simpoint.hpp"
+
+// Writes a ChampSim trace of a program: one input_instr per executed
+// instruction, with branch and register information in the form
+// ChampSim uses to classify branches.
+//
+// With --simpoints, only the simulation points chosen by
+// simpoint_profiler are traced, one file per point, each preceded by up
+// to --warmup instructions. A .trace_weights file lists the traces with
+// their weights and warmup lengths.
+
+namespace champsim = rvpin::tools::champsim;
+
+// Instructions [begin, end) go to one trace file
+struct TraceSlice {
+    uint64_t begin;
+    uint64_t end;
+    std::string path;
+    std::unique_ptr<rvpin::tools::ChampSimTracer> tracer;
+};
+
+class ChampSimTraceTool {
+public:
+    // Instruction first of the program is the first one traced
+    ChampSimTraceTool(std::vector<TraceSlice> slices,
+                      const rvpin::tools::ChampSimTracerConfig& config, uint64_t first)
+        : slices_(std::move(slices)), executed_(first), next_event_(first), config_(config) {}
+
+    // Instrumentation: everything but the effective address and whether
+    // a branch was taken is known here, so build the record once
+    void instrument(rvpin::api::InsHandle& ins) {
+        Template& tmpl = templates_.emplace_back(makeTemplate(ins));
+        if (ins.isMemoryRead() || ins.isMemoryWrite()) {
+            ins.insertCall<onMemoryInstruction>(rvpin::api::IPoint::BEFORE, this,
+                                                rvpin::api::IArg::constant(
+                                                    reinterpret_cast<uintptr_t>(&tmpl)),
+                                                rvpin::api::IArg::memoryEa());
+        } else {
+            ins.insertCall<onInstruction>(rvpin::api::IPoint::BEFORE, this,
+                                          rvpin::api::IArg::constant(
+                                              reinterpret_cast<uintptr_t>(&tmpl)));
+        }
+    }
+
+    void onProgramEnd() {
+        if (has_pending_) {
+            emit(pending_);
+            has_pending_ = false;
+        }
+        for (TraceSlice* slice : active_) {
+            close(*slice);
+        }
+        active_.clear();
+    }
+
+private:
+    struct Template {
+        champsim::InputInstr instr;
+        uint64_t fall_through;
+        bool is_load;
+        bool is_store;
+    };
+
+    // Whether a branch was taken is only known at the next instruction, so
+    // each record waits there before it is written
+    void begin(const Template& tmpl) {
+        if (has_pending_) {
+            if (pending_.is_branch) {
+                pending_.branch_taken = tmpl.instr.ip != pending_fall_through_;
+            }
+            emit(pending_);
+        }
+        pending_ = tmpl.instr;
+        pending_fall_through_ = tmpl.fall_through;
+        has_pending_ = true;
+    }
+
+    // Record into every slice covering the current instruction
+    void emit(const champsim::InputInstr& instr) {
+        if (executed_ >= next_event_) {
+            updateSlices();
+        }
+        for (TraceSlice* slice : active_) {
+            slice->tracer->record(instr);
+        }
+        executed_++;
+    }
+
+    // Close the slices that end here, open the ones that start, and find
+    // the next instruction where that changes
+    void updateSlices() {
+        for (size_t i = 0; i < active_.size();) {
+            if (active_[i]->end <= executed_) {
+                close(*active_[i]);
+                active_.erase(active_.begin() + i);
+            } else {
+                i++;
+            }
+        }
+        for (; next_slice_ < slices_.size() && slices_[next_slice_].begin <= executed_;
+             next_slice_++) {
+            TraceSlice& slice = slices_[next_slice_];
+            slice.tracer = std::make_unique<rvpin::tools::ChampSimTracer>(slice.path, config_);
+            active_.push_back(&slice);
+        }
+        next_event_ = next_slice_ < slices_.size() ? slices_[next_slice_].begin
+                                                   : std::numeric_limits<uint64_t>::max();
+        for (TraceSlice* slice : active_) {
+            next_event_ = std::min(next_event_, slice->end);
+        }
+    }
+
+    static void close(TraceSlice& slice) {
+        slice.tracer->close();
+        std::cout << "Wrote " << slice.tracer->getRecordCount() << " instructions to "
+                  << slice.path << "\n";
+        slice.tracer.reset();
+    }
+
+    static void onInstruction(ChampSimTraceTool* tool, const Template* tmpl) {
+        tool->begin(*tmpl);
+    }
+
+    static void onMemoryInstruction(ChampSimTraceTool* tool, const Template* tmpl, uint64_t ea) {
+        tool->begin(*tmpl);
+        if (tmpl->is_load) {
+            tool->pending_.source_memory[0] = ea;
+        }
+        if (tmpl->is_store) {
+            tool->pending_.destination_memory[0] = ea;
+        }
+    }
+
+    // x2 is the stack pointer ChampSim looks for; other registers are
+    // numbered past ChampSim's special ones
+    static uint8_t mapRegister(uint32_t reg) {
+        return reg == 2 ? champsim::REG_STACK_POINTER : static_cast<uint8_t>(32 + reg);
+    }
+
+    static Template makeTemplate(const rvpin::api::InsHandle& ins) {
+        using rvpin::Instruction;
+        namespace enc = rvpin::encoding;
+
+        const Instruction& inst = ins.getInstruction();
+        Template tmpl{};
+        tmpl.instr.ip = ins.getAddress();
+        tmpl.fall_through = ins.getAddress() + inst.getSize();
+        tmpl.is_load = ins.isMemoryRead();
+        tmpl.is_store = ins.isMemoryWrite();
+
+        size_t dst = 0;
+        size_t src = 0;
+        auto addDst = [&](uint8_t reg) { tmpl.instr.destination_registers[dst++] = reg; };
+        auto addSrc = [&](uint8_t reg) { tmpl.instr.source_registers[src++] = reg; };
+        const bool links = inst.getRd() == 1 || inst.getRd() == 5;
+
+        switch (inst.getOpcodeId()) {
+            case enc::OP_BEQ: case enc::OP_BNE: case enc::OP_BLT:
+            case enc::OP_BGE: case enc::OP_BLTU: case enc::OP_BGEU:
+                // Conditional: reads IP and flags, writes IP
+                tmpl.instr.is_branch = 1;
+                addSrc(champsim::REG_INSTRUCTION_POINTER);
+                addSrc(champsim::REG_FLAGS);
+                addDst(champsim::REG_INSTRUCTION_POINTER);
+                return tmpl;
+            case enc::OP_JAL:
+                tmpl.instr.is_branch = 1;
+                if (links) {
+                    // Direct call: reads and writes IP and SP
+                    addSrc(champsim::REG_INSTRUCTION_POINTER);
+                    addSrc(champsim::REG_STACK_POINTER);
+                    addDst(champsim::REG_STACK_POINTER);
+                }
+                addDst(champsim::REG_INSTRUCTION_POINTER);
+                return tmpl;
+            case enc::OP_JALR:
+                tmpl.instr.is_branch = 1;
+                if (links) {
+                    // Indirect call
+                    addSrc(champsim::REG_INSTRUCTION_POINTER);
+                    addSrc(champsim::REG_STACK_POINTER);
+                    addSrc(mapRegister(inst.getRs1()));
+                    addDst(champsim::REG_STACK_POINTER);
+                } else if (inst.getRd() == 0 && (inst.getRs1() == 1 || inst.getRs1() == 5)) {
+                    // Return: reads and writes SP, writes IP
+                    addSrc(champsim::REG_STACK_POINTER);
+                    addDst(champsim::REG_STACK_POINTER);
+                } else {
+                    addSrc(mapRegister(inst.getRs1()));
+                }
+                addDst(champsim::REG_INSTRUCTION_POINTER);
+                return tmpl;
+            default:
+                break;
+        }
+
+        const Instruction::Type type = inst.getType();
+        const bool has_rd = type == Instruction::Type::R_TYPE || type == Instruction::Type::I_TYPE ||
+                            type == Instruction::Type::U_TYPE;
+        const bool has_rs1 = type == Instruction::Type::R_TYPE || type == Instruction::Type::I_TYPE ||
+                             type == Instruction::Type::S_TYPE;
+        const bool has_rs2 = type == Instruction::Type::R_TYPE || type == Instruction::Type::S_TYPE;
+        if (has_rd && inst.getRd() != 0) {
+            addDst(mapRegister(inst.getRd()));
+        }
+        if (has_rs1 && inst.getRs1() != 0) {
+            addSrc(mapRegister(inst.getRs1()));
+        }
+        if (has_rs2 && inst.getRs2() != 0) {
+            addSrc(mapRegister(inst.getRs2()));
+        }
+        return tmpl;
+    }
+
+    std::vector<TraceSlice> slices_;    // By begin
+    std::vector<TraceSlice*> active_;
+    size_t next_slice_{0};
+    uint64_t executed_{0};
+    uint64_t next_event_{0};
+    rvpin::tools::ChampSimTracerConfig config_;
+    std::deque<Template> templates_;    // Stable addresses for inserted calls
+    champsim::InputInstr pending_{};
+    uint64_t pending_fall_through_{0};
+    bool has_pending_{false};
+};
+
+// Split a trace file name before its extensions:
+// out.champsimtrace.xz -> {out, .champsimtrace.xz}
+static std::pair<std::string, std::string> splitExtensions(const std::string& trace_file) {
+    const size_t name = trace_file.find_last_of('/') + 1;
+    const size_t dot = std::min(trace_file.find('.', name), trace_file.size());
+    return {trace_file.substr(0, dot), trace_file.substr(dot)};
+}
+
+// One slice per simulation point, starting up to warmup instructions
+// early, named out.<interval>.champsimtrace.xz, and out.trace_weights
+// beside them
+static std::vector<TraceSlice> simPointSlices(const std::string& trace_file,
+                                              const std::string& prefix,
+                                              uint64_t interval_size, uint64_t warmup) {
+    // Read the points before writing anything: with -o prefix.<ext>, the
+    // profiler's prefix.weights shares the trace's stem
+    const auto points = rvpin::tools::readSimPoints(prefix);
+    const auto [stem, extensions] = splitExtensions(trace_file);
+    std::vector<TraceSlice> slices;
+    std::ofstream weights(stem + ".trace_weights");
+    weights << "# trace weight warmup_instructions\n";
+    for (const auto& point : points) {
+        const uint64_t start = point.interval * interval_size;
+        const uint64_t begin = start > warmup ? start - warmup : 0;
+        TraceSlice& slice = slices.emplace_back();
+        slice.begin = begin;
+        slice.end = start + interval_size;
+        slice.path = stem + "." + std::to_string(point.interval) + extensions;
+        weights << slice.path << " " << point.weight << " " << start - begin << "\n";
+    }
+    return slices;
+}
+
+int main(int argc, char* argv[]) {
+    std::string trace_file = "rvpin.champsimtrace.xz";
+    rvpin::tools::ChampSimTracerConfig config;
+    std::string simpoints;
+    uint64_t interval_size = rvpin::tools::SimPointConfig{}.interval_size;
+    uint64_t warmup = 0;
+    rvpin::RegionOptions region;
+    int arg = 1;
+    for (; arg < argc; arg++) {
+        const std::string option = argv[arg];
+        if (option == "-o" && arg + 1 < argc) {
+            trace_file = argv[++arg];
+        } else if (option == "--background") {
+            config.background = true;
+        } else if (option == "--threads" && arg + 1 < argc) {
+            config.compress_threads = static_cast<unsigned>(std::stoul(argv[++arg]));
+        } else if (option == "--simpoints" && arg + 1 < argc) {
+            simpoints = argv[++arg];
+        } else if (option == "--interval" && arg + 1 < argc) {
+            interval_size = std::stoull(argv[++arg]);
+        } else if (option == "--warmup" && arg + 1 < argc) {
+            warmup = std::stoull(argv[++arg]);
+        } else if (!rvpin::parseRegionOption(arg, argc, argv, region)) {
+            break;
+        }
+    }
+    if (arg >= argc) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [-o trace_file] [--background] [--threads n]"
+                  << " [--simpoints prefix --interval n [--warmup n]]"
+                  << " [--skip n] [--start symbol|pc] [--markers] [--max n]"
+                  << " <program> [args...]\n"
+                  << "  A trace_file ending in .xz or .zst is compressed on n threads\n"
+                  << "  --simpoints traces only the points in prefix.simpoints\n"
+                  << "  Without it, only the region of interest is traced\n";
+        return 1;
+    }
+    if (!simpoints.empty() && (region.fastForwards() || region.max_instructions != 0)) {
+        std::cerr << "--simpoints picks the region itself\n";
+        return 1;
+    }
+
+    try {
+        // Simulation points count instructions from the start of the
+        // program; fast-forward to the first one and stop after the last.
+        // One instruction more tells whether the last one branched.
+        std::vector<TraceSlice> slices;
+        if (simpoints.empty()) {
+            slices.push_back({0, std::numeric_limits<uint64_t>::max(), trace_file, nullptr});
+        } else {
+            slices = simPointSlices(trace_file, simpoints, interval_size, warmup);
+            if (!slices.empty()) {
+                uint64_t end = 0;
+                for (const TraceSlice& slice : slices) {
+                    end = std::max(end, slice.end);
+                }
+                region.skip = slices.front().begin;
+                region.max_instructions = end - region.skip + 1;
+            }
+        }
+
+        auto& engine = rvpin::Engine::getInstance();
+        if (!engine.initialize(argc - arg, argv + arg, region)) {
+            std::cerr << "Failed to initialize RVPin\n";
+            return 1;
+        }
+        ChampSimTraceTool tool(std::move(slices), config, region.skip);
+        engine.registerInstructionInstrumentation([&tool](rvpin::api::InsHandle& ins) {
+            tool.instrument(ins);
+        });
+        int result = engine.run();
+        tool.onProgramEnd();
+        return result;
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+}
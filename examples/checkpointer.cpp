@@ -0,0 +1,50 @@
+#include <iostream>
+#include <string>
+#include "core/engine.hpp"
+
+// Runs a program uninstrumented and checkpoints it every interval
+// instructions, as prefix.<n>.ckpt at instruction n * interval. Any tool
+// taking --restore then picks up from one of them, so the slices of a
+// long run can be instrumented as separate processes.
+
+int main(int argc, char* argv[]) {
+    std::string prefix = "rvpin";
+    uint64_t interval = 100000000;
+    uint64_t count = 0;
+    int arg = 1;
+    for (; arg + 1 < argc; arg += 2) {
+        const std::string option = argv[arg];
+        if (option == "-o") {
+            prefix = argv[arg + 1];
+        } else if (option == "--interval") {
+            interval = std::stoull(argv[arg + 1], nullptr, 0);
+        } else if (option == "--count") {
+            count = std::stoull(argv[arg + 1], nullptr, 0);
+        } else {
+            break;
+        }
+    }
+    if (arg >= argc || interval == 0) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [-o prefix] [--interval instructions] [--count n] <program> [args...]\n"
+                  << "  Writes prefix.<n>.ckpt every interval instructions, at most n of them\n";
+        return 1;
+    }
+
+    auto& engine = rvpin::Engine::getInstance();
+    if (!engine.initialize(argc - arg, argv + arg)) {
+        std::cerr << "Failed to initialize RVPin\n";
+        return 1;
+    }
+
+    uint64_t written = 0;
+    while ((count == 0 || written < count) && engine.fastForward(interval)) {
+        const std::string path = prefix + "." + std::to_string(++written) + ".ckpt";
+        if (!engine.saveCheckpoint(path)) {
+            return 1;
+        }
+        std::cout << "Wrote " << path << "\n";
+    }
+    std::cout << written << " checkpoints every " << interval << " instructions\n";
+    return 0;
+}
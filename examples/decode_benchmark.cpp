@@ -0,0 +1,75 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "core/decoder.hpp"
+#include "core/encoding.hpp"
+
+using namespace rvpin;
+
+// The original decoder: walk every encoding until one matches
+static int linearLookup(uint32_t raw_inst) {
+    for (size_t i = 0; i < encoding::NUM_ENCODINGS; ++i) {
+        const auto& enc = encoding::INSTRUCTION_ENCODINGS[i];
+        if ((raw_inst & enc.mask) == (enc.match & enc.mask)) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+template <typename Lookup>
+static double measure(const std::vector<uint32_t>& words, int repeats,
+                      Lookup lookup, uint64_t& checksum) {
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeats; r++) {
+        for (uint32_t word : words) {
+            checksum += static_cast<uint32_t>(lookup(word));
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return static_cast<double>(words.size()) * repeats / elapsed.count() / 1e6;
+}
+
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 0) : 1000000;
+    int repeats = argc > 2 ? std::atoi(argv[2]) : 10;
+
+    // Random instances of every known encoding, plus 5% random words
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<size_t> enc_dist(0, encoding::NUM_ENCODINGS - 1);
+    std::uniform_int_distribution<uint32_t> bits_dist;
+    std::bernoulli_distribution garbage_dist(0.05);
+
+    std::vector<uint32_t> words(count);
+    for (auto& word : words) {
+        uint32_t bits = bits_dist(gen);
+        if (garbage_dist(gen)) {
+            word = bits;
+            continue;
+        }
+        const auto& enc = encoding::INSTRUCTION_ENCODINGS[enc_dist(gen)];
+        word = (enc.match & enc.mask) | (bits & ~enc.mask);
+    }
+
+    // Both decoders must agree on every word
+    for (uint32_t word : words) {
+        if (linearLookup(word) != Decoder::lookup(word)) {
+            std::cerr << "Mismatch decoding 0x" << std::hex << word << "\n";
+            return 1;
+        }
+    }
+
+    uint64_t checksum = 0;
+    double linear = measure(words, repeats, linearLookup, checksum);
+    double table = measure(words, repeats, Decoder::lookup, checksum);
+
+    std::cout << "Decoded " << count << " words x " << repeats << " repeats ("
+              << encoding::NUM_ENCODINGS << " encodings)\n";
+    std::cout << "Linear scan : " << linear << " M decodes/s\n";
+    std::cout << "Decode table: " << table << " M decodes/s\n";
+    std::cout << "Speedup     : " << table / linear << "x\n";
+    std::cout << "(checksum " << checksum << ")\n";
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "instruction_counter.hpp"
+#include "core/engine.hpp"
+
+// Measures guest throughput, first with no tool in each dispatch mode,
+// then with the ways of attaching instruction_counter to the engine:
+//   switch       no tool, stepping through decoded instructions
+//   threaded     no tool, threaded code with fused instruction pairs
+//   jit          no tool, hot blocks compiled to x86-64
+//   type-erased  std::function callback into the virtual hook
+//   templated    Engine::runWith, hooks called directly
+//
+// For a realistic workload, build examples/cache_test.cpp for RISC-V,
+// e.g. riscv64-linux-gnu-g++ -O2 -static, and pass it as the program.
+//
+// Every run gets its own engine in a fresh child process, so one run's
+// host heap, resident pages and guest side effects such as files
+// written do not carry over into the next one's timing.
+
+enum class Mode { SWITCH, THREADED, JIT, TYPE_ERASED, TEMPLATED };
+
+struct RunResult {
+    double seconds;
+    uint64_t instructions;
+};
+
+static RunResult runChild(Mode mode, int argc, char* argv[]) {
+    // Guest and tool output would drown the results
+    int null_fd = ::open("/dev/null", O_WRONLY);
+    ::dup2(null_fd, STDOUT_FILENO);
+
+    rvpin::Engine engine;
+    if (!engine.initialize(argc, argv)) {
+        std::exit(1);
+    }
+
+    InstructionCounter counter;
+    auto start = std::chrono::steady_clock::now();
+    switch (mode) {
+        case Mode::SWITCH:
+            engine.setDispatchMode(rvpin::DispatchMode::SWITCH);
+            engine.run();
+            break;
+        case Mode::THREADED:
+            engine.setDispatchMode(rvpin::DispatchMode::THREADED);
+            engine.run();
+            break;
+        case Mode::JIT:
+            engine.setDispatchMode(rvpin::DispatchMode::JIT);
+            engine.run();
+            break;
+        case Mode::TYPE_ERASED: {
+            rvpin::api::InstrumentationTool& tool = counter;
+            engine.registerBeforeInstruction([&tool](const rvpin::Instruction& inst) {
+                tool.onBeforeInstruction(inst);
+            });
+            engine.run();
+            break;
+        }
+        case Mode::TEMPLATED:
+            engine.runWith(counter);
+            break;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return {elapsed.count(), engine.getState().instret};
+}
+
+static bool measure(Mode mode, int argc, char* argv[], RunResult& result) {
+    int fds[2];
+    if (::pipe(fds) != 0) {
+        return false;
+    }
+    pid_t pid = ::fork();
+    if (pid == 0) {
+        ::close(fds[0]);
+        RunResult child = runChild(mode, argc, argv);
+        ssize_t written = ::write(fds[1], &child, sizeof(child));
+        ::_exit(written == sizeof(child) ? 0 : 1);
+    }
+    ::close(fds[1]);
+    ssize_t got = ::read(fds[0], &result, sizeof(result));
+    ::close(fds[0]);
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    return got == sizeof(result) && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " [--repeats N] <program> [args...]\n";
+        return 1;
+    }
+
+    int arg = 1;
+    int repeats = 3;
+    if (std::strcmp(argv[arg], "--repeats") == 0 && argc > 3) {
+        repeats = std::atoi(argv[arg + 1]);
+        arg += 2;
+    }
+
+    const struct {
+        Mode mode;
+        const char* name;
+    } modes[] = {
+        {Mode::SWITCH, "switch"},
+        {Mode::THREADED, "threaded"},
+        {Mode::JIT, "jit"},
+        {Mode::TYPE_ERASED, "type-erased"},
+        {Mode::TEMPLATED, "templated"},
+    };
+
+    double seconds[5] = {};
+    for (const auto& m : modes) {
+        RunResult best{0, 0};
+        for (int r = 0; r < repeats; r++) {
+            RunResult result;
+            if (!measure(m.mode, argc - arg, argv + arg, result)) {
+                std::cerr << "Run failed for mode " << m.name << "\n";
+                return 1;
+            }
+            if (r == 0 || result.seconds < best.seconds) {
+                best = result;
+            }
+        }
+        std::cout << m.name << ": " << best.seconds << " s, " << best.instructions
+                  << " instructions, " << best.instructions / best.seconds / 1e6 << " MIPS\n";
+        seconds[static_cast<int>(m.mode)] = best.seconds;
+    }
+    std::cout << "Threaded speedup over switch: "
+              << seconds[static_cast<int>(Mode::SWITCH)] / seconds[static_cast<int>(Mode::THREADED)]
+              << "x\n";
+    std::cout << "JIT speedup over threaded: "
+              << seconds[static_cast<int>(Mode::THREADED)] / seconds[static_cast<int>(Mode::JIT)]
+              << "x\n";
+    std::cout << "Templated speedup over type-erased: "
+              << seconds[static_cast<int>(Mode::TYPE_ERASED)] /
+                     seconds[static_cast<int>(Mode::TEMPLATED)]
+              << "x\n";
+    return 0;
+}
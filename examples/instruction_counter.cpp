@@ -1,73 +1,36 @@
-#include "../src/api/instrumentation.hpp"
+#include "instruction_counter.hpp"
 #include "../src/core/engine.hpp"
 #include <iostream>
-#include <unordered_map>
-#include <iomanip>
+#include <string>
 
-class InstructionCounter : public rvpin::api::InstrumentationTool {
-public:
-    void onBeforeInstruction(const rvpin::Instruction& inst) override {
-        std::string mnemonic = inst.getMnemonic();
-        if (mnemonic == "UNKNOWN") {
-            std::cout << "Unknown instruction: 0x" << std::hex 
-                      << std::setw(8) << std::setfill('0') 
-                      << inst.getRawInstruction() << std::dec << "\n";
-            unknown_count_++;
-        } else {
-            instruction_count_[mnemonic]++;
-        }
-        total_instructions_++;
-    }
-    
-    void onProgramEnd() override {
-        std::cout << "\nInstruction Count Summary:\n";
-        std::cout << "-------------------------\n";
-        
-        // Find the longest mnemonic for alignment
-        size_t max_width = 0;
-        for (const auto& [mnemonic, _] : instruction_count_) {
-            max_width = std::max(max_width, mnemonic.length());
-        }
-        
-        // Print counts with nice alignment
-        for (const auto& [mnemonic, count] : instruction_count_) {
-            std::cout << std::left << std::setw(max_width + 2) << mnemonic 
-                      << ": " << count << "\n";
-        }
-        
-        if (unknown_count_ > 0) {
-            std::cout << "UNKNOWN: " << unknown_count_ << "\n";
+int main(int argc, char* argv[]) {
+    rvpin::RegionOptions region;
+    bool by_extension = false;
+    int arg = 1;
+    for (; arg < argc; arg++) {
+        if (std::string(argv[arg]) == "--extensions") {
+            by_extension = true;
+        } else if (!rvpin::parseRegionOption(arg, argc, argv, region)) {
+            break;
         }
-        
-        std::cout << "-------------------------\n";
-        std::cout << "Total Instructions: " << total_instructions_ << "\n";
     }
-    
-private:
-    std::unordered_map<std::string, uint64_t> instruction_count_;
-    uint64_t total_instructions_ = 0;
-    uint64_t unknown_count_ = 0;
-};
-
-int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <program_to_instrument>\n";
+    if (arg >= argc) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--extensions] [--skip n] [--start symbol|pc] [--markers] [--max n]"
+                  << " <program_to_instrument> [args...]\n"
+                  << "  Counts only the region of interest; the rest runs uninstrumented\n";
         return 1;
     }
 
     auto& engine = rvpin::Engine::getInstance();
-    InstructionCounter counter;
+    InstructionCounter counter(by_extension);
     
-    if (!engine.initialize(argc - 1, argv + 1)) {
+    if (!engine.initialize(argc - arg, argv + arg, region)) {
         std::cerr << "Failed to initialize RVPin\n";
         return 1;
     }
 
-    engine.registerBeforeInstruction([&counter](const rvpin::Instruction& inst) {
-        counter.onBeforeInstruction(inst);
-    });
-
-    int result = engine.run();
-    counter.onProgramEnd();
-    return result;
+    // Bind the counter at compile time; onBeforeInstruction and
+    // onProgramEnd are called directly from the block loop
+    return engine.runWith(counter);
 }
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "../src/api/instrumentation.hpp"
+#include "../src/core/encoding.hpp"
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <map>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <iomanip>
+
+// Counts executed instructions per mnemonic. Shared by instruction_counter
+// and dispatch_benchmark.
+//
+// Counts are kept per opcode id in a flat array, so the hot path is one
+// increment; names are only looked up when the summary is printed.
+// Encodings the decoder does not know share the OP_UNKNOWN slot and are
+// tallied by raw encoding off the hot path.
+//
+// A counter belongs to one engine. Runs split over threads, like
+// parallel_analyzer's slices, give each engine its own and merge() them
+// afterwards, rather than sharing per-hart counts.
+class InstructionCounter : public rvpin::api::InstrumentationTool {
+public:
+    // With by_extension, the summary also totals the counts by ISA
+    // extension (RV_I, RV_M, ...)
+    explicit InstructionCounter(bool by_extension = false) : by_extension_(by_extension) {}
+
+    void onBeforeInstruction(const rvpin::Instruction& inst) override {
+        counts_[inst.getOpcodeId()]++;
+        if (!inst.isValid()) {
+            unknown_encodings_[inst.getRawInstruction()]++;
+        }
+    }
+
+    void onProgramEnd() override {
+        namespace enc = rvpin::encoding;
+
+        // Most frequent first; ties in table order
+        std::vector<std::pair<uint64_t, size_t>> executed;
+        size_t max_width = 0;
+        for (size_t id = 0; id < enc::NUM_ENCODINGS; id++) {
+            if (counts_[id] != 0) {
+                executed.emplace_back(counts_[id], id);
+                max_width = std::max(max_width, enc::INSTRUCTION_ENCODINGS[id].name.size());
+            }
+        }
+        std::stable_sort(executed.begin(), executed.end(),
+                         [](const auto& a, const auto& b) { return a.first > b.first; });
+
+        std::cout << "\nInstruction Count Summary:\n";
+        std::cout << "-------------------------\n";
+        for (const auto& [count, id] : executed) {
+            std::cout << std::left << std::setw(max_width + 2)
+                      << enc::INSTRUCTION_ENCODINGS[id].name << ": " << count << "\n";
+        }
+
+        if (counts_[enc::OP_UNKNOWN] > 0) {
+            std::cout << "UNKNOWN: " << counts_[enc::OP_UNKNOWN] << "\n";
+            for (const auto& [raw, count] : unknown_encodings_) {
+                std::cout << "  0x" << std::hex << std::setw(8) << std::setfill('0') << raw
+                          << std::dec << std::setfill(' ') << ": " << count << "\n";
+            }
+        }
+
+        std::cout << "-------------------------\n";
+        std::cout << "Total Instructions: " << getTotalInstructions() << "\n";
+
+        if (by_extension_) {
+            std::map<std::string_view, uint64_t> extensions;
+            for (const auto& [count, id] : executed) {
+                extensions[enc::INSTRUCTION_ENCODINGS[id].extension] += count;
+            }
+            std::cout << "\nBy Extension:\n";
+            std::cout << "-------------------------\n";
+            for (const auto& [extension, count] : extensions) {
+                std::cout << std::left << std::setw(10) << extension << ": " << count << "\n";
+            }
+        }
+    }
+
+    uint64_t getTotalInstructions() const {
+        uint64_t total = 0;
+        for (uint64_t count : counts_) {
+            total += count;
+        }
+        return total;
+    }
+
+    uint64_t getCount(rvpin::encoding::Opcode id) const { return counts_[id]; }
+
+    // Add another counter's counts, e.g. from another slice of the run
+    void merge(const InstructionCounter& other) {
+        for (size_t id = 0; id < counts_.size(); id++) {
+            counts_[id] += other.counts_[id];
+        }
+        for (const auto& [raw, count] : other.unknown_encodings_) {
+            unknown_encodings_[raw] += count;
+        }
+    }
+
+private:
+    // Indexed by opcode id; the last slot is OP_UNKNOWN
+    std::array<uint64_t, rvpin::encoding::NUM_ENCODINGS + 1> counts_{};
+    std::map<uint32_t, uint64_t> unknown_encodings_;
+    bool by_extension_;
+};
@@ -0,0 +1,117 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "instruction_counter.hpp"
+#include "core/engine.hpp"
+#include "tools/cache_sim.hpp"
+#include "tools/parallel_slices.hpp"
+#include "tools/simpoint.hpp"
+
+// Instruction mix and L1D statistics of a program, computed one interval
+// at a time on every core and merged. With --simpoints, only the
+// simulation points chosen by simpoint_profiler are instrumented.
+
+struct SliceResult {
+    InstructionCounter counter;
+    rvpin::tools::CacheStats l1d;
+};
+
+// What one slice runs: the instruction counter bound at compile time and
+// a 32 KiB, 8-way L1D
+class SliceTool {
+public:
+    SliceTool() : cache_(l1dConfig()) {}
+
+    void onBeforeInstruction(const rvpin::Instruction& inst) {
+        result_.counter.onBeforeInstruction(inst);
+    }
+
+    void onMemoryAccess(uint64_t addr, bool is_write, uint32_t size) {
+        cache_.access(0, addr, is_write, size);
+    }
+
+    SliceResult finish() {
+        result_.l1d = cache_.getStats();
+        return std::move(result_);
+    }
+
+private:
+    static rvpin::tools::CacheConfig l1dConfig() {
+        rvpin::tools::CacheConfig config{};
+        config.line_size = 64;
+        config.size = 32 * 1024;
+        config.associativity = 8;
+        config.write_back = true;
+        config.write_allocate = true;
+        return config;
+    }
+
+    SliceResult result_;
+    rvpin::tools::Cache cache_;
+};
+
+int main(int argc, char* argv[]) {
+    rvpin::tools::ParallelSlicesConfig config;
+    std::string simpoints;
+    int arg = 1;
+    for (; arg + 1 < argc; arg += 2) {
+        const std::string option = argv[arg];
+        if (option == "-j") {
+            config.threads = static_cast<unsigned>(std::stoul(argv[arg + 1]));
+        } else if (option == "--interval") {
+            config.interval_size = std::stoull(argv[arg + 1], nullptr, 0);
+        } else if (option == "--simpoints") {
+            simpoints = argv[arg + 1];
+        } else if (option == "-o") {
+            config.checkpoint_prefix = argv[arg + 1];
+        } else {
+            break;
+        }
+    }
+    if (arg >= argc) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [-j threads] [--interval n] [--simpoints prefix] [-o checkpoint_prefix]"
+                  << " <program> [args...]\n";
+        return 1;
+    }
+
+    try {
+        if (!simpoints.empty()) {
+            for (const auto& point : rvpin::tools::readSimPoints(simpoints)) {
+                config.intervals.push_back(point.interval);
+            }
+        }
+        const std::vector<SliceResult> slices = rvpin::tools::runParallelSlices(
+            argc - arg, argv + arg, config,
+            [](rvpin::Engine& engine, const rvpin::tools::Slice&) {
+                SliceTool tool;
+                engine.registerMemoryAccess([&tool](uint64_t addr, bool is_write, uint32_t size) {
+                    tool.onMemoryAccess(addr, is_write, size);
+                });
+                engine.runWith(tool);
+                return tool.finish();
+            });
+
+        // Merge in slice order, so the report does not depend on which
+        // slice finished first
+        SliceResult total;
+        for (const SliceResult& slice : slices) {
+            total.counter.merge(slice.counter);
+            total.l1d.merge(slice.l1d);
+        }
+
+        std::cout << slices.size() << " slices of " << config.interval_size
+                  << " instructions\n";
+        total.counter.onProgramEnd();
+        const auto& l1d = total.l1d;
+        const uint64_t accesses = l1d.reads + l1d.writes;
+        std::cout << "\nL1D: " << accesses << " accesses, "
+                  << l1d.read_misses + l1d.write_misses << " misses ("
+                  << (accesses ? 100.0 * (l1d.read_misses + l1d.write_misses) / accesses : 0.0)
+                  << "%), " << l1d.writebacks << " writebacks\n";
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
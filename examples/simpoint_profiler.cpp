@@ -0,0 +1,83 @@
+#include <iostream>
+#include <string>
+#include "api/instrumentation.hpp"
+#include "core/engine.hpp"
+#include "tools/simpoint.hpp"
+
+// Profiles basic block vectors over fixed instruction intervals and picks
+// SimPoint simulation points. Writes prefix.bb, prefix.simpoints and
+// prefix.weights; champsim_tracer --simpoints prefix then traces only the
+// chosen intervals.
+
+class SimPointProfiler {
+public:
+    explicit SimPointProfiler(uint64_t interval_size) : profiler_(interval_size) {}
+
+    // Instrumentation: one call per block with its id and length
+    void instrument(rvpin::api::BlockHandle& block) {
+        block.insertCall<onBlock>(this,
+                                  rvpin::api::IArg::constant(profiler_.getBlockId(block.getAddress())),
+                                  rvpin::api::IArg::constant(block.getNumInstructions()));
+    }
+
+    static void onBlock(SimPointProfiler* tool, uint32_t id, uint32_t instructions) {
+        tool->profiler_.addBlock(id, instructions);
+    }
+
+    rvpin::tools::BbvProfiler& getProfiler() { return profiler_; }
+
+private:
+    rvpin::tools::BbvProfiler profiler_;
+};
+
+int main(int argc, char* argv[]) {
+    rvpin::tools::SimPointConfig config;
+    std::string prefix = "rvpin";
+    int arg = 1;
+    for (; arg + 1 < argc; arg += 2) {
+        const std::string option = argv[arg];
+        if (option == "-o") {
+            prefix = argv[arg + 1];
+        } else if (option == "--interval") {
+            config.interval_size = std::stoull(argv[arg + 1]);
+        } else if (option == "--max-k") {
+            config.max_k = static_cast<uint32_t>(std::stoul(argv[arg + 1]));
+        } else {
+            break;
+        }
+    }
+    if (arg >= argc) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [-o prefix] [--interval instructions] [--max-k k] <program> [args...]\n";
+        return 1;
+    }
+
+    auto& engine = rvpin::Engine::getInstance();
+    if (!engine.initialize(argc - arg, argv + arg)) {
+        std::cerr << "Failed to initialize RVPin\n";
+        return 1;
+    }
+
+    SimPointProfiler tool(config.interval_size);
+    engine.registerBlockInstrumentation([&tool](rvpin::api::BlockHandle& block) {
+        tool.instrument(block);
+    });
+    int result = engine.run();
+
+    auto& profiler = tool.getProfiler();
+    profiler.finish();
+    profiler.writeBbv(prefix + ".bb");
+    const auto simpoints = rvpin::tools::selectSimPoints(profiler, config);
+    rvpin::tools::writeSimPoints(prefix, simpoints);
+
+    std::cout << "\n" << profiler.getInstructionCount() << " instructions, "
+              << profiler.getNumIntervals() << " intervals of " << config.interval_size
+              << ", " << profiler.getNumBlocks() << " blocks\n";
+    std::cout << "Simulation points (interval weight):\n";
+    for (const auto& point : simpoints) {
+        std::cout << "  " << point.interval << " " << point.weight << "\n";
+    }
+    std::cout << "\nTrace them with: champsim_tracer --simpoints " << prefix
+              << " --interval " << config.interval_size << " <program>\n";
+    return result;
+}
@@ -1,46 +1,118 @@
 #include <iostream>
+#include <fstream>
 #include <iomanip>
-#include "../src/api/instrumentation.hpp"
+#include <algorithm>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include "../src/api/per_hart.hpp"
 #include "../src/core/engine.hpp"
 
-class SyscallTracer : public rvpin::api::InstrumentationTool {
+// Prints every syscall the guest makes, with its arguments, result and
+// host time. Events come from the engine's syscall trace a batch at a
+// time, and each batch is formatted and written out in one go, so the
+// trace does not slow down with the terminal. Totals are kept per hart
+// and each batch is written under a lock, so engines on several threads
+// can share one tracer.
+class SyscallTracer {
 public:
-    void onBeforeInstruction(const rvpin::Instruction& inst) override {
-        // Check if instruction is ecall
-        if (inst.getRawInstruction() == 0x00000073) { // ECALL opcode
-            uint64_t syscall_num = rvpin::api::utils::getRegisterValue(17); // a7 register
-            std::cout << "Syscall detected: " << std::dec << syscall_num << "\n";
-            syscall_count_++;
+    explicit SyscallTracer(std::ostream& out, uint32_t num_harts = 1)
+        : out_(out), syscall_counts_(num_harts), host_ns_(num_harts) {}
+
+    void onBatch(const std::vector<rvpin::SyscallEvent>& events) {
+        std::ostringstream text;
+        for (const rvpin::SyscallEvent& event : events) {
+            const char* name = rvpin::syscall::getName(event.number);
+            if (name) {
+                text << name;
+            } else {
+                text << "syscall_" << event.number;
+            }
+            text << std::hex << "(0x" << event.args[0] << ", 0x" << event.args[1] << ", 0x"
+                 << event.args[2] << ")" << std::dec << " = ";
+            // Addresses, e.g. from mmap or brk, read better in hex
+            if (event.result >= ADDRESS_RESULT) {
+                text << "0x" << std::hex << event.result << std::dec;
+            } else {
+                text << event.result;
+            }
+            text << "  [" << event.host_ns << " ns, " << event.gap
+                 << " instructions since last]\n";
+            syscall_counts_.add(event.hart, std::min<uint64_t>(event.number, MAX_SYSCALL));
+            host_ns_[event.hart] += event.host_ns;
         }
+        std::lock_guard<std::mutex> lock(out_mutex_);
+        out_ << text.str();
     }
-    
-    void onProgramEnd() override {
-        std::cout << "\nSyscall Summary:\n";
-        std::cout << "---------------\n";
-        std::cout << "Total syscalls: " << syscall_count_ << "\n";
+
+    void onProgramEnd() {
+        const auto counts = syscall_counts_.total();
+        uint64_t total = 0;
+        out_ << "\nSyscall Summary:\n";
+        out_ << "---------------\n";
+        for (size_t num = 0; num <= MAX_SYSCALL; num++) {
+            if (counts[num] != 0) {
+                const char* name = rvpin::syscall::getName(num);
+                out_ << (num == MAX_SYSCALL ? ">=" : "") << num;
+                if (name) {
+                    out_ << " (" << name << ")";
+                }
+                out_ << ": " << counts[num] << "\n";
+                total += counts[num];
+            }
+        }
+        const uint64_t host_ns =
+            host_ns_.merge(uint64_t(0), [](uint64_t& sum, uint64_t ns) { sum += ns; });
+        out_ << "Total syscalls: " << total << "\n";
+        out_ << "Host time in syscalls: " << host_ns / 1000 << " us\n";
+        out_.flush();
     }
-    
+
 private:
-    uint64_t syscall_count_ = 0;
+    // RISC-V Linux numbers stay below this; larger ones share its counter
+    static constexpr size_t MAX_SYSCALL = 512;
+    static constexpr int64_t ADDRESS_RESULT = 0x10000;
+
+    std::ostream& out_;
+    std::mutex out_mutex_;      // Batches from different harts are written whole
+    rvpin::api::PerHartCounters<MAX_SYSCALL + 1> syscall_counts_;
+    rvpin::api::PerHart<uint64_t> host_ns_;
 };
 
 int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <program_to_instrument>\n";
+    std::string output_file;
+    int arg = 1;
+    if (arg + 1 < argc && std::string(argv[arg]) == "-o") {
+        output_file = argv[arg + 1];
+        arg += 2;
+    }
+    if (arg >= argc) {
+        std::cerr << "Usage: " << argv[0] << " [-o trace_file] <program_to_instrument> [args...]\n";
         return 1;
     }
 
+    std::ofstream file;
+    if (!output_file.empty()) {
+        file.open(output_file);
+        if (!file) {
+            std::cerr << "Failed to open " << output_file << "\n";
+            return 1;
+        }
+    }
+
     auto& engine = rvpin::Engine::getInstance();
-    SyscallTracer tracer;
-    
-    if (!engine.initialize(argc - 1, argv + 1)) {
+    SyscallTracer tracer(output_file.empty() ? std::cout : file);
+
+    if (!engine.initialize(argc - arg, argv + arg)) {
         std::cerr << "Failed to initialize RVPin\n";
         return 1;
     }
 
-    engine.registerBeforeInstruction([&tracer](const rvpin::Instruction& inst) {
-        tracer.onBeforeInstruction(inst);
+    engine.registerSyscallTrace([&tracer](const std::vector<rvpin::SyscallEvent>& events) {
+        tracer.onBatch(events);
     });
 
-    return engine.run();
+    int result = engine.run();
+    tracer.onProgramEnd();
+    return result;
 }
@@ -35,15 +35,16 @@ def generate_header(instr_dict, arg_lut):
 #pragma once
 #include <cstdint>
 #include <cstddef>
+#include <string_view>
 
 namespace rvpin {
 namespace encoding {
 
 struct InstructionEncoding {
-    const char* name;
+    std::string_view name;
     uint32_t mask;
     uint32_t match;
-    const char* extension;
+    std::string_view extension;
 };
 
 constexpr InstructionEncoding INSTRUCTION_ENCODINGS[] = {
@@ -52,11 +53,20 @@ constexpr InstructionEncoding INSTRUCTION_ENCODINGS[] = {
 
 constexpr size_t NUM_ENCODINGS = sizeof(INSTRUCTION_ENCODINGS) / sizeof(InstructionEncoding);
 
+// Dense opcode ids, one per INSTRUCTION_ENCODINGS entry
+enum Opcode : uint16_t {
+%s,
+    OP_UNKNOWN
+};
+
+static_assert(OP_UNKNOWN == NUM_ENCODINGS, "Opcode ids must match the encoding table");
+
 } // namespace encoding
 } // namespace rvpin
 """
     
     entries = []
+    opcodes = []
     for name, inst in instr_dict.items():
         # Convert match and mask from hex strings to integers
         match = int(inst['match'], 16)
@@ -80,35 +90,41 @@ constexpr size_t NUM_ENCODINGS = sizeof(INSTRUCTION_ENCODINGS) / sizeof(Instruct
         
         entry = f'    {{"{name}", 0x{mask:08x}, 0x{match:08x}, "{extension}"}}'
         entries.append(entry)
+        opcodes.append(f'    OP_{name.upper()}')
     
-    return template % ',\n'.join(entries)
+    return template % (',\n'.join(entries), ',\n'.join(opcodes))
 
 def main():
     parser = argparse.ArgumentParser(description="Generate RISC-V instruction encodings")
-    parser.add_argument('--isa', type=str, default='rv32i', help='RISC-V ISA string (e.g., rv32i, rv64i)')
+    parser.add_argument('--isa', type=str, default='rv32i', help='RISC-V ISA string (e.g., rv32i, rv64imafd_zicsr_zifencei)')
     parser.add_argument('--include-pseudo', action='store_true', help='Include pseudo-instructions')
     args = parser.parse_args()
     
     # Convert ISA string to list of extensions
     # For rv32i we need both rv_i (common) and rv32_i (specific)
     # For rv64i we need both rv_i (common) and rv64_i (specific)
+    # Z extensions follow the base letters, e.g. rv64imafd_zicsr_zifencei
+    base_isa, *z_extensions = args.isa.split('_')
     extensions = []
     
     # Add common instructions
-    for ext in args.isa[4:]:  # Skip "rv32" or "rv64"
+    for ext in base_isa[4:]:  # Skip "rv32" or "rv64"
         extensions.append(f"rv_{ext}")
     
     # Add ISA-specific instructions
-    if args.isa.startswith('rv32'):
+    if base_isa.startswith('rv32'):
         prefix = 'rv32'
-    elif args.isa.startswith('rv64'):
+    elif base_isa.startswith('rv64'):
         prefix = 'rv64'
     else:
         prefix = 'rv'
         
-    for ext in args.isa[4:]:  # Skip "rv32" or "rv64"
+    for ext in base_isa[4:]:  # Skip "rv32" or "rv64"
         extensions.append(f"{prefix}_{ext}")
     
+    for ext in z_extensions:
+        extensions.append(f"rv_{ext}")
+    
     print(f"Using extensions: {extensions}")
     
     # Load argument lookup table
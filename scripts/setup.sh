@@ -19,8 +19,8 @@ else
     git pull origin master
 fi
 
-# Generate instruction encoding header for RV32I base ISA
+# Generate instruction encoding header for the RV64 user-level ISA
 echo "Generating instruction encoding header..."
-python3 "$PROJECT_ROOT/scripts/generate_encoding.py" --isa rv32i --include-pseudo
+python3 "$PROJECT_ROOT/scripts/generate_encoding.py" --isa rv64imafd_zicsr_zifencei --include-pseudo
 
 echo "Setup completed successfully!"
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include "../core/engine.hpp"
+
+namespace rvpin {
+namespace api {
+
+// Contiguous run of T, the C++17 stand-in for std::span. Empty when
+// default constructed.
+template <typename T>
+class Span {
+public:
+    constexpr Span() = default;
+    constexpr Span(T* data, size_t size) : data_(data), size_(size) {}
+
+    constexpr T* data() const { return data_; }
+    constexpr size_t size() const { return size_; }
+    constexpr bool empty() const { return size_ == 0; }
+    constexpr T& operator[](size_t i) const { return data_[i]; }
+    constexpr T* begin() const { return data_; }
+    constexpr T* end() const { return data_ + size_; }
+
+private:
+    T* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Guest state for analysis routines and tool hooks. These act on the
+// engine running on the calling thread (Engine::getCurrent()) and may
+// only be called while it runs. Register reads are a load from the live
+// register file; memory views point straight into guest memory.
+namespace utils {
+
+inline Engine& currentEngine() { return *Engine::getCurrent(); }
+
+// At IPoint::BEFORE, the pc of the instruction; at IPoint::AFTER, the
+// next one's
+inline uint64_t getProgramCounter() { return currentEngine().getState().pc; }
+
+inline uint64_t getRegisterValue(uint32_t reg) {
+    return currentEngine().getState().x[reg & 0x1F];
+}
+
+// Raw bits; singles are NaN-boxed
+inline uint64_t getFpRegisterValue(uint32_t reg) {
+    return currentEngine().getState().f[reg & 0x1F];
+}
+
+// All 32 integer and FP registers, pc and fcsr at once, by reference to
+// the live state or as a copy that outlives the call
+inline const CpuState& getRegisters() { return currentEngine().getState(); }
+inline CpuState snapshotRegisters() { return currentEngine().getState(); }
+
+// Little-endian value of 1, 2, 4 or 8 bytes, zero-extended. Addresses
+// the guest itself could not load from or store to throw MemoryFault.
+inline uint64_t readMemory(uint64_t addr, size_t size) {
+    Memory& memory = currentEngine().getMemory();
+    switch (size) {
+        case 1: return memory.load<uint8_t>(addr);
+        case 2: return memory.load<uint16_t>(addr);
+        case 4: return memory.load<uint32_t>(addr);
+        case 8: return memory.load<uint64_t>(addr);
+        default: throw std::invalid_argument("Memory reads are 1, 2, 4 or 8 bytes");
+    }
+}
+
+inline void writeMemory(uint64_t addr, uint64_t value, size_t size) {
+    Memory& memory = currentEngine().getMemory();
+    switch (size) {
+        case 1: memory.store(addr, static_cast<uint8_t>(value)); break;
+        case 2: memory.store(addr, static_cast<uint16_t>(value)); break;
+        case 4: memory.store(addr, static_cast<uint32_t>(value)); break;
+        case 8: memory.store(addr, value); break;
+        default: throw std::invalid_argument("Memory writes are 1, 2, 4 or 8 bytes");
+    }
+}
+
+// Zero-copy view of [addr, addr + size). Empty unless the range lies in
+// one mapped range of the guest, e.g. a buffer passed to a syscall; use
+// copyMemory for ranges that may straddle two. The mutable view is also
+// empty for read-only memory such as .text.
+inline Span<const uint8_t> viewMemory(uint64_t addr, size_t size) {
+    const uint8_t* host = currentEngine().getMemory().view(addr, size);
+    return host ? Span<const uint8_t>(host, size) : Span<const uint8_t>();
+}
+
+inline Span<uint8_t> viewMemoryMutable(uint64_t addr, size_t size) {
+    uint8_t* host = currentEngine().getMemory().viewMutable(addr, size);
+    return host ? Span<uint8_t>(host, size) : Span<uint8_t>();
+}
+
+inline void copyMemory(uint64_t addr, void* dst, size_t size) {
+    currentEngine().getMemory().read(addr, dst, size);
+}
+
+// NUL-terminated guest string of at most max_size bytes
+inline std::string readString(uint64_t addr, size_t max_size = 4096) {
+    std::string result;
+    Memory& memory = currentEngine().getMemory();
+    for (; result.size() < max_size; addr++) {
+        const char c = static_cast<char>(memory.load<uint8_t>(addr));
+        if (c == '\0') {
+            break;
+        }
+        result.push_back(c);
+    }
+    return result;
+}
+
+} // namespace utils
+
+} // namespace api
+} // namespace rvpin
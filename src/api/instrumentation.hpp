@@ -1,41 +1,270 @@
 #pragma once
 
+#include <cstddef>
 #include <functional>
+#include <initializer_list>
+#include <type_traits>
+#include <utility>
+#include <vector>
 #include "../core/instruction.hpp"
+#include "../core/isa.hpp"
 
 namespace rvpin {
+
+class Engine;
+
 namespace api {
 
 // Main API for tool writers
 class InstrumentationTool {
 public:
     virtual ~InstrumentationTool() = default;
-    
+
     // Called before program execution starts
     virtual void onProgramStart() {}
-    
+
     // Called before each instruction
     virtual void onBeforeInstruction(const Instruction& inst) {}
-    
+
     // Called after each instruction
     virtual void onAfterInstruction(const Instruction& inst) {}
-    
+
     // Called when program execution ends
     virtual void onProgramEnd() {}
 };
 
-// Helper functions for common instrumentation tasks
-namespace utils {
-    // Get the current program counter
-    uint64_t getProgramCounter();
-    
-    // Read/Write memory at given address
-    uint64_t readMemory(uint64_t addr, size_t size);
-    void writeMemory(uint64_t addr, uint64_t value, size_t size);
-    
-    // Get register value
-    uint64_t getRegisterValue(uint32_t reg);
+// Compile-time view of which hooks a tool defines, used by
+// Engine::runWith. A hook counts when the tool declares it itself; the
+// empty defaults inherited from InstrumentationTool do not. Tools do not
+// have to derive from InstrumentationTool.
+template <typename Tool>
+struct ToolHooks {
+private:
+    template <typename T, typename = void>
+    struct DefinesProgramStart : std::false_type {};
+    template <typename T>
+    struct DefinesProgramStart<T, std::void_t<decltype(&T::onProgramStart)>>
+        : std::bool_constant<!std::is_same_v<decltype(&T::onProgramStart),
+                                             void (InstrumentationTool::*)()>> {};
+
+    template <typename T, typename = void>
+    struct DefinesBeforeInstruction : std::false_type {};
+    template <typename T>
+    struct DefinesBeforeInstruction<T, std::void_t<decltype(&T::onBeforeInstruction)>>
+        : std::bool_constant<!std::is_same_v<decltype(&T::onBeforeInstruction),
+                                             void (InstrumentationTool::*)(const Instruction&)>> {};
+
+    template <typename T, typename = void>
+    struct DefinesAfterInstruction : std::false_type {};
+    template <typename T>
+    struct DefinesAfterInstruction<T, std::void_t<decltype(&T::onAfterInstruction)>>
+        : std::bool_constant<!std::is_same_v<decltype(&T::onAfterInstruction),
+                                             void (InstrumentationTool::*)(const Instruction&)>> {};
+
+    template <typename T, typename = void>
+    struct DefinesProgramEnd : std::false_type {};
+    template <typename T>
+    struct DefinesProgramEnd<T, std::void_t<decltype(&T::onProgramEnd)>>
+        : std::bool_constant<!std::is_same_v<decltype(&T::onProgramEnd),
+                                             void (InstrumentationTool::*)()>> {};
+
+public:
+    static constexpr bool PROGRAM_START = DefinesProgramStart<Tool>::value;
+    static constexpr bool BEFORE_INSTRUCTION = DefinesBeforeInstruction<Tool>::value;
+    static constexpr bool AFTER_INSTRUCTION = DefinesAfterInstruction<Tool>::value;
+    static constexpr bool PROGRAM_END = DefinesProgramEnd<Tool>::value;
+};
+
+// Two-phase instrumentation
+//
+// Instrumentation routines run once, when the engine first decodes a
+// block, and decide which analysis routines to insert and with which
+// arguments. The decision is cached with the block, so at run time an
+// instruction without inserted calls costs nothing extra.
+
+// Where an analysis call runs relative to its instruction
+enum class IPoint : uint8_t {
+    BEFORE,
+    AFTER
+};
+
+// Argument passed to an analysis routine, evaluated each time it runs
+struct IArg {
+    enum class Kind : uint8_t {
+        INST_PTR,           // PC of the instruction
+        RAW_INSTRUCTION,    // Encoding of the instruction
+        INSTRUCTION,        // const Instruction* to the decoded record
+        MEMORY_EA,          // Effective address, computed before execution
+        MEMORY_SIZE,        // Bytes accessed
+        REG_VALUE,          // Integer register value at the call point
+        HART_ID,            // Hart executing the instruction, see PerHart
+        CONSTANT
+    };
+
+    Kind kind;
+    uint64_t value;
+
+    static constexpr IArg instPtr() { return {Kind::INST_PTR, 0}; }
+    static constexpr IArg rawInstruction() { return {Kind::RAW_INSTRUCTION, 0}; }
+    static constexpr IArg instruction() { return {Kind::INSTRUCTION, 0}; }
+    static constexpr IArg memoryEa() { return {Kind::MEMORY_EA, 0}; }
+    static constexpr IArg memorySize() { return {Kind::MEMORY_SIZE, 0}; }
+    static constexpr IArg regValue(uint32_t reg) { return {Kind::REG_VALUE, reg}; }
+    static constexpr IArg hartId() { return {Kind::HART_ID, 0}; }
+    static constexpr IArg constant(uint64_t value) { return {Kind::CONSTANT, value}; }
+};
+
+constexpr size_t MAX_ANALYSIS_ARGS = 6;
+
+// Analysis routine: receives the context given at insertion time and the
+// requested arguments, in order
+using AnalysisRoutine = void (*)(void* context, const uint64_t* args);
+
+// One inserted call, stored with its block
+struct AnalysisCall {
+    AnalysisRoutine routine;
+    void* context;
+    uint16_t inst_index;
+    IPoint point;
+    uint8_t num_args;
+    IArg args[MAX_ANALYSIS_ARGS];
+};
+
+namespace detail {
+
+template <typename T>
+T fromArg(uint64_t value) {
+    if constexpr (std::is_pointer_v<T>) {
+        return reinterpret_cast<T>(static_cast<uintptr_t>(value));
+    } else {
+        return static_cast<T>(value);
+    }
 }
 
+// Adapts a typed routine, void(Context*, Params...), to AnalysisRoutine
+template <auto Routine, typename Context, typename... Params, size_t... I>
+void invokeTyped(void* context, const uint64_t* args, std::index_sequence<I...>) {
+    Routine(static_cast<Context*>(context), fromArg<Params>(args[I])...);
+}
+
+template <auto Routine, typename Context, typename... Params>
+void typedTrampoline(void* context, const uint64_t* args) {
+    invokeTyped<Routine, Context, Params...>(context, args,
+                                             std::index_sequence_for<Params...>{});
+}
+
+template <auto Routine, typename Context, typename... Params>
+constexpr AnalysisRoutine makeTrampoline(void (*)(Context*, Params...)) {
+    return &typedTrampoline<Routine, Context, Params...>;
+}
+
+template <typename F>
+struct RoutineArity;
+
+template <typename Context, typename... Params>
+struct RoutineArity<void (*)(Context*, Params...)> {
+    static constexpr size_t value = sizeof...(Params);
+};
+
+} // namespace detail
+
+// Handle on one instruction of a block being instrumented
+class InsHandle {
+public:
+    const Instruction& getInstruction() const { return inst_; }
+    uint64_t getAddress() const { return address_; }
+
+    bool isMemoryRead() const {
+        auto kind = isa::getOpInfo(inst_.getOpcodeId()).mem_kind;
+        return kind == isa::MemKind::LOAD || kind == isa::MemKind::AMO;
+    }
+    bool isMemoryWrite() const {
+        auto kind = isa::getOpInfo(inst_.getOpcodeId()).mem_kind;
+        return kind == isa::MemKind::STORE || kind == isa::MemKind::AMO;
+    }
+    uint32_t getMemorySize() const { return isa::getOpInfo(inst_.getOpcodeId()).mem_size; }
+    bool isSyscall() const { return inst_.getOpcodeId() == encoding::OP_ECALL; }
+
+    // Insert a call to an untyped routine
+    void insertCall(IPoint point, AnalysisRoutine routine, void* context,
+                    std::initializer_list<IArg> args) {
+        AnalysisCall call{routine, context, index_, point, 0, {}};
+        for (const IArg& arg : args) {
+            if (call.num_args == MAX_ANALYSIS_ARGS) {
+                break;
+            }
+            // The access size is fixed by the opcode, so it is resolved
+            // here rather than on every call
+            call.args[call.num_args++] =
+                arg.kind == IArg::Kind::MEMORY_SIZE ? IArg::constant(getMemorySize()) : arg;
+        }
+        calls_.push_back(call);
+    }
+
+    // Insert a call to a typed routine, e.g.
+    //   static void onLoad(MyTool* tool, uint64_t pc, uint64_t ea);
+    //   ins.insertCall<onLoad>(IPoint::BEFORE, this, IArg::instPtr(), IArg::memoryEa());
+    template <auto Routine, typename Context, typename... Args>
+    void insertCall(IPoint point, Context* context, Args... args) {
+        static_assert(detail::RoutineArity<decltype(Routine)>::value == sizeof...(Args),
+                      "Routine parameters must match the inserted arguments");
+        static_assert(sizeof...(Args) <= MAX_ANALYSIS_ARGS, "Too many analysis arguments");
+        insertCall(point, detail::makeTrampoline<Routine>(Routine),
+                   const_cast<std::remove_const_t<Context>*>(context), {args...});
+    }
+
+private:
+    friend class BlockHandle;
+    friend class rvpin::Engine;
+
+    InsHandle(const Instruction& inst, uint64_t address, uint16_t index,
+              std::vector<AnalysisCall>& calls)
+        : inst_(inst), address_(address), index_(index), calls_(calls) {}
+
+    const Instruction& inst_;
+    uint64_t address_;
+    uint16_t index_;
+    std::vector<AnalysisCall>& calls_;
+};
+
+// Handle on a newly discovered block
+class BlockHandle {
+public:
+    uint64_t getAddress() const { return address_; }
+    size_t getNumInstructions() const { return instructions_.size(); }
+
+    InsHandle getInstruction(size_t index) {
+        return InsHandle(instructions_[index], addresses_[index],
+                         static_cast<uint16_t>(index), calls_);
+    }
+
+    // Calls inserted on the block run each time it is entered
+    void insertCall(AnalysisRoutine routine, void* context, std::initializer_list<IArg> args) {
+        getInstruction(0).insertCall(IPoint::BEFORE, routine, context, args);
+    }
+
+    template <auto Routine, typename Context, typename... Args>
+    void insertCall(Context* context, Args... args) {
+        getInstruction(0).template insertCall<Routine>(IPoint::BEFORE, context, args...);
+    }
+
+private:
+    friend class rvpin::Engine;
+
+    BlockHandle(uint64_t address, const std::vector<Instruction>& instructions,
+                const std::vector<uint64_t>& addresses, std::vector<AnalysisCall>& calls)
+        : address_(address), instructions_(instructions), addresses_(addresses), calls_(calls) {}
+
+    uint64_t address_;
+    const std::vector<Instruction>& instructions_;
+    const std::vector<uint64_t>& addresses_;
+    std::vector<AnalysisCall>& calls_;
+};
+
+using InstructionInstrumentation = std::function<void(InsHandle&)>;
+using BlockInstrumentation = std::function<void(BlockHandle&)>;
+
+// Guest registers and memory for analysis routines: see guest.hpp
+
 } // namespace api
 } // namespace rvpin
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+namespace rvpin {
+namespace api {
+
+// Host cache line; per-hart slots never share one
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+// Tool-local storage with one T per hart. Each slot starts on its own
+// cache line, so harts running on different host threads only ever touch
+// their own lines: no locks, no atomics and no false sharing. The hart
+// running an analysis routine is passed in with IArg::hartId().
+//
+// Slots are read together only once the harts have stopped, e.g. in
+// onProgramEnd, with forEach() or merge().
+template <typename T>
+class PerHart {
+public:
+    explicit PerHart(uint32_t num_harts = 1)
+        : num_harts_(num_harts), slots_(std::make_unique<Slot[]>(num_harts)) {
+        if (num_harts == 0) {
+            throw std::invalid_argument("PerHart needs at least one hart");
+        }
+    }
+
+    T& operator[](uint32_t hart) { return slots_[hart].value; }
+    const T& operator[](uint32_t hart) const { return slots_[hart].value; }
+    uint32_t getNumHarts() const { return num_harts_; }
+
+    template <typename F>
+    void forEach(F&& f) const {
+        for (uint32_t hart = 0; hart < num_harts_; hart++) {
+            f(hart, slots_[hart].value);
+        }
+    }
+
+    // Fold the slots in hart order, so the result does not depend on how
+    // the harts were scheduled
+    template <typename Result, typename F>
+    Result merge(Result result, F&& combine) const {
+        for (uint32_t hart = 0; hart < num_harts_; hart++) {
+            combine(result, slots_[hart].value);
+        }
+        return result;
+    }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) Slot {
+        T value{};
+    };
+
+    uint32_t num_harts_;
+    std::unique_ptr<Slot[]> slots_;
+};
+
+// N event counters per hart, e.g. one per opcode or per syscall
+template <size_t N>
+class PerHartCounters {
+public:
+    explicit PerHartCounters(uint32_t num_harts = 1) : counters_(num_harts) {}
+
+    void add(uint32_t hart, size_t counter, uint64_t value = 1) {
+        counters_[hart][counter] += value;
+    }
+
+    uint64_t get(uint32_t hart, size_t counter) const { return counters_[hart][counter]; }
+    uint32_t getNumHarts() const { return counters_.getNumHarts(); }
+
+    // Every counter summed over the harts
+    std::array<uint64_t, N> total() const {
+        return counters_.merge(std::array<uint64_t, N>{},
+                               [](std::array<uint64_t, N>& sum, const std::array<uint64_t, N>& hart) {
+                                   for (size_t i = 0; i < N; i++) {
+                                       sum[i] += hart[i];
+                                   }
+                               });
+    }
+
+private:
+    PerHart<std::array<uint64_t, N>> counters_;
+};
+
+} // namespace api
+} // namespace rvpin
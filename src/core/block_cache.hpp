@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "instruction.hpp"
+#include "interpreter.hpp"
+#include "jit.hpp"
+#include "../api/instrumentation.hpp"
+
+namespace rvpin {
+
+// Straight-line run of decoded instructions ending at the first control
+// transfer, trap or fence.i
+struct BasicBlock {
+    uint64_t start_pc{0};
+    uint64_t end_pc{0};         // Address just past the last instruction
+    std::vector<Instruction> instructions;
+
+    // Analysis calls chosen by the instrumentation routines, ordered by
+    // instruction index and then IPoint. Empty for uninstrumented blocks.
+    std::vector<api::AnalysisCall> calls;
+
+    // The instructions lowered for threaded dispatch, for blocks without
+    // analysis calls. Empty when the engine steps through blocks instead.
+    std::vector<ThreadedOp> threaded;
+
+    // Host code for the block once it has run hot, valid while
+    // jit_generation matches the compiler's, see DispatchMode::JIT
+    JitEntry jit_entry{nullptr};
+    uint64_t jit_generation{0};
+    uint32_t executions{0};
+    bool jit_rejected{false};   // Holds something the compiler cannot handle
+
+    // Running this block ends the engine's current phase. Set on blocks
+    // ending in the phase's marker, and on the empty block standing in at
+    // the pc that ends it.
+    bool ends_phase{false};
+
+    // Most recent successor, so loops skip the cache lookup
+    uint64_t successor_pc{~0ull};
+    BasicBlock* successor{nullptr};
+};
+
+// Decoded blocks keyed by start PC. Blocks never move once inserted, so
+// pointers stay valid until clear().
+class BlockCache {
+public:
+    BasicBlock* find(uint64_t pc) {
+        auto it = blocks_.find(pc);
+        return it == blocks_.end() ? nullptr : &it->second;
+    }
+
+    BasicBlock& insert(BasicBlock&& block) {
+        uint64_t pc = block.start_pc;
+        return blocks_.insert_or_assign(pc, std::move(block)).first->second;
+    }
+
+    void clear() { blocks_.clear(); }
+    size_t size() const { return blocks_.size(); }
+
+private:
+    std::unordered_map<uint64_t, BasicBlock> blocks_;
+};
+
+} // namespace rvpin
@@ -0,0 +1,229 @@
+#include "engine.hpp"
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <unistd.h>
+#include <vector>
+
+// Checkpoint file layout, all integers in host byte order:
+//   magic "RVPINCKP", u32 version
+//   u64 entry, u64 ELF size            Identify the program
+//   CpuState: x[32], f[32], pc, u32 fcsr, instret, reservation
+//   u64 brk, u64 mmap top
+//   u64 count, count x {u32 fd, i32 flags, u32 mode, u64 offset,
+//                       u64 length, path}                Open files
+//   u64 count, count x {u64 start, u64 end, u8 perms}  Mapped ranges
+//   u64 count, count x {u64 addr, PAGE_SIZE bytes}     Dirty pages
+// Pages no store has touched are left out; restoring maps the program
+// again and writes the dirty ones over it. Open files are opened again
+// by path, without O_TRUNC or O_EXCL, at the offset they had.
+
+namespace rvpin {
+
+namespace {
+
+constexpr char CHECKPOINT_MAGIC[8] = {'R', 'V', 'P', 'I', 'N', 'C', 'K', 'P'};
+constexpr uint32_t CHECKPOINT_VERSION = 4;
+
+template <typename T>
+void put(std::ostream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+T get(std::istream& in) {
+    T value{};
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return value;
+}
+
+} // namespace
+
+bool Engine::saveCheckpoint(const std::string& path) {
+    if (!loaded_) {
+        std::cerr << "No program loaded\n";
+        return false;
+    }
+    std::ofstream out(path, std::ios::binary | std::ios::out);
+    if (!out) {
+        std::cerr << "Failed to open checkpoint " << path << "\n";
+        return false;
+    }
+
+    out.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    put(out, CHECKPOINT_VERSION);
+    put(out, entry_);
+    put(out, elf_->getSize());
+
+    put(out, state_.x);
+    put(out, state_.f);
+    put(out, state_.pc);
+    put(out, state_.fcsr);
+    put(out, state_.instret);
+    put(out, state_.reservation);
+    put(out, brk_);
+    put(out, mmap_top_);
+
+    uint64_t num_files = 0;
+    for (size_t fd = 3; fd < files_.size(); fd++) {
+        num_files += files_[fd].host >= 0;
+    }
+    put(out, num_files);
+    for (size_t fd = 3; fd < files_.size(); fd++) {
+        const GuestFile& file = files_[fd];
+        if (file.host < 0) {
+            continue;
+        }
+        const off_t offset = ::lseek(file.host, 0, SEEK_CUR);
+        put(out, uint32_t(fd));
+        put(out, int32_t(file.flags));
+        put(out, file.mode);
+        put(out, uint64_t(offset < 0 ? 0 : offset));
+        put(out, uint64_t(file.path.size()));
+        out.write(file.path.data(), std::streamsize(file.path.size()));
+    }
+
+    const std::vector<Memory::Range> ranges = memory_.getMappedRanges();
+    put(out, uint64_t(ranges.size()));
+    for (const Memory::Range& range : ranges) {
+        put(out, range.start);
+        put(out, range.end);
+        put(out, range.perms);
+    }
+
+    const std::vector<uint64_t> pages = memory_.getDirtyPages();
+    put(out, uint64_t(pages.size()));
+    std::vector<char> contents(Memory::PAGE_SIZE);
+    for (uint64_t addr : pages) {
+        memory_.read(addr, contents.data(), contents.size());
+        put(out, addr);
+        out.write(contents.data(), std::streamsize(contents.size()));
+    }
+
+    out.flush();
+    if (!out) {
+        std::cerr << "Failed to write checkpoint " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool Engine::restoreCheckpoint(const std::string& path) {
+    std::ifstream in(path, std::ios::binary | std::ios::in);
+    if (!in) {
+        std::cerr << "Failed to open checkpoint " << path << "\n";
+        return false;
+    }
+
+    char magic[sizeof(CHECKPOINT_MAGIC)] = {};
+    in.read(magic, sizeof(magic));
+    if (std::memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) != 0 ||
+        get<uint32_t>(in) != CHECKPOINT_VERSION) {
+        std::cerr << path << " is not an RVPin checkpoint\n";
+        return false;
+    }
+    const uint64_t entry = get<uint64_t>(in);
+    const uint64_t elf_size = get<uint64_t>(in);
+    if (entry != entry_ || elf_size != elf_->getSize()) {
+        std::cerr << "Checkpoint " << path << " was taken from another program\n";
+        return false;
+    }
+
+    CpuState state;
+    in.read(reinterpret_cast<char*>(state.x), sizeof(state.x));
+    in.read(reinterpret_cast<char*>(state.f), sizeof(state.f));
+    state.pc = get<uint64_t>(in);
+    state.fcsr = get<uint32_t>(in);
+    state.instret = get<uint64_t>(in);
+    state.reservation = get<uint64_t>(in);
+    const uint64_t brk = get<uint64_t>(in);
+    const uint64_t mmap_top = get<uint64_t>(in);
+
+    closeFiles();
+    const uint64_t num_files = get<uint64_t>(in);
+    for (uint64_t i = 0; i < num_files && in; i++) {
+        const uint32_t fd = get<uint32_t>(in);
+        const int flags = get<int32_t>(in);
+        const uint32_t mode = get<uint32_t>(in);
+        const uint64_t offset = get<uint64_t>(in);
+        const uint64_t length = get<uint64_t>(in);
+        if (fd < 3 || length > PATH_MAX) {
+            in.setstate(std::ios::failbit);
+            break;
+        }
+        std::string file(length, '\0');
+        in.read(file.data(), std::streamsize(file.size()));
+        if (!in) {
+            break;
+        }
+        const int host = openHost(AT_FDCWD, file, flags & ~(O_TRUNC | O_EXCL), mode);
+        if (host < 0) {
+            std::cerr << "Checkpoint " << path << " cannot open " << file << " again\n";
+            return false;
+        }
+        if (!(flags & O_APPEND)) {
+            ::lseek(host, static_cast<off_t>(offset), SEEK_SET);
+        }
+        if (files_.size() <= fd) {
+            files_.resize(fd + 1);
+        }
+        files_[fd] = GuestFile{host, file, flags, mode};
+    }
+
+    // The program's own segments and stack are mapped already; add what
+    // it mapped later and carry over permissions it changed. A range may
+    // be only partly mapped, like a heap grown on from the data segment.
+    const uint64_t num_ranges = get<uint64_t>(in);
+    try {
+        for (uint64_t i = 0; i < num_ranges && in; i++) {
+            const uint64_t start = get<uint64_t>(in);
+            const uint64_t end = get<uint64_t>(in);
+            const uint8_t perms = get<uint8_t>(in);
+            for (uint64_t page = start; page < end;) {
+                uint64_t next = page;
+                while (next < end && !memory_.isMapped(next)) {
+                    next += Memory::PAGE_SIZE;
+                }
+                if (next > page) {
+                    memory_.map(page, next - page, perms);
+                    page = next;
+                } else {
+                    page += Memory::PAGE_SIZE;
+                }
+            }
+            memory_.protect(start, end - start, perms);
+        }
+    } catch (const std::runtime_error&) {
+        std::cerr << "Checkpoint " << path << " maps memory outside the address space\n";
+        return false;
+    }
+
+    const uint64_t num_pages = get<uint64_t>(in);
+    std::vector<char> contents(Memory::PAGE_SIZE);
+    try {
+        for (uint64_t i = 0; i < num_pages && in; i++) {
+            const uint64_t addr = get<uint64_t>(in);
+            in.read(contents.data(), std::streamsize(contents.size()));
+            memory_.fill(addr, contents.data(), contents.size(), true);
+        }
+    } catch (const MemoryFault&) {
+        std::cerr << "Checkpoint " << path << " has a page outside its memory map\n";
+        return false;
+    }
+    if (!in) {
+        std::cerr << "Checkpoint " << path << " is truncated\n";
+        return false;
+    }
+
+    // The hart id belongs to this engine, not the checkpoint
+    state.hart_id = state_.hart_id;
+    state_ = state;
+    brk_ = brk;
+    mmap_top_ = mmap_top;
+    return true;
+}
+
+} // namespace rvpin
@@ -0,0 +1,245 @@
+#include "decoder.hpp"
+
+namespace rvpin {
+
+namespace {
+
+// Base-format encoders for the expanded instructions
+constexpr uint32_t encodeR(uint32_t opcode, uint32_t funct3, uint32_t funct7,
+                           uint32_t rd, uint32_t rs1, uint32_t rs2) {
+    return (funct7 << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) | (rd << 7) | opcode;
+}
+
+constexpr uint32_t encodeI(uint32_t opcode, uint32_t funct3, uint32_t rd, uint32_t rs1,
+                           int32_t imm) {
+    return (static_cast<uint32_t>(imm & 0xFFF) << 20) | (rs1 << 15) | (funct3 << 12) |
+           (rd << 7) | opcode;
+}
+
+constexpr uint32_t encodeS(uint32_t opcode, uint32_t funct3, uint32_t rs1, uint32_t rs2,
+                           int32_t imm) {
+    const uint32_t u = static_cast<uint32_t>(imm);
+    return (((u >> 5) & 0x7F) << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) |
+           ((u & 0x1F) << 7) | opcode;
+}
+
+constexpr uint32_t encodeB(uint32_t funct3, uint32_t rs1, uint32_t rs2, int32_t imm) {
+    const uint32_t u = static_cast<uint32_t>(imm);
+    return (((u >> 12) & 0x1) << 31) | (((u >> 5) & 0x3F) << 25) | (rs2 << 20) | (rs1 << 15) |
+           (funct3 << 12) | (((u >> 1) & 0xF) << 8) | (((u >> 11) & 0x1) << 7) | 0x63;
+}
+
+constexpr uint32_t encodeJ(uint32_t rd, int32_t imm) {
+    const uint32_t u = static_cast<uint32_t>(imm);
+    return (((u >> 20) & 0x1) << 31) | (((u >> 1) & 0x3FF) << 21) | (((u >> 11) & 0x1) << 20) |
+           (((u >> 12) & 0xFF) << 12) | (rd << 7) | 0x6F;
+}
+
+constexpr uint32_t OPC_LOAD = 0x03;
+constexpr uint32_t OPC_LOAD_FP = 0x07;
+constexpr uint32_t OPC_OP_IMM = 0x13;
+constexpr uint32_t OPC_OP_IMM_32 = 0x1B;
+constexpr uint32_t OPC_STORE = 0x23;
+constexpr uint32_t OPC_STORE_FP = 0x27;
+constexpr uint32_t OPC_OP = 0x33;
+constexpr uint32_t OPC_LUI = 0x37;
+constexpr uint32_t OPC_OP_32 = 0x3B;
+constexpr uint32_t OPC_JALR = 0x67;
+constexpr uint32_t EBREAK = 0x00100073;
+
+constexpr uint32_t REG_RA = 1;
+constexpr uint32_t REG_SP = 2;
+
+// Field extraction from a 16-bit parcel
+constexpr uint32_t bits(uint32_t c, uint32_t hi, uint32_t lo) {
+    return (c >> lo) & ((1u << (hi - lo + 1)) - 1);
+}
+
+constexpr int32_t signExtend(uint32_t value, uint32_t width) {
+    const uint32_t shift = 32 - width;
+    return static_cast<int32_t>(value << shift) >> shift;
+}
+
+// Registers x8-x15 in the 3-bit fields
+constexpr uint32_t regPrime(uint32_t c, uint32_t lo) { return bits(c, lo + 2, lo) + 8; }
+
+// 6-bit immediate of CI-format instructions: imm[5] = c[12], imm[4:0] = c[6:2]
+constexpr int32_t ciImmediate(uint32_t c) {
+    return signExtend((bits(c, 12, 12) << 5) | bits(c, 6, 2), 6);
+}
+
+// Offsets of the double-word and word CL/CS loads and stores
+constexpr int32_t clDoubleOffset(uint32_t c) {
+    return static_cast<int32_t>((bits(c, 12, 10) << 3) | (bits(c, 6, 5) << 6));
+}
+constexpr int32_t clWordOffset(uint32_t c) {
+    return static_cast<int32_t>((bits(c, 12, 10) << 3) | (bits(c, 6, 6) << 2) |
+                                (bits(c, 5, 5) << 6));
+}
+
+// RV64GC expansion of one parcel, 0 for illegal or reserved encodings.
+// HINT encodings expand to their base-ISA equivalents, which have no
+// architectural effect.
+uint32_t expand(uint32_t c) {
+    const uint32_t funct3 = bits(c, 15, 13);
+    const uint32_t rd = bits(c, 11, 7);
+    const uint32_t rs2 = bits(c, 6, 2);
+
+    switch (bits(c, 1, 0)) {
+        case 0:
+            switch (funct3) {
+                case 0: {  // c.addi4spn
+                    const int32_t imm = static_cast<int32_t>(
+                        (bits(c, 12, 11) << 4) | (bits(c, 10, 7) << 6) | (bits(c, 6, 6) << 2) |
+                        (bits(c, 5, 5) << 3));
+                    return imm == 0 ? 0 : encodeI(OPC_OP_IMM, 0, regPrime(c, 2), REG_SP, imm);
+                }
+                case 1:  // c.fld
+                    return encodeI(OPC_LOAD_FP, 3, regPrime(c, 2), regPrime(c, 7), clDoubleOffset(c));
+                case 2:  // c.lw
+                    return encodeI(OPC_LOAD, 2, regPrime(c, 2), regPrime(c, 7), clWordOffset(c));
+                case 3:  // c.ld
+                    return encodeI(OPC_LOAD, 3, regPrime(c, 2), regPrime(c, 7), clDoubleOffset(c));
+                case 5:  // c.fsd
+                    return encodeS(OPC_STORE_FP, 3, regPrime(c, 7), regPrime(c, 2), clDoubleOffset(c));
+                case 6:  // c.sw
+                    return encodeS(OPC_STORE, 2, regPrime(c, 7), regPrime(c, 2), clWordOffset(c));
+                case 7:  // c.sd
+                    return encodeS(OPC_STORE, 3, regPrime(c, 7), regPrime(c, 2), clDoubleOffset(c));
+                default:
+                    return 0;
+            }
+
+        case 1:
+            switch (funct3) {
+                case 0:  // c.addi, c.nop
+                    return encodeI(OPC_OP_IMM, 0, rd, rd, ciImmediate(c));
+                case 1:  // c.addiw
+                    return rd == 0 ? 0 : encodeI(OPC_OP_IMM_32, 0, rd, rd, ciImmediate(c));
+                case 2:  // c.li
+                    return encodeI(OPC_OP_IMM, 0, rd, 0, ciImmediate(c));
+                case 3: {
+                    if (rd == REG_SP) {  // c.addi16sp
+                        const int32_t imm = signExtend(
+                            (bits(c, 12, 12) << 9) | (bits(c, 6, 6) << 4) | (bits(c, 5, 5) << 6) |
+                                (bits(c, 4, 3) << 7) | (bits(c, 2, 2) << 5),
+                            10);
+                        return imm == 0 ? 0 : encodeI(OPC_OP_IMM, 0, REG_SP, REG_SP, imm);
+                    }
+                    // c.lui
+                    const int32_t imm = ciImmediate(c);
+                    return imm == 0 ? 0
+                                    : (static_cast<uint32_t>(imm) << 12) | (rd << 7) | OPC_LUI;
+                }
+                case 4: {
+                    const uint32_t rdp = regPrime(c, 7);
+                    const uint32_t shamt = (bits(c, 12, 12) << 5) | bits(c, 6, 2);
+                    switch (bits(c, 11, 10)) {
+                        case 0:  // c.srli
+                            return encodeI(OPC_OP_IMM, 5, rdp, rdp, static_cast<int32_t>(shamt));
+                        case 1:  // c.srai
+                            return encodeI(OPC_OP_IMM, 5, rdp, rdp,
+                                           static_cast<int32_t>(shamt | 0x400));
+                        case 2:  // c.andi
+                            return encodeI(OPC_OP_IMM, 7, rdp, rdp, ciImmediate(c));
+                        default: {
+                            const uint32_t rs2p = regPrime(c, 2);
+                            static constexpr struct {
+                                uint32_t opcode, funct3, funct7;
+                            } ARITH[8] = {
+                                {OPC_OP, 0, 0x20},     // c.sub
+                                {OPC_OP, 4, 0},        // c.xor
+                                {OPC_OP, 6, 0},        // c.or
+                                {OPC_OP, 7, 0},        // c.and
+                                {OPC_OP_32, 0, 0x20},  // c.subw
+                                {OPC_OP_32, 0, 0},     // c.addw
+                                {0, 0, 0},             // reserved
+                                {0, 0, 0},             // reserved
+                            };
+                            const auto& op = ARITH[(bits(c, 12, 12) << 2) | bits(c, 6, 5)];
+                            return op.opcode == 0
+                                       ? 0
+                                       : encodeR(op.opcode, op.funct3, op.funct7, rdp, rdp, rs2p);
+                        }
+                    }
+                }
+                case 5: {  // c.j
+                    const int32_t imm = signExtend(
+                        (bits(c, 12, 12) << 11) | (bits(c, 11, 11) << 4) | (bits(c, 10, 9) << 8) |
+                            (bits(c, 8, 8) << 10) | (bits(c, 7, 7) << 6) | (bits(c, 6, 6) << 7) |
+                            (bits(c, 5, 3) << 1) | (bits(c, 2, 2) << 5),
+                        12);
+                    return encodeJ(0, imm);
+                }
+                default: {  // c.beqz, c.bnez
+                    const int32_t imm = signExtend(
+                        (bits(c, 12, 12) << 8) | (bits(c, 11, 10) << 3) | (bits(c, 6, 5) << 6) |
+                            (bits(c, 4, 3) << 1) | (bits(c, 2, 2) << 5),
+                        9);
+                    return encodeB(funct3 == 6 ? 0 : 1, regPrime(c, 7), 0, imm);
+                }
+            }
+
+        case 2:
+            switch (funct3) {
+                case 0:  // c.slli
+                    return encodeI(OPC_OP_IMM, 1, rd, rd,
+                                   static_cast<int32_t>((bits(c, 12, 12) << 5) | bits(c, 6, 2)));
+                case 1:  // c.fldsp
+                    return encodeI(OPC_LOAD_FP, 3, rd, REG_SP,
+                                   static_cast<int32_t>((bits(c, 12, 12) << 5) | (bits(c, 6, 5) << 3) |
+                                                        (bits(c, 4, 2) << 6)));
+                case 2:  // c.lwsp
+                    return rd == 0 ? 0
+                                   : encodeI(OPC_LOAD, 2, rd, REG_SP,
+                                             static_cast<int32_t>((bits(c, 12, 12) << 5) |
+                                                                  (bits(c, 6, 4) << 2) |
+                                                                  (bits(c, 3, 2) << 6)));
+                case 3:  // c.ldsp
+                    return rd == 0 ? 0
+                                   : encodeI(OPC_LOAD, 3, rd, REG_SP,
+                                             static_cast<int32_t>((bits(c, 12, 12) << 5) |
+                                                                  (bits(c, 6, 5) << 3) |
+                                                                  (bits(c, 4, 2) << 6)));
+                case 4:
+                    if (bits(c, 12, 12) == 0) {
+                        if (rs2 == 0) {  // c.jr
+                            return rd == 0 ? 0 : encodeI(OPC_JALR, 0, 0, rd, 0);
+                        }
+                        return encodeR(OPC_OP, 0, 0, rd, 0, rs2);  // c.mv
+                    }
+                    if (rs2 == 0) {
+                        // c.ebreak, c.jalr
+                        return rd == 0 ? EBREAK : encodeI(OPC_JALR, 0, REG_RA, rd, 0);
+                    }
+                    return encodeR(OPC_OP, 0, 0, rd, rd, rs2);  // c.add
+                case 5:  // c.fsdsp
+                    return encodeS(OPC_STORE_FP, 3, REG_SP, rs2,
+                                   static_cast<int32_t>((bits(c, 12, 10) << 3) | (bits(c, 9, 7) << 6)));
+                case 6:  // c.swsp
+                    return encodeS(OPC_STORE, 2, REG_SP, rs2,
+                                   static_cast<int32_t>((bits(c, 12, 9) << 2) | (bits(c, 8, 7) << 6)));
+                default:  // c.sdsp
+                    return encodeS(OPC_STORE, 3, REG_SP, rs2,
+                                   static_cast<int32_t>((bits(c, 12, 10) << 3) | (bits(c, 9, 7) << 6)));
+            }
+
+        default:
+            return 0;  // Not a compressed parcel
+    }
+}
+
+} // namespace
+
+const Decoder::CompressedTable& Decoder::compressedTable() {
+    static const CompressedTable table = [] {
+        CompressedTable t{};
+        for (uint32_t parcel = 0; parcel < t.size(); ++parcel) {
+            t[parcel] = expand(parcel);
+        }
+        return t;
+    }();
+    return table;
+}
+
+} // namespace rvpin
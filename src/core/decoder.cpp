@@ -3,23 +3,21 @@
 
 namespace rvpin {
 
-std::unique_ptr<Instruction> Decoder::decode(uint32_t raw_inst) {
-    if (!isValidInstruction(raw_inst)) {
-        return nullptr;
-    }
-    return std::make_unique<Instruction>(raw_inst);
+std::vector<Instruction> Decoder::decodeSequence(
+    const uint32_t* instructions, size_t count) const {
+    std::vector<Instruction> result(count);
+    decodeSequence(instructions, count, result.data());
+    return result;
 }
 
-std::vector<std::unique_ptr<Instruction>> Decoder::decodeSequence(
-    const uint32_t* instructions, size_t count) {
-    std::vector<std::unique_ptr<Instruction>> result;
+size_t Decoder::decodeSequence(
+    const uint32_t* instructions, size_t count, Instruction* out) const {
+    size_t valid = 0;
     for (size_t i = 0; i < count; ++i) {
-        auto inst = decode(instructions[i]);
-        if (inst) {
-            result.push_back(std::move(inst));
-        }
+        out[i] = decode(instructions[i]);
+        valid += out[i].isValid();
     }
-    return result;
+    return valid;
 }
 
 bool Decoder::isValidInstruction(uint32_t raw_inst) const {
@@ -27,27 +25,76 @@ bool Decoder::isValidInstruction(uint32_t raw_inst) const {
     if (raw_inst == 0 || raw_inst == 0xFFFFFFFF) {
         return false;
     }
-    
-    // Check if the instruction matches any known encoding
-    for (const auto& encoding : encoding::INSTRUCTION_ENCODINGS) {
-        if ((raw_inst & encoding.mask) == (encoding.match & encoding.mask)) {
-            return true;
-        }
+
+    // Compressed instructions only use the low 16 bits
+    if ((raw_inst & 0x3) != 0x3) {
+        uint32_t expanded = expandCompressed(static_cast<uint16_t>(raw_inst));
+        return expanded != 0 && lookup(expanded) >= 0;
     }
-    
-    // Special case for ECALL
-    if (raw_inst == 0x00000073) {
-        return true;
+
+    return lookup(raw_inst) >= 0;
+}
+
+int Decoder::lookup(uint32_t raw_inst) {
+    const DecodingTables& t = tables();
+    const Bucket& bucket = t.buckets[bucketIndex(raw_inst)];
+    for (uint16_t i = bucket.begin; i < bucket.end; ++i) {
+        const Candidate& c = t.candidates[i];
+        if ((raw_inst & c.mask) == c.match) {
+            return c.index;
+        }
     }
-    
-    // Check if it's a compressed instruction (16-bit)
-    // TODO: Add support for compressed instructions
-    
-    return false;
+    return -1;
+}
+
+const Decoder::DecodingTables& Decoder::tables() {
+    static const DecodingTables tables = [] {
+        DecodingTables t;
+        initDecodingTables(t);
+        return t;
+    }();
+    return tables;
 }
 
-void Decoder::initDecodingTables() {
-    // TODO: Initialize lookup tables for instruction decoding
+void Decoder::initDecodingTables(DecodingTables& tables) {
+    // Bits that select a bucket: opcode (including the 0b11 length bits)
+    // and funct3. Everything else, funct7 included, is left to the
+    // candidate mask compare.
+    constexpr uint32_t KEY_MASK = 0x0000707F;
+
+    tables.candidates.clear();
+    for (uint32_t b = 0; b < tables.buckets.size(); ++b) {
+        const uint32_t key_bits = 0x3 | ((b & 0x1F) << 2) | ((b >> 5) << 12);
+        Bucket& bucket = tables.buckets[b];
+        bucket.begin = static_cast<uint16_t>(tables.candidates.size());
+
+        for (size_t i = 0; i < encoding::NUM_ENCODINGS; ++i) {
+            const auto& enc = encoding::INSTRUCTION_ENCODINGS[i];
+            const uint32_t match = enc.match & enc.mask;
+            if ((key_bits & enc.mask & KEY_MASK) != (match & KEY_MASK)) {
+                continue;
+            }
+
+            // Table order decides overlaps: drop an entry if an earlier
+            // candidate already matches everything it matches. This is
+            // what removes exact duplicates (slli_rv32 behind slli) and
+            // pseudo-instructions (j behind jal, nop behind addi).
+            bool shadowed = false;
+            for (size_t c = bucket.begin; c < tables.candidates.size(); ++c) {
+                const Candidate& prev = tables.candidates[c];
+                if ((prev.mask & enc.mask) == prev.mask &&
+                    (match & prev.mask) == prev.match) {
+                    shadowed = true;
+                    break;
+                }
+            }
+            if (!shadowed) {
+                tables.candidates.push_back(
+                    {enc.mask, match, static_cast<uint16_t>(i)});
+            }
+        }
+        bucket.end = static_cast<uint16_t>(tables.candidates.size());
+    }
 }
 
 } // namespace rvpin
@@ -1,6 +1,6 @@
 #pragma once
 
-#include <memory>
+#include <array>
 #include <vector>
 #include "instruction.hpp"
 
@@ -9,19 +9,59 @@ namespace rvpin {
 class Decoder {
 public:
     Decoder() = default;
-    
-    // Decode a single instruction
-    std::unique_ptr<Instruction> decode(uint32_t raw_inst);
-    
-    // Decode a sequence of instructions
-    std::vector<std::unique_ptr<Instruction>> decodeSequence(const uint32_t* instructions, size_t count);
-    
+
+    // Decode a single instruction. Invalid encodings come back with
+    // isValid() == false rather than as a missing value.
+    Instruction decode(uint32_t raw_inst) const { return Instruction(raw_inst); }
+
+    // Decode a sequence of instructions, one output per input word
+    std::vector<Instruction> decodeSequence(const uint32_t* instructions, size_t count) const;
+
+    // Decode into caller-provided storage; out must hold count entries.
+    // Returns the number of valid instructions.
+    size_t decodeSequence(const uint32_t* instructions, size_t count, Instruction* out) const;
+
     // Check if an address contains a valid instruction
     bool isValidInstruction(uint32_t raw_inst) const;
-    
+
+    // Index into encoding::INSTRUCTION_ENCODINGS of the encoding that
+    // matches raw_inst, or -1 if none does. When several encodings match,
+    // the one listed first in the table wins.
+    static int lookup(uint32_t raw_inst);
+
+    // 32-bit equivalent of a 16-bit RVC parcel, or 0 if the parcel is
+    // reserved, illegal or not compressed. One table load per parcel.
+    static uint32_t expandCompressed(uint16_t parcel) { return compressedTable()[parcel]; }
+
 private:
+    using CompressedTable = std::array<uint32_t, 65536>;
+
+    // Candidate encoding, with match pre-masked
+    struct Candidate {
+        uint32_t mask;
+        uint32_t match;
+        uint16_t index;
+    };
+
+    // Range of candidates sharing one opcode[6:2]/funct3 pair
+    struct Bucket {
+        uint16_t begin;
+        uint16_t end;
+    };
+
+    struct DecodingTables {
+        std::array<Bucket, 256> buckets;
+        std::vector<Candidate> candidates;
+    };
+
+    static size_t bucketIndex(uint32_t raw_inst) {
+        return ((raw_inst >> 2) & 0x1F) | (((raw_inst >> 12) & 0x7) << 5);
+    }
+
     // Internal decoding tables and utilities
-    void initDecodingTables();
+    static const DecodingTables& tables();
+    static void initDecodingTables(DecodingTables& tables);
+    static const CompressedTable& compressedTable();
 };
 
 } // namespace rvpin
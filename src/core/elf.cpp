@@ -0,0 +1,182 @@
+#include "elf.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace rvpin {
+namespace elf {
+
+constexpr unsigned char ELF_MAGIC[4] = {0x7f, 'E', 'L', 'F'};
+constexpr size_t EI_CLASS = 4;
+constexpr size_t EI_DATA = 5;
+constexpr unsigned char ELFCLASS64 = 2;
+constexpr unsigned char ELFDATA2LSB = 1;
+
+ElfFile::ElfFile(const std::string& path) : path_(path) {
+    fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0) {
+        throw std::runtime_error("Failed to open " + path);
+    }
+    struct stat st;
+    if (::fstat(fd_, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(Elf64_Ehdr))) {
+        ::close(fd_);
+        throw std::runtime_error("Not an ELF file: " + path);
+    }
+    size_ = static_cast<uint64_t>(st.st_size);
+
+    // Only touched pages are read in, so large binaries cost address
+    // space rather than memory
+    void* data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (data == MAP_FAILED) {
+        ::close(fd_);
+        throw std::runtime_error("Failed to map " + path);
+    }
+    data_ = static_cast<const uint8_t*>(data);
+
+    try {
+        const Elf64_Ehdr& header = getHeader();
+        if (std::memcmp(header.e_ident, ELF_MAGIC, sizeof(ELF_MAGIC)) != 0) {
+            throw std::runtime_error("Invalid ELF magic number");
+        }
+        if (header.e_ident[EI_CLASS] != ELFCLASS64) {
+            throw std::runtime_error("Not a 64-bit ELF file");
+        }
+        if (header.e_ident[EI_DATA] != ELFDATA2LSB) {
+            throw std::runtime_error("Not a little-endian ELF file");
+        }
+        if (header.e_machine != EM_RISCV) {
+            throw std::runtime_error("Not a RISC-V ELF file");
+        }
+        if (header.e_type != ET_EXEC && header.e_type != ET_DYN) {
+            throw std::runtime_error("Not an executable");
+        }
+        if (header.e_phnum == 0 || header.e_phentsize != sizeof(Elf64_Phdr) ||
+            header.e_phoff % alignof(Elf64_Phdr) != 0 ||
+            !inBounds(header.e_phoff, uint64_t(header.e_phnum) * sizeof(Elf64_Phdr))) {
+            throw std::runtime_error("Invalid program headers");
+        }
+
+        const Elf64_Phdr* phdrs = getProgramHeaders();
+        for (size_t i = 0; i < header.e_phnum; ++i) {
+            const Elf64_Phdr& phdr = phdrs[i];
+            if (phdr.p_type != PT_LOAD) {
+                continue;
+            }
+            if (phdr.p_filesz > phdr.p_memsz) {
+                throw std::runtime_error("Segment file size exceeds memory size");
+            }
+            if (!inBounds(phdr.p_offset, phdr.p_filesz)) {
+                throw std::runtime_error("Segment extends past end of file");
+            }
+            if (phdr.p_vaddr + phdr.p_memsz < phdr.p_vaddr) {
+                throw std::runtime_error("Segment wraps the address space");
+            }
+        }
+    } catch (...) {
+        ::munmap(const_cast<uint8_t*>(data_), size_);
+        ::close(fd_);
+        throw;
+    }
+}
+
+ElfFile::~ElfFile() {
+    ::munmap(const_cast<uint8_t*>(data_), size_);
+    ::close(fd_);
+}
+
+const std::vector<Symbol>& ElfFile::getSymbols() const {
+    if (!symbols_loaded_) {
+        loadSymbols();
+        symbols_loaded_ = true;
+    }
+    return symbols_;
+}
+
+const Symbol* ElfFile::findSymbol(std::string_view name) const {
+    for (const Symbol& symbol : getSymbols()) {
+        if (symbol.name == name) {
+            return &symbol;
+        }
+    }
+    return nullptr;
+}
+
+const Symbol* ElfFile::findSymbolAt(uint64_t addr) const {
+    // Nearest symbol at or below addr. Sized symbols must contain it;
+    // unsized ones, typically assembly labels, extend to the next symbol.
+    const auto& symbols = getSymbols();
+    auto it = std::upper_bound(symbols.begin(), symbols.end(), addr,
+                               [](uint64_t a, const Symbol& s) { return a < s.value; });
+    if (it == symbols.begin()) {
+        return nullptr;
+    }
+    --it;
+    if (it->size != 0 && addr - it->value >= it->size) {
+        return nullptr;
+    }
+    return &*it;
+}
+
+void ElfFile::loadSymbols() const {
+    const Elf64_Ehdr& header = getHeader();
+    if (header.e_shnum == 0 || header.e_shentsize != sizeof(Elf64_Shdr) ||
+        header.e_shoff % alignof(Elf64_Shdr) != 0 ||
+        !inBounds(header.e_shoff, uint64_t(header.e_shnum) * sizeof(Elf64_Shdr))) {
+        return;  // No usable section headers, e.g. a stripped loader image
+    }
+    const auto* sections = reinterpret_cast<const Elf64_Shdr*>(data_ + header.e_shoff);
+
+    const Elf64_Shdr* symtab = nullptr;
+    const Elf64_Shdr* dynsym = nullptr;
+    for (size_t i = 0; i < header.e_shnum; ++i) {
+        if (sections[i].sh_type == SHT_SYMTAB && !symtab) {
+            symtab = &sections[i];
+        } else if (sections[i].sh_type == SHT_DYNSYM && !dynsym) {
+            dynsym = &sections[i];
+        }
+    }
+    if (symtab || dynsym) {
+        loadSymbolTable(sections, header.e_shnum, symtab ? *symtab : *dynsym);
+    }
+    std::stable_sort(symbols_.begin(), symbols_.end(),
+                     [](const Symbol& a, const Symbol& b) { return a.value < b.value; });
+}
+
+void ElfFile::loadSymbolTable(const Elf64_Shdr* sections, size_t count,
+                              const Elf64_Shdr& table) const {
+    if (table.sh_entsize != sizeof(Elf64_Sym) || table.sh_offset % alignof(Elf64_Sym) != 0 ||
+        !inBounds(table.sh_offset, table.sh_size) || table.sh_link >= count) {
+        throw std::runtime_error("Invalid symbol table in " + path_);
+    }
+    const Elf64_Shdr& strtab = sections[table.sh_link];
+    if (!inBounds(strtab.sh_offset, strtab.sh_size)) {
+        throw std::runtime_error("Invalid string table in " + path_);
+    }
+    const char* strings = reinterpret_cast<const char*>(data_ + strtab.sh_offset);
+
+    const auto* syms = reinterpret_cast<const Elf64_Sym*>(data_ + table.sh_offset);
+    size_t num_syms = table.sh_size / sizeof(Elf64_Sym);
+    for (size_t i = 0; i < num_syms; ++i) {
+        const Elf64_Sym& sym = syms[i];
+        uint8_t type = sym.st_info & 0xF;
+        if (sym.st_name == 0 || sym.st_shndx == 0 || sym.st_name >= strtab.sh_size ||
+            type == STT_SECTION || type == STT_FILE) {
+            continue;  // Unnamed, undefined or not an address
+        }
+        // Names must be terminated inside the table
+        const char* name = strings + sym.st_name;
+        const void* nul = std::memchr(name, '\0', strtab.sh_size - sym.st_name);
+        if (!nul) {
+            continue;
+        }
+        symbols_.push_back({std::string_view(name, static_cast<const char*>(nul) - name),
+                            sym.st_value, sym.st_size, type});
+    }
+}
+
+} // namespace elf
+} // namespace rvpin
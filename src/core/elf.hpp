@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rvpin {
+namespace elf {
+
+constexpr uint16_t ET_EXEC = 2;
+constexpr uint16_t ET_DYN = 3;
+constexpr uint16_t EM_RISCV = 243;
+constexpr uint32_t PT_LOAD = 1;
+constexpr uint32_t PT_PHDR = 6;
+constexpr uint32_t PF_X = 1;
+constexpr uint32_t PF_W = 2;
+constexpr uint32_t PF_R = 4;
+constexpr uint32_t SHT_SYMTAB = 2;
+constexpr uint32_t SHT_DYNSYM = 11;
+constexpr uint8_t STT_OBJECT = 1;
+constexpr uint8_t STT_FUNC = 2;
+constexpr uint8_t STT_SECTION = 3;
+constexpr uint8_t STT_FILE = 4;
+
+struct Elf64_Ehdr {
+    unsigned char e_ident[16];
+    uint16_t e_type;
+    uint16_t e_machine;
+    uint32_t e_version;
+    uint64_t e_entry;
+    uint64_t e_phoff;
+    uint64_t e_shoff;
+    uint32_t e_flags;
+    uint16_t e_ehsize;
+    uint16_t e_phentsize;
+    uint16_t e_phnum;
+    uint16_t e_shentsize;
+    uint16_t e_shnum;
+    uint16_t e_shstrndx;
+};
+
+struct Elf64_Phdr {
+    uint32_t p_type;
+    uint32_t p_flags;
+    uint64_t p_offset;
+    uint64_t p_vaddr;
+    uint64_t p_paddr;
+    uint64_t p_filesz;
+    uint64_t p_memsz;
+    uint64_t p_align;
+};
+
+struct Elf64_Shdr {
+    uint32_t sh_name;
+    uint32_t sh_type;
+    uint64_t sh_flags;
+    uint64_t sh_addr;
+    uint64_t sh_offset;
+    uint64_t sh_size;
+    uint32_t sh_link;
+    uint32_t sh_info;
+    uint64_t sh_addralign;
+    uint64_t sh_entsize;
+};
+
+struct Elf64_Sym {
+    uint32_t st_name;
+    uint8_t st_info;
+    uint8_t st_other;
+    uint16_t st_shndx;
+    uint64_t st_value;
+    uint64_t st_size;
+};
+
+struct Symbol {
+    std::string_view name;      // Points into the mapped file
+    uint64_t value;
+    uint64_t size;
+    uint8_t type;               // STT_*
+};
+
+// Read-only mapping of an RV64 little-endian ELF executable. The header
+// and program headers are validated on open; section headers and symbol
+// tables are only parsed when first asked for. Throws std::runtime_error
+// on malformed input.
+class ElfFile {
+public:
+    explicit ElfFile(const std::string& path);
+    ~ElfFile();
+    ElfFile(const ElfFile&) = delete;
+    ElfFile& operator=(const ElfFile&) = delete;
+
+    const std::string& getPath() const { return path_; }
+    int getFd() const { return fd_; }
+    uint64_t getSize() const { return size_; }
+    const uint8_t* getData() const { return data_; }
+
+    const Elf64_Ehdr& getHeader() const { return *reinterpret_cast<const Elf64_Ehdr*>(data_); }
+    const Elf64_Phdr* getProgramHeaders() const {
+        return reinterpret_cast<const Elf64_Phdr*>(data_ + getHeader().e_phoff);
+    }
+    size_t getNumProgramHeaders() const { return getHeader().e_phnum; }
+
+    // Defined symbols from .symtab, or from .dynsym when the binary is
+    // stripped, sorted by address
+    const std::vector<Symbol>& getSymbols() const;
+    const Symbol* findSymbol(std::string_view name) const;
+    const Symbol* findSymbolAt(uint64_t addr) const;
+
+private:
+    bool inBounds(uint64_t offset, uint64_t size) const {
+        return offset <= size_ && size <= size_ - offset;
+    }
+    void loadSymbols() const;
+    void loadSymbolTable(const Elf64_Shdr* sections, size_t count, const Elf64_Shdr& table) const;
+
+    std::string path_;
+    int fd_ = -1;
+    const uint8_t* data_ = nullptr;
+    uint64_t size_ = 0;
+
+    mutable bool symbols_loaded_ = false;
+    mutable std::vector<Symbol> symbols_;
+};
+
+} // namespace elf
+} // namespace rvpin
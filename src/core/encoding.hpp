@@ -4,15 +4,16 @@
 #pragma once
 #include <cstdint>
 #include <cstddef>
+#include <string_view>
 
 namespace rvpin {
 namespace encoding {
 
 struct InstructionEncoding {
-    const char* name;
+    std::string_view name;
     uint32_t mask;
     uint32_t match;
-    const char* extension;
+    std::string_view extension;
 };
 
 constexpr InstructionEncoding INSTRUCTION_ENCODINGS[] = {
@@ -55,6 +56,125 @@ constexpr InstructionEncoding INSTRUCTION_ENCODINGS[] = {
     {"ebreak", 0xffffffff, 0x00100073, "RV_I"},
     {"fence_tso", 0xfff0707f, 0x8330000f, "RV_I"},
     {"pause", 0xffffffff, 0x0100000f, "RV_I"},
+    {"mul", 0xfe00707f, 0x02000033, "RV_M"},
+    {"mulh", 0xfe00707f, 0x02001033, "RV_M"},
+    {"mulhsu", 0xfe00707f, 0x02002033, "RV_M"},
+    {"mulhu", 0xfe00707f, 0x02003033, "RV_M"},
+    {"div", 0xfe00707f, 0x02004033, "RV_M"},
+    {"divu", 0xfe00707f, 0x02005033, "RV_M"},
+    {"rem", 0xfe00707f, 0x02006033, "RV_M"},
+    {"remu", 0xfe00707f, 0x02007033, "RV_M"},
+    {"lr_w", 0xf9f0707f, 0x1000202f, "RV_A"},
+    {"sc_w", 0xf800707f, 0x1800202f, "RV_A"},
+    {"amoadd_w", 0xf800707f, 0x0000202f, "RV_A"},
+    {"amoxor_w", 0xf800707f, 0x2000202f, "RV_A"},
+    {"amoor_w", 0xf800707f, 0x4000202f, "RV_A"},
+    {"amoand_w", 0xf800707f, 0x6000202f, "RV_A"},
+    {"amomin_w", 0xf800707f, 0x8000202f, "RV_A"},
+    {"amomax_w", 0xf800707f, 0xa000202f, "RV_A"},
+    {"amominu_w", 0xf800707f, 0xc000202f, "RV_A"},
+    {"amomaxu_w", 0xf800707f, 0xe000202f, "RV_A"},
+    {"amoswap_w", 0xf800707f, 0x0800202f, "RV_A"},
+    {"flw", 0x0000707f, 0x00002007, "RV_F"},
+    {"fsw", 0x0000707f, 0x00002027, "RV_F"},
+    {"fmadd_s", 0x0600007f, 0x00000043, "RV_F"},
+    {"fmsub_s", 0x0600007f, 0x00000047, "RV_F"},
+    {"fnmsub_s", 0x0600007f, 0x0000004b, "RV_F"},
+    {"fnmadd_s", 0x0600007f, 0x0000004f, "RV_F"},
+    {"fadd_s", 0xfe00007f, 0x00000053, "RV_F"},
+    {"fsub_s", 0xfe00007f, 0x08000053, "RV_F"},
+    {"fmul_s", 0xfe00007f, 0x10000053, "RV_F"},
+    {"fdiv_s", 0xfe00007f, 0x18000053, "RV_F"},
+    {"fsqrt_s", 0xfff0007f, 0x58000053, "RV_F"},
+    {"fsgnj_s", 0xfe00707f, 0x20000053, "RV_F"},
+    {"fsgnjn_s", 0xfe00707f, 0x20001053, "RV_F"},
+    {"fsgnjx_s", 0xfe00707f, 0x20002053, "RV_F"},
+    {"fmin_s", 0xfe00707f, 0x28000053, "RV_F"},
+    {"fmax_s", 0xfe00707f, 0x28001053, "RV_F"},
+    {"fcvt_w_s", 0xfff0007f, 0xc0000053, "RV_F"},
+    {"fcvt_wu_s", 0xfff0007f, 0xc0100053, "RV_F"},
+    {"fmv_x_w", 0xfff0707f, 0xe0000053, "RV_F"},
+    {"feq_s", 0xfe00707f, 0xa0002053, "RV_F"},
+    {"flt_s", 0xfe00707f, 0xa0001053, "RV_F"},
+    {"fle_s", 0xfe00707f, 0xa0000053, "RV_F"},
+    {"fclass_s", 0xfff0707f, 0xe0001053, "RV_F"},
+    {"fcvt_s_w", 0xfff0007f, 0xd0000053, "RV_F"},
+    {"fcvt_s_wu", 0xfff0007f, 0xd0100053, "RV_F"},
+    {"fmv_w_x", 0xfff0707f, 0xf0000053, "RV_F"},
+    {"fld", 0x0000707f, 0x00003007, "RV_D"},
+    {"fsd", 0x0000707f, 0x00003027, "RV_D"},
+    {"fmadd_d", 0x0600007f, 0x02000043, "RV_D"},
+    {"fmsub_d", 0x0600007f, 0x02000047, "RV_D"},
+    {"fnmsub_d", 0x0600007f, 0x0200004b, "RV_D"},
+    {"fnmadd_d", 0x0600007f, 0x0200004f, "RV_D"},
+    {"fadd_d", 0xfe00007f, 0x02000053, "RV_D"},
+    {"fsub_d", 0xfe00007f, 0x0a000053, "RV_D"},
+    {"fmul_d", 0xfe00007f, 0x12000053, "RV_D"},
+    {"fdiv_d", 0xfe00007f, 0x1a000053, "RV_D"},
+    {"fsqrt_d", 0xfff0007f, 0x5a000053, "RV_D"},
+    {"fsgnj_d", 0xfe00707f, 0x22000053, "RV_D"},
+    {"fsgnjn_d", 0xfe00707f, 0x22001053, "RV_D"},
+    {"fsgnjx_d", 0xfe00707f, 0x22002053, "RV_D"},
+    {"fmin_d", 0xfe00707f, 0x2a000053, "RV_D"},
+    {"fmax_d", 0xfe00707f, 0x2a001053, "RV_D"},
+    {"fcvt_s_d", 0xfff0007f, 0x40100053, "RV_D"},
+    {"fcvt_d_s", 0xfff0007f, 0x42000053, "RV_D"},
+    {"feq_d", 0xfe00707f, 0xa2002053, "RV_D"},
+    {"flt_d", 0xfe00707f, 0xa2001053, "RV_D"},
+    {"fle_d", 0xfe00707f, 0xa2000053, "RV_D"},
+    {"fclass_d", 0xfff0707f, 0xe2001053, "RV_D"},
+    {"fcvt_w_d", 0xfff0007f, 0xc2000053, "RV_D"},
+    {"fcvt_wu_d", 0xfff0007f, 0xc2100053, "RV_D"},
+    {"fcvt_d_w", 0xfff0007f, 0xd2000053, "RV_D"},
+    {"fcvt_d_wu", 0xfff0007f, 0xd2100053, "RV_D"},
+    {"ld", 0x0000707f, 0x00003003, "RV64_I"},
+    {"lwu", 0x0000707f, 0x00006003, "RV64_I"},
+    {"sd", 0x0000707f, 0x00003023, "RV64_I"},
+    {"slli", 0xfc00707f, 0x00001013, "RV64_I"},
+    {"srli", 0xfc00707f, 0x00005013, "RV64_I"},
+    {"srai", 0xfc00707f, 0x40005013, "RV64_I"},
+    {"addiw", 0x0000707f, 0x0000001b, "RV64_I"},
+    {"slliw", 0xfe00707f, 0x0000101b, "RV64_I"},
+    {"srliw", 0xfe00707f, 0x0000501b, "RV64_I"},
+    {"sraiw", 0xfe00707f, 0x4000501b, "RV64_I"},
+    {"addw", 0xfe00707f, 0x0000003b, "RV64_I"},
+    {"subw", 0xfe00707f, 0x4000003b, "RV64_I"},
+    {"sllw", 0xfe00707f, 0x0000103b, "RV64_I"},
+    {"srlw", 0xfe00707f, 0x0000503b, "RV64_I"},
+    {"sraw", 0xfe00707f, 0x4000503b, "RV64_I"},
+    {"mulw", 0xfe00707f, 0x0200003b, "RV64_M"},
+    {"divw", 0xfe00707f, 0x0200403b, "RV64_M"},
+    {"divuw", 0xfe00707f, 0x0200503b, "RV64_M"},
+    {"remw", 0xfe00707f, 0x0200603b, "RV64_M"},
+    {"remuw", 0xfe00707f, 0x0200703b, "RV64_M"},
+    {"lr_d", 0xf9f0707f, 0x1000302f, "RV64_A"},
+    {"sc_d", 0xf800707f, 0x1800302f, "RV64_A"},
+    {"amoadd_d", 0xf800707f, 0x0000302f, "RV64_A"},
+    {"amoxor_d", 0xf800707f, 0x2000302f, "RV64_A"},
+    {"amoor_d", 0xf800707f, 0x4000302f, "RV64_A"},
+    {"amoand_d", 0xf800707f, 0x6000302f, "RV64_A"},
+    {"amomin_d", 0xf800707f, 0x8000302f, "RV64_A"},
+    {"amomax_d", 0xf800707f, 0xa000302f, "RV64_A"},
+    {"amominu_d", 0xf800707f, 0xc000302f, "RV64_A"},
+    {"amomaxu_d", 0xf800707f, 0xe000302f, "RV64_A"},
+    {"amoswap_d", 0xf800707f, 0x0800302f, "RV64_A"},
+    {"fcvt_l_s", 0xfff0007f, 0xc0200053, "RV64_F"},
+    {"fcvt_lu_s", 0xfff0007f, 0xc0300053, "RV64_F"},
+    {"fcvt_s_l", 0xfff0007f, 0xd0200053, "RV64_F"},
+    {"fcvt_s_lu", 0xfff0007f, 0xd0300053, "RV64_F"},
+    {"fcvt_l_d", 0xfff0007f, 0xc2200053, "RV64_D"},
+    {"fcvt_lu_d", 0xfff0007f, 0xc2300053, "RV64_D"},
+    {"fmv_x_d", 0xfff0707f, 0xe2000053, "RV64_D"},
+    {"fcvt_d_l", 0xfff0007f, 0xd2200053, "RV64_D"},
+    {"fcvt_d_lu", 0xfff0007f, 0xd2300053, "RV64_D"},
+    {"fmv_d_x", 0xfff0707f, 0xf2000053, "RV64_D"},
+    {"csrrw", 0x0000707f, 0x00001073, "RV_ZICSR"},
+    {"csrrs", 0x0000707f, 0x00002073, "RV_ZICSR"},
+    {"csrrc", 0x0000707f, 0x00003073, "RV_ZICSR"},
+    {"csrrwi", 0x0000707f, 0x00005073, "RV_ZICSR"},
+    {"csrrsi", 0x0000707f, 0x00006073, "RV_ZICSR"},
+    {"csrrci", 0x0000707f, 0x00007073, "RV_ZICSR"},
+    {"fence_i", 0x0000707f, 0x0000100f, "RV_ZIFENCEI"},
     {"scall", 0xffffffff, 0x00000073, "RV_I"},
     {"sbreak", 0xffffffff, 0x00100073, "RV_I"},
     {"mv", 0xfff0707f, 0x00000013, "RV_I"},
@@ -79,16 +199,200 @@ constexpr InstructionEncoding INSTRUCTION_ENCODINGS[] = {
     {"jalr_pseudo", 0xfff07fff, 0x000000e7, "RV_I"},
     {"jr", 0xfff07fff, 0x00000067, "RV_I"},
     {"jal_pseudo", 0x00000fff, 0x000000ef, "RV_I"},
-    {"j", 0x00000fff, 0x0000006f, "RV_I"},
-    {"slli", 0xfe00707f, 0x00001013, "RV32_I"},
-    {"srli", 0xfe00707f, 0x00005013, "RV32_I"},
-    {"srai", 0xfe00707f, 0x40005013, "RV32_I"},
-    {"slli_rv32", 0xfe00707f, 0x00001013, "RV32_I"},
-    {"srli_rv32", 0xfe00707f, 0x00005013, "RV32_I"},
-    {"srai_rv32", 0xfe00707f, 0x40005013, "RV32_I"}
+    {"j", 0x00000fff, 0x0000006f, "RV_I"}
 };
 
 constexpr size_t NUM_ENCODINGS = sizeof(INSTRUCTION_ENCODINGS) / sizeof(InstructionEncoding);
 
+// Dense opcode ids, one per INSTRUCTION_ENCODINGS entry
+enum Opcode : uint16_t {
+    OP_LUI,
+    OP_AUIPC,
+    OP_JAL,
+    OP_JALR,
+    OP_BEQ,
+    OP_BNE,
+    OP_BLT,
+    OP_BGE,
+    OP_BLTU,
+    OP_BGEU,
+    OP_LB,
+    OP_LH,
+    OP_LW,
+    OP_LBU,
+    OP_LHU,
+    OP_SB,
+    OP_SH,
+    OP_SW,
+    OP_ADDI,
+    OP_SLTI,
+    OP_SLTIU,
+    OP_XORI,
+    OP_ORI,
+    OP_ANDI,
+    OP_ADD,
+    OP_SUB,
+    OP_SLL,
+    OP_SLT,
+    OP_SLTU,
+    OP_XOR,
+    OP_SRL,
+    OP_SRA,
+    OP_OR,
+    OP_AND,
+    OP_FENCE,
+    OP_ECALL,
+    OP_EBREAK,
+    OP_FENCE_TSO,
+    OP_PAUSE,
+    OP_MUL,
+    OP_MULH,
+    OP_MULHSU,
+    OP_MULHU,
+    OP_DIV,
+    OP_DIVU,
+    OP_REM,
+    OP_REMU,
+    OP_LR_W,
+    OP_SC_W,
+    OP_AMOADD_W,
+    OP_AMOXOR_W,
+    OP_AMOOR_W,
+    OP_AMOAND_W,
+    OP_AMOMIN_W,
+    OP_AMOMAX_W,
+    OP_AMOMINU_W,
+    OP_AMOMAXU_W,
+    OP_AMOSWAP_W,
+    OP_FLW,
+    OP_FSW,
+    OP_FMADD_S,
+    OP_FMSUB_S,
+    OP_FNMSUB_S,
+    OP_FNMADD_S,
+    OP_FADD_S,
+    OP_FSUB_S,
+    OP_FMUL_S,
+    OP_FDIV_S,
+    OP_FSQRT_S,
+    OP_FSGNJ_S,
+    OP_FSGNJN_S,
+    OP_FSGNJX_S,
+    OP_FMIN_S,
+    OP_FMAX_S,
+    OP_FCVT_W_S,
+    OP_FCVT_WU_S,
+    OP_FMV_X_W,
+    OP_FEQ_S,
+    OP_FLT_S,
+    OP_FLE_S,
+    OP_FCLASS_S,
+    OP_FCVT_S_W,
+    OP_FCVT_S_WU,
+    OP_FMV_W_X,
+    OP_FLD,
+    OP_FSD,
+    OP_FMADD_D,
+    OP_FMSUB_D,
+    OP_FNMSUB_D,
+    OP_FNMADD_D,
+    OP_FADD_D,
+    OP_FSUB_D,
+    OP_FMUL_D,
+    OP_FDIV_D,
+    OP_FSQRT_D,
+    OP_FSGNJ_D,
+    OP_FSGNJN_D,
+    OP_FSGNJX_D,
+    OP_FMIN_D,
+    OP_FMAX_D,
+    OP_FCVT_S_D,
+    OP_FCVT_D_S,
+    OP_FEQ_D,
+    OP_FLT_D,
+    OP_FLE_D,
+    OP_FCLASS_D,
+    OP_FCVT_W_D,
+    OP_FCVT_WU_D,
+    OP_FCVT_D_W,
+    OP_FCVT_D_WU,
+    OP_LD,
+    OP_LWU,
+    OP_SD,
+    OP_SLLI,
+    OP_SRLI,
+    OP_SRAI,
+    OP_ADDIW,
+    OP_SLLIW,
+    OP_SRLIW,
+    OP_SRAIW,
+    OP_ADDW,
+    OP_SUBW,
+    OP_SLLW,
+    OP_SRLW,
+    OP_SRAW,
+    OP_MULW,
+    OP_DIVW,
+    OP_DIVUW,
+    OP_REMW,
+    OP_REMUW,
+    OP_LR_D,
+    OP_SC_D,
+    OP_AMOADD_D,
+    OP_AMOXOR_D,
+    OP_AMOOR_D,
+    OP_AMOAND_D,
+    OP_AMOMIN_D,
+    OP_AMOMAX_D,
+    OP_AMOMINU_D,
+    OP_AMOMAXU_D,
+    OP_AMOSWAP_D,
+    OP_FCVT_L_S,
+    OP_FCVT_LU_S,
+    OP_FCVT_S_L,
+    OP_FCVT_S_LU,
+    OP_FCVT_L_D,
+    OP_FCVT_LU_D,
+    OP_FMV_X_D,
+    OP_FCVT_D_L,
+    OP_FCVT_D_LU,
+    OP_FMV_D_X,
+    OP_CSRRW,
+    OP_CSRRS,
+    OP_CSRRC,
+    OP_CSRRWI,
+    OP_CSRRSI,
+    OP_CSRRCI,
+    OP_FENCE_I,
+    OP_SCALL,
+    OP_SBREAK,
+    OP_MV,
+    OP_NEG,
+    OP_NOP,
+    OP_ZEXT_B,
+    OP_RET,
+    OP_BLEU,
+    OP_BGTU,
+    OP_BLE,
+    OP_BGEZ,
+    OP_BLEZ,
+    OP_BGT,
+    OP_BGTZ,
+    OP_BLTZ,
+    OP_BNEZ,
+    OP_BEQZ,
+    OP_SEQZ,
+    OP_SNEZ,
+    OP_SLTZ,
+    OP_SGTZ,
+    OP_JALR_PSEUDO,
+    OP_JR,
+    OP_JAL_PSEUDO,
+    OP_J,
+    OP_UNKNOWN
+};
+
+static_assert(OP_UNKNOWN == NUM_ENCODINGS, "Opcode ids must match the encoding table");
+
 } // namespace encoding
 } // namespace rvpin
@@ -1,215 +1,572 @@
 #include "engine.hpp"
+#include "isa.hpp"
 #include <stdexcept>
-#include <fstream>
 #include <iostream>
 #include <vector>
 #include <cstring>
+#include <algorithm>
 #include <iomanip>
 #include <cstdlib>
 #include <ctime>
+#include <utility>
 
 namespace rvpin {
 
-// ELF constants
-constexpr uint32_t EI_MAG0 = 0x7f;
-constexpr uint32_t EI_MAG1 = 'E';
-constexpr uint32_t EI_MAG2 = 'L';
-constexpr uint32_t EI_MAG3 = 'F';
-constexpr uint32_t EI_CLASS = 4;
-constexpr uint32_t ELFCLASS32 = 1;
-constexpr uint32_t ELFCLASS64 = 2;
-constexpr uint32_t EI_DATA = 5;
-constexpr uint32_t ELFDATA2LSB = 1;
-constexpr uint32_t ELFDATA2MSB = 2;
-constexpr uint32_t EM_RISCV = 243;
-
-// ELF header for both 32-bit and 64-bit
-struct Elf64_Ehdr {
-    unsigned char e_ident[16];
-    uint16_t e_type;
-    uint16_t e_machine;
-    uint32_t e_version;
-    uint64_t e_entry;
-    uint64_t e_phoff;
-    uint64_t e_shoff;
-    uint32_t e_flags;
-    uint16_t e_ehsize;
-    uint16_t e_phentsize;
-    uint16_t e_phnum;
-    uint16_t e_shentsize;
-    uint16_t e_shnum;
-    uint16_t e_shstrndx;
-};
-
-// Section header for both 32-bit and 64-bit
-struct Elf64_Shdr {
-    uint32_t sh_name;
-    uint32_t sh_type;
-    uint64_t sh_flags;
-    uint64_t sh_addr;
-    uint64_t sh_offset;
-    uint64_t sh_size;
-    uint32_t sh_link;
-    uint32_t sh_info;
-    uint64_t sh_addralign;
-    uint64_t sh_entsize;
-};
-
-bool Engine::initialize(int argc, char* argv[]) {
-    std::cout << "Initializing RVPin engine...\n";
+// Auxiliary vector entries passed on the initial stack
+constexpr uint64_t AT_NULL = 0;
+constexpr uint64_t AT_PHDR = 3;
+constexpr uint64_t AT_PHENT = 4;
+constexpr uint64_t AT_PHNUM = 5;
+constexpr uint64_t AT_PAGESZ = 6;
+constexpr uint64_t AT_ENTRY = 9;
+constexpr uint64_t AT_UID = 11;
+constexpr uint64_t AT_EUID = 12;
+constexpr uint64_t AT_GID = 13;
+constexpr uint64_t AT_EGID = 14;
+constexpr uint64_t AT_RANDOM = 25;
+
+// Guest stack, placed at the top of an Sv39 user address space
+constexpr uint64_t STACK_TOP = 0x4000000000ull;
+constexpr uint64_t STACK_SIZE = 8ull << 20;
+
+// Longest block we decode before splitting it
+constexpr size_t MAX_BLOCK_INSTRUCTIONS = 256;
+
+// Runs of a block before DispatchMode::JIT compiles it
+constexpr uint32_t JIT_THRESHOLD = 64;
+
+// ABI register names
+constexpr uint32_t REG_SP = 2;
+
+thread_local Engine* Engine::current_ = nullptr;
+
+Engine::~Engine() {
+    closeFiles();
+}
+
+bool Engine::initialize(int argc, char* argv[], const RegionOptions& region) {
+    if (verbose_) {
+        std::cout << "Initializing RVPin engine...\n";
+    }
+    if (argc < 1) {
+        std::cerr << "No program to run\n";
+        return false;
+    }
+
+    program_path_ = argv[0];
+    try {
+        elf_ = std::make_unique<elf::ElfFile>(program_path_);
+        loadSegments();
+    } catch (const std::exception& e) {
+        std::cerr << "Error loading program: " << e.what() << "\n";
+        return false;
+    }
+
+    region_ = region;
+    start_pc_ = region.start_pc;
+    if (!region.start_symbol.empty()) {
+        const elf::Symbol* symbol = elf_->findSymbol(region.start_symbol);
+        if (!symbol) {
+            std::cerr << "Start symbol " << region.start_symbol << " not found\n";
+            return false;
+        }
+        start_pc_ = symbol->value;
+    }
+    stage_ = Stage::SKIP;
+
+    decoder_ = std::make_unique<Decoder>();
+    setupStack(argc, argv);
+    state_.pc = entry_;
+    if (!region.restore.empty() && !restoreCheckpoint(region.restore)) {
+        return false;
+    }
+    loaded_ = true;
     return true;
 }
 
+void Engine::setDispatchMode(DispatchMode mode, size_t jit_cache_size) {
+    dispatch_mode_ = mode;
+    block_cache_.clear();
+    if (mode != DispatchMode::JIT) {
+        jit_.reset();
+    } else {
+        jit_ = std::make_unique<JitCompiler>(memory_, jit_cache_size);
+        if (!jit_->isAvailable()) {
+            std::cerr << "No JIT on this host, running threaded\n";
+        }
+    }
+}
+
+void Engine::registerInstructionInstrumentation(api::InstructionInstrumentation routine) {
+    instruction_instrumentation_.push_back(std::move(routine));
+    block_cache_.clear();
+}
+
+void Engine::registerBlockInstrumentation(api::BlockInstrumentation routine) {
+    block_instrumentation_.push_back(std::move(routine));
+    block_cache_.clear();
+}
+
 void Engine::registerBeforeInstruction(InstrumentationCallback callback) {
     before_callbacks_.push_back(std::move(callback));
+    if (before_callbacks_.size() == 1) {
+        registerInstructionInstrumentation([this](api::InsHandle& ins) {
+            ins.insertCall(api::IPoint::BEFORE, &Engine::runBeforeCallbacks, this,
+                           {api::IArg::instruction()});
+        });
+    }
 }
 
 void Engine::registerAfterInstruction(InstrumentationCallback callback) {
     after_callbacks_.push_back(std::move(callback));
+    if (after_callbacks_.size() == 1) {
+        registerInstructionInstrumentation([this](api::InsHandle& ins) {
+            ins.insertCall(api::IPoint::AFTER, &Engine::runAfterCallbacks, this,
+                           {api::IArg::instruction()});
+        });
+    }
+}
+
+void Engine::registerMemoryAccess(MemoryCallback callback) {
+    bool first = !memory_callback_;
+    memory_callback_ = std::move(callback);
+    if (first) {
+        registerInstructionInstrumentation([this](api::InsHandle& ins) {
+            if (ins.isMemoryRead() || ins.isMemoryWrite()) {
+                ins.insertCall(api::IPoint::BEFORE, &Engine::runMemoryCallback, this,
+                               {api::IArg::memoryEa(), api::IArg::constant(ins.isMemoryWrite()),
+                                api::IArg::memorySize()});
+            }
+        });
+    }
+}
+
+void Engine::runBeforeCallbacks(void* context, const uint64_t* args) {
+    auto* engine = static_cast<Engine*>(context);
+    const auto& inst = *reinterpret_cast<const Instruction*>(args[0]);
+    for (const auto& callback : engine->before_callbacks_) {
+        callback(inst);
+    }
+}
+
+void Engine::runAfterCallbacks(void* context, const uint64_t* args) {
+    auto* engine = static_cast<Engine*>(context);
+    const auto& inst = *reinterpret_cast<const Instruction*>(args[0]);
+    for (const auto& callback : engine->after_callbacks_) {
+        callback(inst);
+    }
+}
+
+void Engine::runMemoryCallback(void* context, const uint64_t* args) {
+    auto* engine = static_cast<Engine*>(context);
+    engine->memory_callback_(args[0], args[1] != 0, static_cast<uint32_t>(args[2]));
 }
 
 const Instruction* Engine::getCurrentInstruction() const {
-    return current_instruction_.get();
+    return current_instruction_;
 }
 
-bool Engine::isElfFile(std::ifstream& file) {
-    unsigned char magic[16];  // Read entire e_ident
-    if (!file.read(reinterpret_cast<char*>(magic), sizeof(magic))) {
-        std::cerr << "Failed to read ELF magic\n";
-        return false;
+const elf::ElfFile* Engine::getElfFile() const {
+    return elf_.get();
+}
+
+void Engine::loadSegments() {
+    const elf::Elf64_Ehdr& header = elf_->getHeader();
+    const elf::Elf64_Phdr* program_headers = elf_->getProgramHeaders();
+
+    uint64_t highest = 0;
+    for (size_t i = 0; i < elf_->getNumProgramHeaders(); ++i) {
+        const elf::Elf64_Phdr& phdr = program_headers[i];
+        if (phdr.p_type == elf::PT_PHDR) {
+            phdr_addr_ = phdr.p_vaddr;
+        }
+        if (phdr.p_type != elf::PT_LOAD || phdr.p_memsz == 0) {
+            continue;
+        }
+
+        // Pages get the segment's permissions, so e.g. a store into .text
+        // faults as it would on Linux
+        const uint8_t perms = ((phdr.p_flags & elf::PF_R) ? Memory::READABLE : 0) |
+                              ((phdr.p_flags & elf::PF_W) ? Memory::WRITABLE : 0) |
+                              ((phdr.p_flags & elf::PF_X) ? Memory::EXECUTABLE : 0);
+
+        // Segments map straight from the file; ones whose file offset and
+        // address disagree within a page can only be copied
+        if (((phdr.p_vaddr ^ phdr.p_offset) & (Memory::PAGE_SIZE - 1)) == 0) {
+            memory_.mapFile(phdr.p_vaddr, phdr.p_memsz, elf_->getFd(), phdr.p_offset,
+                            phdr.p_filesz, perms);
+        } else {
+            memory_.map(phdr.p_vaddr, phdr.p_memsz, perms);
+            memory_.fill(phdr.p_vaddr, elf_->getData() + phdr.p_offset, phdr.p_filesz);
+        }
+
+        // The headers usually sit at the start of the first segment
+        if (phdr_addr_ == 0 && header.e_phoff >= phdr.p_offset &&
+            header.e_phoff < phdr.p_offset + phdr.p_filesz) {
+            phdr_addr_ = phdr.p_vaddr + (header.e_phoff - phdr.p_offset);
+        }
+        highest = std::max(highest, phdr.p_vaddr + phdr.p_memsz);
     }
-    file.seekg(0);  // Reset file position
-    
-    // Check magic number
-    if (magic[0] != EI_MAG0 || magic[1] != EI_MAG1 ||
-        magic[2] != EI_MAG2 || magic[3] != EI_MAG3) {
-        std::cerr << "Invalid ELF magic number\n";
-        return false;
+
+    entry_ = header.e_entry;
+    phnum_ = header.e_phnum;
+    brk_ = (highest + Memory::PAGE_SIZE - 1) & ~(Memory::PAGE_SIZE - 1);
+}
+
+void Engine::setupStack(int argc, char* argv[]) {
+    memory_.map(STACK_TOP - STACK_SIZE, STACK_SIZE);
+    uint64_t sp = STACK_TOP;
+
+    // Argument strings at the top
+    std::vector<uint64_t> arg_ptrs;
+    for (int i = 0; i < argc; i++) {
+        size_t len = std::strlen(argv[i]) + 1;
+        sp -= len;
+        memory_.write(sp, argv[i], len);
+        arg_ptrs.push_back(sp);
     }
-    
-    // Check if it's a 64-bit ELF file
-    if (magic[EI_CLASS] != ELFCLASS64) {
-        std::cerr << "Not a 64-bit ELF file\n";
-        return false;
+
+    // AT_RANDOM bytes; fixed so runs are reproducible
+    sp -= 16;
+    const uint8_t random_bytes[16] = {0x52, 0x56, 0x50, 0x69, 0x6e, 0x21, 0x5a, 0x1f,
+                                      0x3c, 0x77, 0x08, 0x91, 0xd4, 0x2b, 0x6e, 0xa5};
+    memory_.write(sp, random_bytes, sizeof(random_bytes));
+    uint64_t random_addr = sp;
+
+    // argc, argv[], NULL, envp[] (empty), NULL, auxv
+    std::vector<uint64_t> words;
+    words.push_back(argc);
+    words.insert(words.end(), arg_ptrs.begin(), arg_ptrs.end());
+    words.push_back(0);
+    words.push_back(0);
+    const uint64_t auxv[][2] = {
+        {AT_PHDR, phdr_addr_}, {AT_PHENT, sizeof(elf::Elf64_Phdr)}, {AT_PHNUM, phnum_},
+        {AT_PAGESZ, Memory::PAGE_SIZE}, {AT_ENTRY, entry_}, {AT_UID, 0}, {AT_EUID, 0},
+        {AT_GID, 0}, {AT_EGID, 0}, {AT_RANDOM, random_addr}, {AT_NULL, 0}};
+    for (const auto& entry : auxv) {
+        words.push_back(entry[0]);
+        words.push_back(entry[1]);
     }
-    
-    // Check endianness (RISC-V is little endian)
-    if (magic[EI_DATA] != ELFDATA2LSB) {
-        std::cerr << "Not a little-endian ELF file\n";
+
+    sp = (sp - words.size() * sizeof(uint64_t)) & ~uint64_t(15);
+    memory_.write(sp, words.data(), words.size() * sizeof(uint64_t));
+    state_.x[REG_SP] = sp;
+}
+
+BasicBlock& Engine::translateBlock(uint64_t pc) {
+    BasicBlock block;
+    block.start_pc = pc;
+    std::vector<uint64_t> addresses;
+    const uint64_t limit =
+        std::min<uint64_t>(MAX_BLOCK_INSTRUCTIONS, phase_end_ - state_.instret);
+    while (block.instructions.size() < limit) {
+        // Stop short of the pc that ends the phase. The block starting
+        // there is left empty, so the phase ends before anything runs.
+        if (pc == phase_pc_) {
+            block.ends_phase = block.instructions.empty();
+            break;
+        }
+
+        // Fetch by parcel, so a compressed instruction at the end of a
+        // mapping does not read past it
+        uint32_t raw = memory_.fetch(pc);
+        if ((raw & 0x3) == 0x3) {
+            raw |= static_cast<uint32_t>(memory_.fetch(pc + 2)) << 16;
+        }
+        Instruction inst = decoder_->decode(raw);
+        block.instructions.push_back(inst);
+        addresses.push_back(pc);
+        pc += inst.getSize();
+        if (phase_marker_ != 0 && inst.getRawInstruction() == phase_marker_) {
+            block.ends_phase = true;
+            break;
+        }
+        if (isa::getOpInfo(inst.getOpcodeId()).ends_block) {
+            break;
+        }
+    }
+    block.end_pc = pc;
+
+    if (instrumenting_ &&
+        (!instruction_instrumentation_.empty() || !block_instrumentation_.empty())) {
+        instrumentBlock(block, addresses);
+    }
+    BasicBlock& cached = block_cache_.insert(std::move(block));
+    if (dispatch_mode_ != DispatchMode::SWITCH && cached.calls.empty() &&
+        !cached.instructions.empty()) {
+        interpreter_.lower(cached.instructions, cached.start_pc, cached.threaded);
+    }
+    return cached;
+}
+
+void Engine::instrumentBlock(BasicBlock& block, const std::vector<uint64_t>& addresses) {
+    api::BlockHandle handle(block.start_pc, block.instructions, addresses, block.calls);
+    for (const auto& routine : block_instrumentation_) {
+        routine(handle);
+    }
+    for (size_t i = 0; i < block.instructions.size(); ++i) {
+        api::InsHandle ins = handle.getInstruction(i);
+        for (const auto& routine : instruction_instrumentation_) {
+            routine(ins);
+        }
+    }
+
+    // The block loop walks calls in (instruction, point) order
+    std::stable_sort(block.calls.begin(), block.calls.end(),
+                     [](const api::AnalysisCall& a, const api::AnalysisCall& b) {
+                         return a.inst_index != b.inst_index ? a.inst_index < b.inst_index
+                                                             : a.point < b.point;
+                     });
+}
+
+void Engine::invokeAnalysis(const api::AnalysisCall& call, const Instruction& inst,
+                            uint64_t pc, uint64_t ea) {
+    using Kind = api::IArg::Kind;
+    uint64_t args[api::MAX_ANALYSIS_ARGS];
+    for (uint8_t i = 0; i < call.num_args; ++i) {
+        const api::IArg& arg = call.args[i];
+        switch (arg.kind) {
+            case Kind::INST_PTR: args[i] = pc; break;
+            case Kind::RAW_INSTRUCTION: args[i] = inst.getRawInstruction(); break;
+            case Kind::INSTRUCTION: args[i] = reinterpret_cast<uintptr_t>(&inst); break;
+            case Kind::MEMORY_EA: args[i] = ea; break;
+            case Kind::MEMORY_SIZE: args[i] = isa::getOpInfo(inst.getOpcodeId()).mem_size; break;
+            case Kind::REG_VALUE: args[i] = state_.x[arg.value & 0x1F]; break;
+            case Kind::HART_ID: args[i] = state_.hart_id; break;
+            case Kind::CONSTANT: args[i] = arg.value; break;
+        }
+    }
+    call.routine(call.context, args);
+}
+
+int Engine::run() {
+    // No tool bound: only inserted analysis calls run
+    struct NoTool {};
+    NoTool none;
+    return runLoop(none);
+}
+
+bool Engine::beginRun() {
+    if (!loaded_) {
+        std::cerr << "No program loaded\n";
         return false;
     }
-    
+    if (verbose_) {
+        std::cout << "Running instrumented program...\n" << std::flush;
+    }
     return true;
 }
 
-std::vector<uint32_t> Engine::loadTextSection(std::ifstream& program) {
-    std::vector<uint32_t> instructions;
-    
+bool Engine::fastForward(uint64_t instructions) {
+    if (!loaded_) {
+        std::cerr << "No program loaded\n";
+        return false;
+    }
+    if (exited_ || instructions == 0) {
+        return !exited_;
+    }
+
+    CurrentScope scope(this);
+    block_cache_.clear();
+    instrumenting_ = false;
+    phase_end_ = state_.instret + instructions;
+    phase_pc_ = ~0ull;
+    phase_marker_ = 0;
+    struct NoTool {};
+    NoTool none;
     try {
-        // Read ELF header
-        Elf64_Ehdr header;
-        program.seekg(0);
-        if (!program.read(reinterpret_cast<char*>(&header), sizeof(header))) {
-            throw std::runtime_error("Failed to read ELF header");
-        }
-        
-        // Check if it's a RISC-V ELF file
-        if (header.e_machine != EM_RISCV) {
-            throw std::runtime_error("Not a RISC-V ELF file");
-        }
-        
-        if (header.e_shnum == 0 || header.e_shstrndx >= header.e_shnum) {
-            throw std::runtime_error("Invalid ELF header");
-        }
-        
-        // Read section headers
-        std::vector<Elf64_Shdr> section_headers(header.e_shnum);
-        program.seekg(header.e_shoff);
-        if (!program.read(reinterpret_cast<char*>(section_headers.data()),
-                         header.e_shnum * sizeof(Elf64_Shdr))) {
-            throw std::runtime_error("Failed to read section headers");
-        }
-        
-        // Read section names
-        std::vector<char> shstrtab;
-        const auto& shstrtab_hdr = section_headers[header.e_shstrndx];
-        if (shstrtab_hdr.sh_size == 0) {
-            throw std::runtime_error("Empty string table");
-        }
-        shstrtab.resize(shstrtab_hdr.sh_size);
-        program.seekg(shstrtab_hdr.sh_offset);
-        if (!program.read(shstrtab.data(), shstrtab_hdr.sh_size)) {
-            throw std::runtime_error("Failed to read string table");
-        }
-        
-        // Find and load .text section
-        for (const auto& shdr : section_headers) {
-            if (shdr.sh_name >= shstrtab_hdr.sh_size) {
-                continue;
-            }
-            
-            const char* name = &shstrtab[shdr.sh_name];
-            if (strcmp(name, ".text") == 0) {
-                if (shdr.sh_size == 0) {
-                    throw std::runtime_error("Empty text section");
+        runPhase(none);
+    } catch (const MemoryFault& e) {
+        reportFault(e);
+        exited_ = true;
+        exit_code_ = 1;
+    } catch (const IllegalInstruction& e) {
+        reportFault(e);
+        exited_ = true;
+        exit_code_ = 1;
+    }
+    block_cache_.clear();
+    return !exited_;
+}
+
+Engine::Phase Engine::nextPhase() {
+    if (exited_) {
+        return Phase::DONE;
+    }
+
+    // Blocks are shaped and instrumented for the phase they were decoded in
+    block_cache_.clear();
+    phase_end_ = ~0ull;
+    phase_pc_ = ~0ull;
+    phase_marker_ = 0;
+    for (;;) {
+        switch (stage_) {
+            case Stage::SKIP:
+                stage_ = Stage::START_PC;
+                if (region_.skip != 0) {
+                    phase_end_ = state_.instret + region_.skip;
+                    return Phase::FAST_FORWARD;
                 }
-                
-                // Read text section
-                std::vector<uint8_t> text(shdr.sh_size);
-                program.seekg(shdr.sh_offset);
-                if (!program.read(reinterpret_cast<char*>(text.data()), shdr.sh_size)) {
-                    throw std::runtime_error("Failed to read text section");
+                break;
+            case Stage::START_PC:
+                stage_ = Stage::START_MARKER;
+                if (start_pc_ != 0) {
+                    phase_pc_ = start_pc_;
+                    return Phase::FAST_FORWARD;
                 }
-                
-                // Convert to instructions (handle both 32-bit and 16-bit instructions)
-                for (size_t i = 0; i < text.size();) {
-                    uint32_t inst = 0;
-                    
-                    // Check if it's a compressed instruction (16-bit)
-                    uint16_t first_half = (text[i+1] << 8) | text[i];
-                    bool is_compressed = (first_half & 0x3) != 0x3;
-                    
-                    if (is_compressed && i + 2 <= text.size()) {
-                        // 16-bit instruction
-                        inst = first_half;
-                        i += 2;
-                    } else if (i + 4 <= text.size()) {
-                        // 32-bit instruction
-                        inst = (text[i+3] << 24) | (text[i+2] << 16) | 
-                               (text[i+1] << 8) | text[i];
-                        i += 4;
-                    } else {
-                        break;  // Not enough bytes left
-                    }
-                    
-                    instructions.push_back(inst);
+                break;
+            case Stage::START_MARKER:
+                stage_ = Stage::REGION;
+                if (region_.markers) {
+                    phase_marker_ = REGION_START_MARKER;
+                    return Phase::FAST_FORWARD;
                 }
                 break;
-            }
+            case Stage::REGION:
+                stage_ = Stage::END;
+                if (verbose_ && region_.fastForwards()) {
+                    std::cout << "Fast-forwarded " << state_.instret << " instructions to pc 0x"
+                              << std::hex << state_.pc << std::dec << "\n" << std::flush;
+                }
+                region_start_ = state_.instret;
+                instrumenting_ = true;
+                if (region_.max_instructions != 0) {
+                    phase_end_ = state_.instret + region_.max_instructions;
+                }
+                if (region_.markers) {
+                    phase_marker_ = REGION_STOP_MARKER;
+                }
+                return Phase::REGION;
+            case Stage::END:
+                // The region ended before the program did
+                if (verbose_) {
+                    std::cout << "Region of interest ended after "
+                              << state_.instret - region_start_ << " instructions\n"
+                              << std::flush;
+                }
+                exited_ = true;
+                exit_code_ = 0;
+                return Phase::DONE;
         }
-    } catch (const std::exception& e) {
-        std::cerr << "Error loading text section: " << e.what() << "\n";
     }
-    
-    return instructions;
 }
 
-int Engine::run() {
-    std::cout << "Running instrumented program...\n";
-    // Simulate some memory accesses for testing
-    if (memory_callback_) {
-        // Sequential access
-        for (uint64_t addr = 0; addr < 1024; addr += 4) {
-            memory_callback_(addr, false, 4);  // Read
+BasicBlock* Engine::nextBlock(BasicBlock* block) {
+    // Follow the last successor link before asking the cache
+    BasicBlock* next;
+    if (block && block->successor_pc == state_.pc) {
+        next = block->successor;
+    } else {
+        next = block_cache_.find(state_.pc);
+        if (!next) {
+            next = &translateBlock(state_.pc);
         }
-        
-        // Random access
-        for (int i = 0; i < 100; i++) {
-            uint64_t addr = rand() % 1024;
-            memory_callback_(addr, true, 4);  // Write
+        if (block) {
+            block->successor_pc = state_.pc;
+            block->successor = next;
         }
     }
-    return 0;
+
+    // A block decoded earlier in the phase may run past its end; decode
+    // it again, cut short. Links to it stay valid.
+    if (next->instructions.size() > phase_end_ - state_.instret) {
+        next = &translateBlock(state_.pc);
+    }
+
+    // Compile blocks once they run hot, and again after a flush
+    if (jit_ && !next->jit_rejected && next->jit_generation != jit_->getGeneration() &&
+        ++next->executions >= JIT_THRESHOLD) {
+        next->jit_entry = jit_->compile(next->instructions, next->start_pc, next->calls);
+        next->jit_generation = jit_->getGeneration();
+        next->jit_rejected = next->jit_entry == nullptr;
+    }
+    return next;
+}
+
+BasicBlock* Engine::completeBlock(BasicBlock* block, StepResult result) {
+    switch (result) {
+        case StepResult::CONTINUE:
+            break;
+        case StepResult::SYSCALL:
+            handleSyscall();
+            if (mappings_changed_) {
+                mappings_changed_ = false;
+                flushCode();
+                return nullptr;
+            }
+            break;
+        case StepResult::BREAKPOINT:
+            std::cerr << "Breakpoint at 0x" << std::hex
+                      << state_.pc - block->instructions.back().getSize() << std::dec << "\n";
+            exited_ = true;
+            exit_code_ = 1;
+            break;
+        case StepResult::FENCE_I:
+            flushCode();
+            return nullptr;
+    }
+    return block;
+}
+
+StepResult Engine::runCompiled(const BasicBlock& block) {
+    jit_context_.instret_limit = phase_end_;
+    const JitExit exit = block.jit_entry(&state_, &jit_context_);
+    switch (exit) {
+        case JitExit::FAULT: {
+            // Compiled code leaves faulting accesses to the interpreter,
+            // which throws as it would have; pc and instret are on the
+            // faulting instruction, and its BEFORE calls have run. Should
+            // it not throw, the rest of the block runs as executeBlock
+            // runs it, analysis calls included.
+            jit_context_.fault = false;
+            const size_t first = jit_context_.fault_index;
+            const api::AnalysisCall* call = block.calls.data();
+            const api::AnalysisCall* end = call + block.calls.size();
+            while (call != end && call->inst_index < first) {
+                ++call;
+            }
+            StepResult result = StepResult::CONTINUE;
+            for (size_t i = first; i < block.instructions.size(); ++i) {
+                const Instruction& inst = block.instructions[i];
+                current_instruction_ = &inst;
+                const uint64_t pc = state_.pc;
+                const uint64_t ea = state_.x[inst.getRs1()] + inst.getImmediate();
+                for (; call != end && call->inst_index == i && call->point == api::IPoint::BEFORE;
+                     ++call) {
+                    if (i != first) {
+                        invokeAnalysis(*call, inst, pc, ea);
+                    }
+                }
+                result = interpreter_.step(inst);
+                for (; call != end && call->inst_index == i; ++call) {
+                    invokeAnalysis(*call, inst, pc, ea);
+                }
+            }
+            return result;
+        }
+        case JitExit::EXCEPTION:
+            std::rethrow_exception(std::exchange(jit_context_.exception, nullptr));
+        default:
+            return static_cast<StepResult>(exit);
+    }
+}
+
+void Engine::flushCode() {
+    // Blocks decoded from the old code must not run again
+    block_cache_.clear();
+    if (jit_) {
+        jit_->flush();
+    }
+}
+
+void Engine::reportFault(const MemoryFault& e) {
+    std::cerr << "Guest " << e.what() << " 0x" << std::hex << e.getAddress()
+              << " at pc 0x" << state_.pc << std::dec << "\n";
+}
+
+void Engine::reportFault(const IllegalInstruction& e) {
+    std::cerr << "Illegal instruction 0x" << std::hex << std::setw(8) << std::setfill('0')
+              << e.getRawInstruction() << " at pc 0x" << e.getPc() << std::dec << "\n";
 }
 
 } // namespace rvpin
@@ -4,59 +4,395 @@
 #include <vector>
 #include <functional>
 #include <string>
-#include <fstream> // Added include for std::ifstream
+#include "block_cache.hpp"
 #include "decoder.hpp"
+#include "elf.hpp"
+#include "interpreter.hpp"
+#include "jit.hpp"
+#include "memory.hpp"
+#include "region.hpp"
+#include "syscall.hpp"
 
 namespace rvpin {
 
+// How the engine runs blocks that have no analysis calls
+enum class DispatchMode {
+    SWITCH,         // Interpreter::step on each decoded instruction
+    THREADED,       // Lowered once to threaded code with fused pairs, see Interpreter::run
+    JIT             // THREADED, and blocks that run hot are compiled to host code,
+                    // analysis calls included; see JitCompiler
+};
+
 class Engine {
 public:
     using InstrumentationCallback = std::function<void(const Instruction&)>;
-    
+
+    // Engines are independent: each runs its own guest, and separate
+    // engines may run on separate threads
+    Engine() = default;
+    ~Engine();
+    Engine(const Engine&) = delete;
+    Engine& operator=(const Engine&) = delete;
+
+    // Shared engine for tools that run one program per process
     static Engine& getInstance() {
         static Engine instance;
         return instance;
     }
-    
-    // Initialize the instrumentation engine
-    bool initialize(int argc, char* argv[]);
-    
-    // Register callbacks for different instrumentation points
+
+    // Hart id the guest runs as, which IArg::hartId() passes to analysis
+    // routines. Engines sharing a tool on separate threads each need
+    // their own id; the default is 0.
+    void setHartId(uint32_t hart_id) { state_.hart_id = hart_id; }
+    uint32_t getHartId() const { return state_.hart_id; }
+
+    // Print progress messages such as "Running instrumented program...".
+    // On by default.
+    void setVerbose(bool verbose) { verbose_ = verbose; }
+
+    // Choose how uninstrumented blocks run, THREADED by default. Tools
+    // with per-instruction hooks always step. Flushes decoded blocks. In
+    // JIT mode, compiled code goes to a cache of jit_cache_size bytes,
+    // flushed whole when full.
+    void setDispatchMode(DispatchMode mode,
+                         size_t jit_cache_size = JitCompiler::DEFAULT_CACHE_SIZE);
+
+    // Keep the guest from changing anything outside itself, for a run
+    // whose effects others redo, like the functional pass of
+    // runParallelSlices. Its writes to the standard streams are dropped
+    // and files it opens for writing are private in-memory copies. Reads
+    // still reach the host. Set it before initialize().
+    void setDryRun(bool dry_run) { dry_run_ = dry_run; }
+
+    // Initialize the instrumentation engine. argv[0] is the RISC-V ELF to
+    // run, the remaining arguments are passed to it. Instrumentation covers
+    // the given region of interest, the whole run by default.
+    bool initialize(int argc, char* argv[], const RegionOptions& region = {});
+
+    // Register instrumentation routines. They run once per newly decoded
+    // block or instruction and insert the analysis calls to make there.
+    // Register them before run(); registering flushes decoded blocks.
+    void registerInstructionInstrumentation(api::InstructionInstrumentation routine);
+    void registerBlockInstrumentation(api::BlockInstrumentation routine);
+
+    // Register callbacks for different instrumentation points. These are
+    // inserted on every instruction.
     void registerBeforeInstruction(InstrumentationCallback callback);
     void registerAfterInstruction(InstrumentationCallback callback);
-    
-    // Start the instrumented program
+
+    // Start the instrumented program, returns its exit code
     int run();
-    
-    // Get the current instruction being executed
+
+    // Start the program with a tool bound at compile time. The hooks the
+    // tool defines (see api::ToolHooks) are called directly from the block
+    // loop, including onProgramStart and onProgramEnd, and the ones it
+    // does not define cost nothing. Inserted analysis calls still run.
+    template <typename Tool>
+    int runWith(Tool& tool);
+
+    // Get the current instruction being executed. Only valid inside
+    // analysis routines.
     const Instruction* getCurrentInstruction() const;
-    
+
     // Memory access callback type
     using MemoryCallback = std::function<void(uint64_t, bool, uint32_t)>;
-    
-    // Register memory access callback
-    void registerMemoryAccess(MemoryCallback callback) {
-        memory_callback_ = callback;
-    }
-    
+
+    // Register memory access callback, inserted on loads, stores and AMOs
+    void registerMemoryAccess(MemoryCallback callback);
+
+    // Syscall trace callback type, passed a batch of events in call order
+    using SyscallCallback = std::function<void(const std::vector<SyscallEvent>&)>;
+
+    // Register a syscall trace. Each syscall made in the region of
+    // interest is recorded as it is served and handed over batch_size at
+    // a time, plus a final partial batch when the run ends, so tracing
+    // costs no more than the syscall itself.
+    void registerSyscallTrace(SyscallCallback callback, size_t batch_size = 1024);
+
+    // The loaded program, for symbol lookups. Null before initialize().
+    const elf::ElfFile* getElfFile() const;
+
+    // Live guest state. Inside analysis routines the registers are those
+    // at the call point and pc is the instruction's own at IPoint::BEFORE.
+    // api/guest.hpp has the accessors tools normally use.
+    const CpuState& getState() const { return state_; }
+    Memory& getMemory() { return memory_; }
+
+    // The engine running on this thread, null outside run(), runWith()
+    // and fastForward()
+    static Engine* getCurrent() { return current_; }
+
+    // Write the guest state to a checkpoint: registers, pc, CSRs, the
+    // memory map and the pages stored to since the program was loaded.
+    // Take it before run(), after fastForward(), or from an analysis
+    // routine; a run restored from it (RegionOptions::restore) continues
+    // at the instruction about to execute.
+    bool saveCheckpoint(const std::string& path);
+
+    // Run uninstrumented until instructions more have retired, before
+    // run(). Returns false once the program has exited.
+    bool fastForward(uint64_t instructions);
+
 private:
-    Engine() = default;
-    ~Engine() = default;
-    Engine(const Engine&) = delete;
-    Engine& operator=(const Engine&) = delete;
-    
-    // ELF parsing helpers
-    bool isElfFile(std::ifstream& file);
-    std::vector<uint32_t> loadTextSection(std::ifstream& program);
-    
+    // Program loading helpers
+    void loadSegments();
+    void setupStack(int argc, char* argv[]);
+    bool restoreCheckpoint(const std::string& path);
+
+    // Stretches of execution that end at a region boundary
+    enum class Phase {
+        FAST_FORWARD,
+        REGION,
+        DONE
+    };
+
+    // Steps to the start of the region and past it, see RegionOptions
+    enum class Stage {
+        SKIP,
+        START_PC,
+        START_MARKER,
+        REGION,
+        END
+    };
+
+    // Makes an engine current on this thread for a scope
+    class CurrentScope {
+    public:
+        explicit CurrentScope(Engine* engine) : previous_(current_) { current_ = engine; }
+        ~CurrentScope() { current_ = previous_; }
+        CurrentScope(const CurrentScope&) = delete;
+        CurrentScope& operator=(const CurrentScope&) = delete;
+
+    private:
+        Engine* previous_;
+    };
+
+    static thread_local Engine* current_;
+
+    // Execution helpers
+    template <typename Tool>
+    int runLoop(Tool& tool);
+    template <typename Tool>
+    void runPhase(Tool& tool);
+    Phase nextPhase();
+    template <typename Tool>
+    StepResult executeBlock(const BasicBlock& block, Tool& tool);
+    bool beginRun();
+    BasicBlock* nextBlock(BasicBlock* block);
+    BasicBlock* completeBlock(BasicBlock* block, StepResult result);
+    void reportFault(const MemoryFault& e);
+    void reportFault(const IllegalInstruction& e);
+    BasicBlock& translateBlock(uint64_t pc);
+    StepResult runCompiled(const BasicBlock& block);
+    void flushCode();
+    void instrumentBlock(BasicBlock& block, const std::vector<uint64_t>& addresses);
+    void invokeAnalysis(const api::AnalysisCall& call, const Instruction& inst,
+                        uint64_t pc, uint64_t ea);
+    void handleSyscall();
+    int64_t emulateSyscall(uint64_t number, const uint64_t* args);
+    int64_t syscallRead(int fd, uint64_t addr, uint64_t count);
+    int64_t syscallWrite(int fd, uint64_t addr, uint64_t count);
+    int64_t syscallMmap(const uint64_t* args);
+    int64_t syscallOpen(int dirfd, const std::string& path, int flags, uint32_t mode);
+    int openHost(int dir, const std::string& path, int flags, uint32_t mode);
+    int hostFd(int fd) const;
+    void closeFiles();
+    std::string readGuestString(uint64_t addr);
+    void flushSyscallTrace();
+
+    // Analysis routines behind the callback-style registration
+    static void runBeforeCallbacks(void* context, const uint64_t* args);
+    static void runAfterCallbacks(void* context, const uint64_t* args);
+    static void runMemoryCallback(void* context, const uint64_t* args);
+
     std::string program_path_;
+    std::unique_ptr<elf::ElfFile> elf_;
     std::unique_ptr<Decoder> decoder_;
+    std::vector<api::InstructionInstrumentation> instruction_instrumentation_;
+    std::vector<api::BlockInstrumentation> block_instrumentation_;
     std::vector<InstrumentationCallback> before_callbacks_;
     std::vector<InstrumentationCallback> after_callbacks_;
-    
+
     // Internal state
-    std::unique_ptr<Instruction> current_instruction_;
+    const Instruction* current_instruction_ = nullptr;
     MemoryCallback memory_callback_;
+    SyscallCallback syscall_callback_;
+    std::vector<SyscallEvent> syscall_events_;
+    size_t syscall_batch_size_ = 1;
+    uint64_t last_syscall_instret_ = 0;
+    bool mappings_changed_ = false;     // By a syscall, which may have moved code
+    bool dry_run_ = false;
+
+    // A guest file descriptor. Each engine numbers its own, so engines in
+    // one process share no host fd beyond the standard streams.
+    struct GuestFile {
+        int host = -1;          // -1 when the guest fd is free
+        std::string path;       // As opened, for checkpoints to open it again
+        int flags = 0;
+        uint32_t mode = 0;
+    };
+    std::vector<GuestFile> files_{{0, {}, 0, 0}, {1, {}, 0, 0}, {2, {}, 0, 0}};
+
+    // Guest state
+    CpuState state_;
+    Memory memory_;
+    Interpreter interpreter_{state_, memory_};
+    BlockCache block_cache_;
+    std::unique_ptr<JitCompiler> jit_;      // Only in DispatchMode::JIT
+    JitContext jit_context_{&memory_, &current_instruction_};
+    uint64_t entry_ = 0;
+    uint64_t phdr_addr_ = 0;
+    uint16_t phnum_ = 0;
+    uint64_t brk_ = 0;
+    uint64_t mmap_top_ = 0;     // Lowest mmap() placement so far, 0 before the first
+    bool loaded_ = false;
+    bool verbose_ = true;
+    DispatchMode dispatch_mode_ = DispatchMode::THREADED;
+    bool exited_ = false;
+    int exit_code_ = 0;
+
+    // Region of interest. The current phase ends once instret reaches
+    // phase_end_, on reaching phase_pc_, or after phase_marker_ executes;
+    // blocks are decoded so that none runs past one of these.
+    RegionOptions region_;
+    uint64_t start_pc_ = 0;
+    Stage stage_ = Stage::SKIP;
+    uint64_t region_start_ = 0;
+    bool instrumenting_ = false;
+    uint64_t phase_end_ = ~0ull;
+    uint64_t phase_pc_ = ~0ull;
+    uint32_t phase_marker_ = 0;
 };
 
+template <typename Tool>
+int Engine::runWith(Tool& tool) {
+    using Hooks = api::ToolHooks<Tool>;
+    CurrentScope scope(this);
+    if constexpr (Hooks::PROGRAM_START) {
+        tool.Tool::onProgramStart();
+    }
+    int result = runLoop(tool);
+    if constexpr (Hooks::PROGRAM_END) {
+        tool.Tool::onProgramEnd();
+    }
+    return result;
+}
+
+template <typename Tool>
+int Engine::runLoop(Tool& tool) {
+    CurrentScope scope(this);
+    if (!beginRun()) {
+        return 1;
+    }
+    try {
+        // Fast-forwarding binds no tool, and its blocks are decoded
+        // without instrumentation, so nothing but the interpreter runs
+        struct NoTool {};
+        NoTool none;
+        for (Phase phase = nextPhase(); phase != Phase::DONE; phase = nextPhase()) {
+            if (phase == Phase::REGION) {
+                runPhase(tool);
+            } else {
+                runPhase(none);
+            }
+        }
+    } catch (const MemoryFault& e) {
+        flushSyscallTrace();
+        reportFault(e);
+        return 1;
+    } catch (const IllegalInstruction& e) {
+        flushSyscallTrace();
+        reportFault(e);
+        return 1;
+    }
+    flushSyscallTrace();
+    current_instruction_ = nullptr;
+    return exit_code_;
+}
+
+template <typename Tool>
+void Engine::runPhase(Tool& tool) {
+    BasicBlock* block = nullptr;
+    while (!exited_) {
+        block = nextBlock(block);
+        StepResult result = executeBlock(*block, tool);
+        const bool boundary = block->ends_phase || state_.instret >= phase_end_;
+        if (result != StepResult::CONTINUE) {
+            block = completeBlock(block, result);
+        }
+        if (boundary) {
+            return;
+        }
+    }
+}
+
+template <typename Tool>
+StepResult Engine::executeBlock(const BasicBlock& block, Tool& tool) {
+    // Qualified calls, so the hooks are not dispatched virtually even when
+    // Tool derives from api::InstrumentationTool
+    using Hooks = api::ToolHooks<Tool>;
+    constexpr bool PER_INSTRUCTION = Hooks::BEFORE_INSTRUCTION || Hooks::AFTER_INSTRUCTION;
+
+    // Only the last instruction of a block can return something other
+    // than CONTINUE
+    StepResult result = StepResult::CONTINUE;
+    if constexpr (!PER_INSTRUCTION) {
+        if (block.jit_entry && block.jit_generation == jit_->getGeneration()) {
+            return runCompiled(block);
+        }
+    }
+    if (block.calls.empty()) {
+        if constexpr (!PER_INSTRUCTION) {
+            if (!block.threaded.empty()) {
+                return interpreter_.run(block.threaded.data());
+            }
+        }
+        for (const Instruction& inst : block.instructions) {
+            if constexpr (PER_INSTRUCTION) {
+                current_instruction_ = &inst;
+            }
+            if constexpr (Hooks::BEFORE_INSTRUCTION) {
+                tool.Tool::onBeforeInstruction(inst);
+            }
+            result = interpreter_.step(inst);
+            if constexpr (Hooks::AFTER_INSTRUCTION) {
+                tool.Tool::onAfterInstruction(inst);
+            }
+        }
+        return result;
+    }
+
+    const api::AnalysisCall* call = block.calls.data();
+    const api::AnalysisCall* end = call + block.calls.size();
+    for (size_t i = 0; i < block.instructions.size(); ++i) {
+        const Instruction& inst = block.instructions[i];
+        if (!PER_INSTRUCTION && (call == end || call->inst_index != i)) {
+            result = interpreter_.step(inst);
+            continue;
+        }
+
+        // Capture pc and effective address before the instruction can
+        // overwrite its base register
+        current_instruction_ = &inst;
+        const uint64_t pc = state_.pc;
+        const uint64_t ea = state_.x[inst.getRs1()] + inst.getImmediate();
+        if constexpr (Hooks::BEFORE_INSTRUCTION) {
+            tool.Tool::onBeforeInstruction(inst);
+        }
+        for (; call != end && call->inst_index == i && call->point == api::IPoint::BEFORE; ++call) {
+            invokeAnalysis(*call, inst, pc, ea);
+        }
+
+        result = interpreter_.step(inst);
+
+        for (; call != end && call->inst_index == i; ++call) {
+            invokeAnalysis(*call, inst, pc, ea);
+        }
+        if constexpr (Hooks::AFTER_INSTRUCTION) {
+            tool.Tool::onAfterInstruction(inst);
+        }
+    }
+    return result;
+}
+
 } // namespace rvpin
@@ -1,56 +1,100 @@
 #include "instruction.hpp"
-#include "encoding.hpp"
-#include <sstream>
+#include "decoder.hpp"
 
 namespace rvpin {
 
-Instruction::Instruction(uint32_t raw_inst) : raw_inst_(raw_inst), type_(Type::UNKNOWN) {
-    decode();
-}
+namespace {
 
-void Instruction::decode() {
-    // Try to match against known instruction encodings
-    for (const auto& encoding : encoding::INSTRUCTION_ENCODINGS) {
-        if ((raw_inst_ & encoding.mask) == (encoding.match & encoding.mask)) {
-            mnemonic_ = encoding.name;
-            return;
-        }
-    }
+using Type = Instruction::Type;
 
-    // Special case for ECALL (until we get proper encoding)
-    if (raw_inst_ == 0x00000073) {
-        mnemonic_ = "ECALL";
-        type_ = Type::I_TYPE;
-        return;
-    }
+// Instruction format by major opcode (bits [6:2])
+constexpr Type FORMAT_BY_OPCODE[32] = {
+    Type::I_TYPE,   // 0x03 LOAD
+    Type::I_TYPE,   // 0x07 LOAD-FP
+    Type::UNKNOWN,  // 0x0b custom-0
+    Type::I_TYPE,   // 0x0f MISC-MEM
+    Type::I_TYPE,   // 0x13 OP-IMM
+    Type::U_TYPE,   // 0x17 AUIPC
+    Type::I_TYPE,   // 0x1b OP-IMM-32
+    Type::UNKNOWN,  // 0x1f 48-bit
+    Type::S_TYPE,   // 0x23 STORE
+    Type::S_TYPE,   // 0x27 STORE-FP
+    Type::UNKNOWN,  // 0x2b custom-1
+    Type::R_TYPE,   // 0x2f AMO
+    Type::R_TYPE,   // 0x33 OP
+    Type::U_TYPE,   // 0x37 LUI
+    Type::R_TYPE,   // 0x3b OP-32
+    Type::UNKNOWN,  // 0x3f 64-bit
+    Type::R_TYPE,   // 0x43 MADD
+    Type::R_TYPE,   // 0x47 MSUB
+    Type::R_TYPE,   // 0x4b NMSUB
+    Type::R_TYPE,   // 0x4f NMADD
+    Type::R_TYPE,   // 0x53 OP-FP
+    Type::UNKNOWN,  // 0x57 OP-V
+    Type::UNKNOWN,  // 0x5b custom-2
+    Type::UNKNOWN,  // 0x5f 48-bit
+    Type::B_TYPE,   // 0x63 BRANCH
+    Type::I_TYPE,   // 0x67 JALR
+    Type::UNKNOWN,  // 0x6b reserved
+    Type::J_TYPE,   // 0x6f JAL
+    Type::I_TYPE,   // 0x73 SYSTEM
+    Type::UNKNOWN,  // 0x77 reserved
+    Type::UNKNOWN,  // 0x7b custom-3
+    Type::UNKNOWN,  // 0x7f 80-bit
+};
 
-    // If no match found, mark as unknown
-    mnemonic_ = "UNKNOWN";
-    type_ = Type::UNKNOWN;
+int32_t extractImmediate(uint32_t raw, Type type) {
+    const int32_t s = static_cast<int32_t>(raw);
+    switch (type) {
+        case Type::I_TYPE:
+            return s >> 20;
+        case Type::S_TYPE:
+            return ((s >> 25) << 5) | ((raw >> 7) & 0x1F);
+        case Type::B_TYPE:
+            return ((s >> 31) << 12) | (((raw >> 7) & 0x1) << 11) |
+                   (((raw >> 25) & 0x3F) << 5) | (((raw >> 8) & 0xF) << 1);
+        case Type::U_TYPE:
+            return static_cast<int32_t>(raw & 0xFFFFF000);
+        case Type::J_TYPE:
+            return ((s >> 31) << 20) | (raw & 0xFF000) |
+                   (((raw >> 20) & 0x1) << 11) | (((raw >> 21) & 0x3FF) << 1);
+        default:
+            return 0;
+    }
 }
 
-uint32_t Instruction::getOpcode() const {
-    return raw_inst_ & 0x7F;
-}
+} // namespace
 
-uint32_t Instruction::getFunct3() const {
-    return (raw_inst_ >> 12) & 0x7;
-}
-
-uint32_t Instruction::getFunct7() const {
-    return (raw_inst_ >> 25) & 0x7F;
+Instruction::Instruction(uint32_t raw_inst) : raw_inst_(raw_inst) {
+    if ((raw_inst & 0x3) != 0x3) {
+        // Decode the expanded form; an illegal parcel is kept as is and
+        // matches no encoding
+        const auto parcel = static_cast<uint16_t>(raw_inst);
+        const uint32_t expanded = Decoder::expandCompressed(parcel);
+        raw_inst_ = expanded != 0 ? expanded : parcel;
+        size_ = 2;
+    }
+    decode();
 }
 
-uint32_t Instruction::getRd() const {
-    return (raw_inst_ >> 7) & 0x1F;
-}
+void Instruction::decode() {
+    rd_ = (raw_inst_ >> 7) & 0x1F;
+    rs1_ = (raw_inst_ >> 15) & 0x1F;
+    rs2_ = (raw_inst_ >> 20) & 0x1F;
 
-uint32_t Instruction::getRs1() const {
-    return (raw_inst_ >> 15) & 0x1F;
-}
+    // Try to match against known instruction encodings
+    int index = Decoder::lookup(raw_inst_);
+    if (index < 0) {
+        // If no match found, mark as unknown
+        opcode_id_ = encoding::OP_UNKNOWN;
+        type_ = Type::UNKNOWN;
+        imm_ = 0;
+        return;
+    }
 
-uint32_t Instruction::getRs2() const {
-    return (raw_inst_ >> 20) & 0x1F;
+    opcode_id_ = static_cast<uint16_t>(index);
+    type_ = FORMAT_BY_OPCODE[(raw_inst_ >> 2) & 0x1F];
+    imm_ = extractImmediate(raw_inst_, type_);
 }
 
 } // namespace rvpin
@@ -1,13 +1,17 @@
 #pragma once
 
 #include <cstdint>
-#include <string>
+#include <string_view>
+#include <type_traits>
+#include "encoding.hpp"
 
 namespace rvpin {
 
+// Decoded instruction. Trivially copyable and 16 bytes, so decoded code
+// can be stored contiguously and passed around by value.
 class Instruction {
 public:
-    enum class Type {
+    enum class Type : uint8_t {
         R_TYPE,
         I_TYPE,
         S_TYPE,
@@ -17,26 +21,57 @@ public:
         UNKNOWN
     };
 
+    Instruction() = default;
+
+    // raw_inst holds the bytes at the instruction address. If its low two
+    // bits are not 0b11 only the low 16 bits are used, as an RVC parcel.
     Instruction(uint32_t raw_inst);
-    
+
+    // 32-bit encoding. Compressed instructions report their expanded
+    // equivalent, so all fields below read the same for both forms.
     uint32_t getRawInstruction() const { return raw_inst_; }
     Type getType() const { return type_; }
-    std::string getMnemonic() const { return mnemonic_; }
-    
+
+    // Size in bytes: 2 for RVC instructions, 4 otherwise
+    uint32_t getSize() const { return size_; }
+    bool isCompressed() const { return size_ == 2; }
+
+    // Index into encoding::INSTRUCTION_ENCODINGS, or OP_UNKNOWN
+    encoding::Opcode getOpcodeId() const { return static_cast<encoding::Opcode>(opcode_id_); }
+    bool isValid() const { return opcode_id_ != encoding::OP_UNKNOWN; }
+
+    // Points into the generated encoding table, no copy is made
+    std::string_view getMnemonic() const {
+        return isValid() ? encoding::INSTRUCTION_ENCODINGS[opcode_id_].name
+                         : std::string_view("UNKNOWN");
+    }
+
     // RISC-V specific instruction fields
-    uint32_t getOpcode() const;
-    uint32_t getFunct3() const;
-    uint32_t getFunct7() const;
-    uint32_t getRd() const;
-    uint32_t getRs1() const;
-    uint32_t getRs2() const;
-    
+    uint32_t getOpcode() const { return raw_inst_ & 0x7F; }
+    uint32_t getFunct3() const { return (raw_inst_ >> 12) & 0x7; }
+    uint32_t getFunct7() const { return (raw_inst_ >> 25) & 0x7F; }
+    uint32_t getRd() const { return rd_; }
+    uint32_t getRs1() const { return rs1_; }
+    uint32_t getRs2() const { return rs2_; }
+
+    // Sign-extended immediate for I/S/B/U/J types, 0 otherwise
+    int32_t getImmediate() const { return imm_; }
+
 private:
-    uint32_t raw_inst_;
-    Type type_;
-    std::string mnemonic_;
-    
+    uint32_t raw_inst_{0};
+    int32_t imm_{0};
+    uint16_t opcode_id_{encoding::OP_UNKNOWN};
+    Type type_{Type::UNKNOWN};
+    uint8_t rd_{0};
+    uint8_t rs1_{0};
+    uint8_t rs2_{0};
+    uint8_t size_{4};
+
     void decode();
 };
 
+static_assert(sizeof(Instruction) == 16, "Instruction should stay 16 bytes");
+static_assert(std::is_trivially_copyable<Instruction>::value,
+              "Instruction must be trivially copyable");
+
 } // namespace rvpin
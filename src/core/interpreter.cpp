@@ -0,0 +1,816 @@
+#include "interpreter.hpp"
+#include "isa.hpp"
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace rvpin {
+
+namespace {
+
+using namespace encoding;
+
+constexpr uint64_t NAN_BOX = 0xFFFFFFFF00000000ull;
+constexpr uint32_t CANONICAL_NAN_F = 0x7FC00000u;
+constexpr uint64_t CANONICAL_NAN_D = 0x7FF8000000000000ull;
+
+// CSR numbers visible to user mode
+constexpr uint32_t CSR_FFLAGS = 0x001;
+constexpr uint32_t CSR_FRM = 0x002;
+constexpr uint32_t CSR_FCSR = 0x003;
+constexpr uint32_t CSR_CYCLE = 0xC00;
+constexpr uint32_t CSR_TIME = 0xC01;
+constexpr uint32_t CSR_INSTRET = 0xC02;
+
+inline uint64_t sext32(uint64_t value) {
+    return static_cast<uint64_t>(static_cast<int64_t>(static_cast<int32_t>(value)));
+}
+
+template <typename To, typename From>
+inline To bitCast(From value) {
+    static_assert(sizeof(To) == sizeof(From), "bitCast size mismatch");
+    To result;
+    std::memcpy(&result, &value, sizeof(To));
+    return result;
+}
+
+// Single-precision values must be NaN-boxed, anything else reads as NaN
+inline float unboxF(uint64_t reg) {
+    uint32_t bits = (reg & NAN_BOX) == NAN_BOX ? static_cast<uint32_t>(reg) : CANONICAL_NAN_F;
+    return bitCast<float>(bits);
+}
+
+inline uint32_t unboxBitsF(uint64_t reg) {
+    return (reg & NAN_BOX) == NAN_BOX ? static_cast<uint32_t>(reg) : CANONICAL_NAN_F;
+}
+
+inline uint64_t boxF(float value) {
+    uint32_t bits = std::isnan(value) ? CANONICAL_NAN_F : bitCast<uint32_t>(value);
+    return NAN_BOX | bits;
+}
+
+inline double unboxD(uint64_t reg) {
+    return bitCast<double>(reg);
+}
+
+inline uint64_t boxD(double value) {
+    return std::isnan(value) ? CANONICAL_NAN_D : bitCast<uint64_t>(value);
+}
+
+template <typename F>
+inline F roundWithMode(F value, uint32_t rm) {
+    switch (rm) {
+        case 1: return std::trunc(value);   // RTZ
+        case 2: return std::floor(value);   // RDN
+        case 3: return std::ceil(value);    // RUP
+        case 4: return std::round(value);   // RMM
+        default: return std::nearbyint(value);  // RNE
+    }
+}
+
+// RISC-V float-to-integer conversion: saturating, NaN converts to max
+template <typename Int, typename F>
+inline Int convertToInt(F value, uint32_t rm) {
+    constexpr Int max = std::numeric_limits<Int>::max();
+    constexpr Int min = std::numeric_limits<Int>::min();
+    if (std::isnan(value)) {
+        return max;
+    }
+    F rounded = roundWithMode(value, rm);
+    constexpr int bits = std::numeric_limits<Int>::digits;
+    if (rounded >= std::ldexp(F(1), bits)) {
+        return max;
+    }
+    if (std::numeric_limits<Int>::is_signed ? rounded < -std::ldexp(F(1), bits) : rounded < F(0)) {
+        return min;
+    }
+    return static_cast<Int>(rounded);
+}
+
+template <typename F>
+inline F minNum(F a, F b, bool is_max) {
+    if (std::isnan(a) && std::isnan(b)) {
+        return std::numeric_limits<F>::quiet_NaN();
+    }
+    if (std::isnan(a)) {
+        return b;
+    }
+    if (std::isnan(b)) {
+        return a;
+    }
+    if (a == b) {
+        // Only differs for zeros: -0 < +0
+        return std::signbit(a) != is_max ? a : b;
+    }
+    return (a < b) != is_max ? a : b;
+}
+
+template <typename F, typename Bits>
+inline uint64_t classify(F value, Bits bits, Bits quiet_bit) {
+    bool negative = std::signbit(value);
+    switch (std::fpclassify(value)) {
+        case FP_INFINITE: return negative ? 1u << 0 : 1u << 7;
+        case FP_NORMAL: return negative ? 1u << 1 : 1u << 6;
+        case FP_SUBNORMAL: return negative ? 1u << 2 : 1u << 5;
+        case FP_ZERO: return negative ? 1u << 3 : 1u << 4;
+        default: return (bits & quiet_bit) ? 1u << 9 : 1u << 8;
+    }
+}
+
+template <typename T>
+inline T amoCompute(Opcode op, T mem, T reg) {
+    using S = std::make_signed_t<T>;
+    using U = std::make_unsigned_t<T>;
+    switch (op) {
+        case OP_AMOADD_W: case OP_AMOADD_D: return mem + reg;
+        case OP_AMOXOR_W: case OP_AMOXOR_D: return mem ^ reg;
+        case OP_AMOOR_W: case OP_AMOOR_D: return mem | reg;
+        case OP_AMOAND_W: case OP_AMOAND_D: return mem & reg;
+        case OP_AMOMIN_W: case OP_AMOMIN_D: return static_cast<S>(mem) < static_cast<S>(reg) ? mem : reg;
+        case OP_AMOMAX_W: case OP_AMOMAX_D: return static_cast<S>(mem) > static_cast<S>(reg) ? mem : reg;
+        case OP_AMOMINU_W: case OP_AMOMINU_D: return static_cast<U>(mem) < static_cast<U>(reg) ? mem : reg;
+        case OP_AMOMAXU_W: case OP_AMOMAXU_D: return static_cast<U>(mem) > static_cast<U>(reg) ? mem : reg;
+        default: return reg;  // AMOSWAP
+    }
+}
+
+} // namespace
+
+StepResult Interpreter::step(const Instruction& inst) {
+    CpuState& s = state_;
+    uint64_t* x = s.x;
+    uint64_t* f = s.f;
+
+    const uint32_t raw = inst.getRawInstruction();
+    const uint32_t rd = inst.getRd();
+    const uint32_t rs1 = inst.getRs1();
+    const uint32_t rs2 = inst.getRs2();
+    const uint32_t rs3 = raw >> 27;
+    const uint64_t a = x[rs1];
+    const uint64_t b = x[rs2];
+    const int64_t imm = inst.getImmediate();
+    const uint32_t rm = inst.getFunct3() == 7 ? (s.fcsr >> 5) & 0x7 : inst.getFunct3();
+
+    uint64_t next_pc = s.pc + inst.getSize();
+    StepResult result = StepResult::CONTINUE;
+
+    switch (inst.getOpcodeId()) {
+        // RV64I
+        case OP_LUI: x[rd] = imm; break;
+        case OP_AUIPC: x[rd] = s.pc + imm; break;
+        case OP_JAL: x[rd] = next_pc; next_pc = s.pc + imm; break;
+        case OP_JALR: {
+            uint64_t target = (a + imm) & ~1ull;
+            x[rd] = next_pc;
+            next_pc = target;
+            break;
+        }
+        case OP_BEQ: if (a == b) next_pc = s.pc + imm; break;
+        case OP_BNE: if (a != b) next_pc = s.pc + imm; break;
+        case OP_BLT: if (static_cast<int64_t>(a) < static_cast<int64_t>(b)) next_pc = s.pc + imm; break;
+        case OP_BGE: if (static_cast<int64_t>(a) >= static_cast<int64_t>(b)) next_pc = s.pc + imm; break;
+        case OP_BLTU: if (a < b) next_pc = s.pc + imm; break;
+        case OP_BGEU: if (a >= b) next_pc = s.pc + imm; break;
+        case OP_LB: x[rd] = static_cast<int64_t>(memory_.load<int8_t>(a + imm)); break;
+        case OP_LH: x[rd] = static_cast<int64_t>(memory_.load<int16_t>(a + imm)); break;
+        case OP_LW: x[rd] = static_cast<int64_t>(memory_.load<int32_t>(a + imm)); break;
+        case OP_LD: x[rd] = memory_.load<uint64_t>(a + imm); break;
+        case OP_LBU: x[rd] = memory_.load<uint8_t>(a + imm); break;
+        case OP_LHU: x[rd] = memory_.load<uint16_t>(a + imm); break;
+        case OP_LWU: x[rd] = memory_.load<uint32_t>(a + imm); break;
+        case OP_SB: memory_.store<uint8_t>(a + imm, static_cast<uint8_t>(b)); break;
+        case OP_SH: memory_.store<uint16_t>(a + imm, static_cast<uint16_t>(b)); break;
+        case OP_SW: memory_.store<uint32_t>(a + imm, static_cast<uint32_t>(b)); break;
+        case OP_SD: memory_.store<uint64_t>(a + imm, b); break;
+        case OP_ADDI: x[rd] = a + imm; break;
+        case OP_SLTI: x[rd] = static_cast<int64_t>(a) < imm; break;
+        case OP_SLTIU: x[rd] = a < static_cast<uint64_t>(imm); break;
+        case OP_XORI: x[rd] = a ^ imm; break;
+        case OP_ORI: x[rd] = a | imm; break;
+        case OP_ANDI: x[rd] = a & imm; break;
+        case OP_SLLI: x[rd] = a << (imm & 0x3F); break;
+        case OP_SRLI: x[rd] = a >> (imm & 0x3F); break;
+        case OP_SRAI: x[rd] = static_cast<int64_t>(a) >> (imm & 0x3F); break;
+        case OP_ADD: x[rd] = a + b; break;
+        case OP_SUB: x[rd] = a - b; break;
+        case OP_SLL: x[rd] = a << (b & 0x3F); break;
+        case OP_SLT: x[rd] = static_cast<int64_t>(a) < static_cast<int64_t>(b); break;
+        case OP_SLTU: x[rd] = a < b; break;
+        case OP_XOR: x[rd] = a ^ b; break;
+        case OP_SRL: x[rd] = a >> (b & 0x3F); break;
+        case OP_SRA: x[rd] = static_cast<int64_t>(a) >> (b & 0x3F); break;
+        case OP_OR: x[rd] = a | b; break;
+        case OP_AND: x[rd] = a & b; break;
+        case OP_ADDIW: x[rd] = sext32(a + imm); break;
+        case OP_SLLIW: x[rd] = sext32(static_cast<uint32_t>(a) << (imm & 0x1F)); break;
+        case OP_SRLIW: x[rd] = sext32(static_cast<uint32_t>(a) >> (imm & 0x1F)); break;
+        case OP_SRAIW: x[rd] = sext32(static_cast<int32_t>(a) >> (imm & 0x1F)); break;
+        case OP_ADDW: x[rd] = sext32(a + b); break;
+        case OP_SUBW: x[rd] = sext32(a - b); break;
+        case OP_SLLW: x[rd] = sext32(static_cast<uint32_t>(a) << (b & 0x1F)); break;
+        case OP_SRLW: x[rd] = sext32(static_cast<uint32_t>(a) >> (b & 0x1F)); break;
+        case OP_SRAW: x[rd] = sext32(static_cast<int32_t>(a) >> (b & 0x1F)); break;
+        case OP_FENCE: case OP_FENCE_TSO: case OP_PAUSE: break;
+        case OP_FENCE_I: result = StepResult::FENCE_I; break;
+        case OP_ECALL: result = StepResult::SYSCALL; break;
+        case OP_EBREAK: result = StepResult::BREAKPOINT; break;
+
+        // RV64M
+        case OP_MUL: x[rd] = a * b; break;
+        case OP_MULH:
+            x[rd] = static_cast<uint64_t>((static_cast<__int128>(static_cast<int64_t>(a)) *
+                                           static_cast<int64_t>(b)) >> 64);
+            break;
+        case OP_MULHSU:
+            x[rd] = static_cast<uint64_t>((static_cast<__int128>(static_cast<int64_t>(a)) *
+                                           static_cast<__int128>(b)) >> 64);
+            break;
+        case OP_MULHU:
+            x[rd] = static_cast<uint64_t>((static_cast<unsigned __int128>(a) * b) >> 64);
+            break;
+        case OP_DIV: {
+            int64_t sa = static_cast<int64_t>(a), sb = static_cast<int64_t>(b);
+            if (sb == 0) x[rd] = ~0ull;
+            else if (sa == std::numeric_limits<int64_t>::min() && sb == -1) x[rd] = a;
+            else x[rd] = sa / sb;
+            break;
+        }
+        case OP_DIVU: x[rd] = b == 0 ? ~0ull : a / b; break;
+        case OP_REM: {
+            int64_t sa = static_cast<int64_t>(a), sb = static_cast<int64_t>(b);
+            if (sb == 0) x[rd] = a;
+            else if (sa == std::numeric_limits<int64_t>::min() && sb == -1) x[rd] = 0;
+            else x[rd] = sa % sb;
+            break;
+        }
+        case OP_REMU: x[rd] = b == 0 ? a : a % b; break;
+        case OP_MULW: x[rd] = sext32(static_cast<uint32_t>(a) * static_cast<uint32_t>(b)); break;
+        case OP_DIVW: {
+            int32_t sa = static_cast<int32_t>(a), sb = static_cast<int32_t>(b);
+            if (sb == 0) x[rd] = ~0ull;
+            else if (sa == std::numeric_limits<int32_t>::min() && sb == -1) x[rd] = sext32(sa);
+            else x[rd] = sext32(sa / sb);
+            break;
+        }
+        case OP_DIVUW: {
+            uint32_t ua = static_cast<uint32_t>(a), ub = static_cast<uint32_t>(b);
+            x[rd] = ub == 0 ? ~0ull : sext32(ua / ub);
+            break;
+        }
+        case OP_REMW: {
+            int32_t sa = static_cast<int32_t>(a), sb = static_cast<int32_t>(b);
+            if (sb == 0) x[rd] = sext32(sa);
+            else if (sa == std::numeric_limits<int32_t>::min() && sb == -1) x[rd] = 0;
+            else x[rd] = sext32(sa % sb);
+            break;
+        }
+        case OP_REMUW: {
+            uint32_t ua = static_cast<uint32_t>(a), ub = static_cast<uint32_t>(b);
+            x[rd] = sext32(ub == 0 ? ua : ua % ub);
+            break;
+        }
+
+        // RV64A, single hart so every access is already atomic
+        case OP_LR_W: x[rd] = sext32(memory_.load<uint32_t>(a)); s.reservation = a; break;
+        case OP_LR_D: x[rd] = memory_.load<uint64_t>(a); s.reservation = a; break;
+        case OP_SC_W:
+        case OP_SC_D:
+            if (s.reservation == a) {
+                if (inst.getOpcodeId() == OP_SC_W) {
+                    memory_.store<uint32_t>(a, static_cast<uint32_t>(b));
+                } else {
+                    memory_.store<uint64_t>(a, b);
+                }
+                x[rd] = 0;
+            } else {
+                x[rd] = 1;
+            }
+            s.reservation = ~0ull;
+            break;
+        case OP_AMOADD_W: case OP_AMOXOR_W: case OP_AMOOR_W: case OP_AMOAND_W:
+        case OP_AMOMIN_W: case OP_AMOMAX_W: case OP_AMOMINU_W: case OP_AMOMAXU_W:
+        case OP_AMOSWAP_W: {
+            uint32_t old = memory_.load<uint32_t>(a);
+            memory_.store<uint32_t>(a, amoCompute<uint32_t>(inst.getOpcodeId(), old,
+                                                            static_cast<uint32_t>(b)));
+            x[rd] = sext32(old);
+            break;
+        }
+        case OP_AMOADD_D: case OP_AMOXOR_D: case OP_AMOOR_D: case OP_AMOAND_D:
+        case OP_AMOMIN_D: case OP_AMOMAX_D: case OP_AMOMINU_D: case OP_AMOMAXU_D:
+        case OP_AMOSWAP_D: {
+            uint64_t old = memory_.load<uint64_t>(a);
+            memory_.store<uint64_t>(a, amoCompute<uint64_t>(inst.getOpcodeId(), old, b));
+            x[rd] = old;
+            break;
+        }
+
+        // RV64F
+        case OP_FLW: f[rd] = NAN_BOX | memory_.load<uint32_t>(a + imm); break;
+        case OP_FSW: memory_.store<uint32_t>(a + imm, static_cast<uint32_t>(f[rs2])); break;
+        case OP_FMADD_S: f[rd] = boxF(std::fma(unboxF(f[rs1]), unboxF(f[rs2]), unboxF(f[rs3]))); break;
+        case OP_FMSUB_S: f[rd] = boxF(std::fma(unboxF(f[rs1]), unboxF(f[rs2]), -unboxF(f[rs3]))); break;
+        case OP_FNMSUB_S: f[rd] = boxF(std::fma(-unboxF(f[rs1]), unboxF(f[rs2]), unboxF(f[rs3]))); break;
+        case OP_FNMADD_S: f[rd] = boxF(std::fma(-unboxF(f[rs1]), unboxF(f[rs2]), -unboxF(f[rs3]))); break;
+        case OP_FADD_S: f[rd] = boxF(unboxF(f[rs1]) + unboxF(f[rs2])); break;
+        case OP_FSUB_S: f[rd] = boxF(unboxF(f[rs1]) - unboxF(f[rs2])); break;
+        case OP_FMUL_S: f[rd] = boxF(unboxF(f[rs1]) * unboxF(f[rs2])); break;
+        case OP_FDIV_S: f[rd] = boxF(unboxF(f[rs1]) / unboxF(f[rs2])); break;
+        case OP_FSQRT_S: f[rd] = boxF(std::sqrt(unboxF(f[rs1]))); break;
+        case OP_FSGNJ_S:
+            f[rd] = NAN_BOX | (unboxBitsF(f[rs1]) & 0x7FFFFFFF) | (unboxBitsF(f[rs2]) & 0x80000000);
+            break;
+        case OP_FSGNJN_S:
+            f[rd] = NAN_BOX | (unboxBitsF(f[rs1]) & 0x7FFFFFFF) | (~unboxBitsF(f[rs2]) & 0x80000000);
+            break;
+        case OP_FSGNJX_S:
+            f[rd] = NAN_BOX | (unboxBitsF(f[rs1]) ^ (unboxBitsF(f[rs2]) & 0x80000000));
+            break;
+        case OP_FMIN_S: f[rd] = boxF(minNum(unboxF(f[rs1]), unboxF(f[rs2]), false)); break;
+        case OP_FMAX_S: f[rd] = boxF(minNum(unboxF(f[rs1]), unboxF(f[rs2]), true)); break;
+        case OP_FCVT_W_S: x[rd] = sext32(convertToInt<int32_t>(unboxF(f[rs1]), rm)); break;
+        case OP_FCVT_WU_S: x[rd] = sext32(convertToInt<uint32_t>(unboxF(f[rs1]), rm)); break;
+        case OP_FCVT_L_S: x[rd] = convertToInt<int64_t>(unboxF(f[rs1]), rm); break;
+        case OP_FCVT_LU_S: x[rd] = convertToInt<uint64_t>(unboxF(f[rs1]), rm); break;
+        case OP_FMV_X_W: x[rd] = sext32(f[rs1]); break;
+        case OP_FEQ_S: x[rd] = unboxF(f[rs1]) == unboxF(f[rs2]); break;
+        case OP_FLT_S: x[rd] = unboxF(f[rs1]) < unboxF(f[rs2]); break;
+        case OP_FLE_S: x[rd] = unboxF(f[rs1]) <= unboxF(f[rs2]); break;
+        case OP_FCLASS_S: x[rd] = classify(unboxF(f[rs1]), unboxBitsF(f[rs1]), 1u << 22); break;
+        case OP_FCVT_S_W: f[rd] = boxF(static_cast<float>(static_cast<int32_t>(a))); break;
+        case OP_FCVT_S_WU: f[rd] = boxF(static_cast<float>(static_cast<uint32_t>(a))); break;
+        case OP_FCVT_S_L: f[rd] = boxF(static_cast<float>(static_cast<int64_t>(a))); break;
+        case OP_FCVT_S_LU: f[rd] = boxF(static_cast<float>(a)); break;
+        case OP_FMV_W_X: f[rd] = NAN_BOX | static_cast<uint32_t>(a); break;
+
+        // RV64D
+        case OP_FLD: f[rd] = memory_.load<uint64_t>(a + imm); break;
+        case OP_FSD: memory_.store<uint64_t>(a + imm, f[rs2]); break;
+        case OP_FMADD_D: f[rd] = boxD(std::fma(unboxD(f[rs1]), unboxD(f[rs2]), unboxD(f[rs3]))); break;
+        case OP_FMSUB_D: f[rd] = boxD(std::fma(unboxD(f[rs1]), unboxD(f[rs2]), -unboxD(f[rs3]))); break;
+        case OP_FNMSUB_D: f[rd] = boxD(std::fma(-unboxD(f[rs1]), unboxD(f[rs2]), unboxD(f[rs3]))); break;
+        case OP_FNMADD_D: f[rd] = boxD(std::fma(-unboxD(f[rs1]), unboxD(f[rs2]), -unboxD(f[rs3]))); break;
+        case OP_FADD_D: f[rd] = boxD(unboxD(f[rs1]) + unboxD(f[rs2])); break;
+        case OP_FSUB_D: f[rd] = boxD(unboxD(f[rs1]) - unboxD(f[rs2])); break;
+        case OP_FMUL_D: f[rd] = boxD(unboxD(f[rs1]) * unboxD(f[rs2])); break;
+        case OP_FDIV_D: f[rd] = boxD(unboxD(f[rs1]) / unboxD(f[rs2])); break;
+        case OP_FSQRT_D: f[rd] = boxD(std::sqrt(unboxD(f[rs1]))); break;
+        case OP_FSGNJ_D:
+            f[rd] = (f[rs1] & ~(1ull << 63)) | (f[rs2] & (1ull << 63));
+            break;
+        case OP_FSGNJN_D:
+            f[rd] = (f[rs1] & ~(1ull << 63)) | (~f[rs2] & (1ull << 63));
+            break;
+        case OP_FSGNJX_D:
+            f[rd] = f[rs1] ^ (f[rs2] & (1ull << 63));
+            break;
+        case OP_FMIN_D: f[rd] = boxD(minNum(unboxD(f[rs1]), unboxD(f[rs2]), false)); break;
+        case OP_FMAX_D: f[rd] = boxD(minNum(unboxD(f[rs1]), unboxD(f[rs2]), true)); break;
+        case OP_FCVT_S_D: f[rd] = boxF(static_cast<float>(unboxD(f[rs1]))); break;
+        case OP_FCVT_D_S: f[rd] = boxD(static_cast<double>(unboxF(f[rs1]))); break;
+        case OP_FEQ_D: x[rd] = unboxD(f[rs1]) == unboxD(f[rs2]); break;
+        case OP_FLT_D: x[rd] = unboxD(f[rs1]) < unboxD(f[rs2]); break;
+        case OP_FLE_D: x[rd] = unboxD(f[rs1]) <= unboxD(f[rs2]); break;
+        case OP_FCLASS_D: x[rd] = classify(unboxD(f[rs1]), f[rs1], uint64_t(1) << 51); break;
+        case OP_FCVT_W_D: x[rd] = sext32(convertToInt<int32_t>(unboxD(f[rs1]), rm)); break;
+        case OP_FCVT_WU_D: x[rd] = sext32(convertToInt<uint32_t>(unboxD(f[rs1]), rm)); break;
+        case OP_FCVT_L_D: x[rd] = convertToInt<int64_t>(unboxD(f[rs1]), rm); break;
+        case OP_FCVT_LU_D: x[rd] = convertToInt<uint64_t>(unboxD(f[rs1]), rm); break;
+        case OP_FCVT_D_W: f[rd] = boxD(static_cast<double>(static_cast<int32_t>(a))); break;
+        case OP_FCVT_D_WU: f[rd] = boxD(static_cast<double>(static_cast<uint32_t>(a))); break;
+        case OP_FCVT_D_L: f[rd] = boxD(static_cast<double>(static_cast<int64_t>(a))); break;
+        case OP_FCVT_D_LU: f[rd] = boxD(static_cast<double>(a)); break;
+        case OP_FMV_X_D: x[rd] = f[rs1]; break;
+        case OP_FMV_D_X: f[rd] = a; break;
+
+        // Zicsr
+        case OP_CSRRW: case OP_CSRRS: case OP_CSRRC:
+        case OP_CSRRWI: case OP_CSRRSI: case OP_CSRRCI: {
+            const uint32_t csr = raw >> 20;
+            const Opcode op = inst.getOpcodeId();
+            const bool is_imm = op == OP_CSRRWI || op == OP_CSRRSI || op == OP_CSRRCI;
+            const uint64_t operand = is_imm ? rs1 : a;
+            const uint64_t old = readCsr(csr, inst);
+            if (op == OP_CSRRW || op == OP_CSRRWI) {
+                writeCsr(csr, operand, inst);
+            } else if (rs1 != 0) {
+                bool set = op == OP_CSRRS || op == OP_CSRRSI;
+                writeCsr(csr, set ? old | operand : old & ~operand, inst);
+            }
+            x[rd] = old;
+            break;
+        }
+
+        default:
+            throw IllegalInstruction(s.pc, raw);
+    }
+
+    x[0] = 0;
+    s.pc = next_pc;
+    s.instret++;
+    return result;
+}
+
+// Threaded dispatch. Each handler runs one op and jumps straight to the
+// next op's handler, so there is no loop, decode or switch between
+// instructions. Handlers only keep the pc and instret up to date where an
+// instruction can observe them or fault; a fault re-synchronises both
+// from the op that raised it.
+
+#define RVPIN_THREADED_HANDLERS(X) \
+    X(END) X(GENERIC) X(NOP) X(CONST) \
+    X(ADDI) X(SLTI) X(SLTIU) X(XORI) X(ORI) X(ANDI) X(SLLI) X(SRLI) X(SRAI) \
+    X(ADD) X(SUB) X(SLL) X(SLT) X(SLTU) X(XOR) X(SRL) X(SRA) X(OR) X(AND) \
+    X(ADDIW) X(SLLIW) X(SRLIW) X(SRAIW) X(ADDW) X(SUBW) X(MUL) \
+    X(LB) X(LH) X(LW) X(LD) X(LBU) X(LHU) X(LWU) X(SB) X(SH) X(SW) X(SD) \
+    X(JAL) X(JALR) X(BEQ) X(BNE) X(BLT) X(BGE) X(BLTU) X(BGEU) \
+    X(AUIPC_JALR) X(AUIPC_LD) X(AUIPC_LW) \
+    X(SLT_BRANCH) X(SLTU_BRANCH) X(SLTI_BRANCH) X(SLTIU_BRANCH)
+
+namespace {
+
+enum HandlerId : uint8_t {
+#define RVPIN_HANDLER_ID(name) H_##name,
+    RVPIN_THREADED_HANDLERS(RVPIN_HANDLER_ID)
+#undef RVPIN_HANDLER_ID
+    NUM_HANDLERS
+};
+
+// Handler for a pair, filling in op, or H_END if the pair does not fuse
+HandlerId fuse(const Instruction& first, const Instruction& second, ThreadedOp& op) {
+    const uint32_t reg = first.getRd();
+    if (reg == 0 || second.getRs1() != reg) {
+        return H_END;
+    }
+    const int64_t imm = second.getImmediate();
+    switch (isa::getOpInfo(first.getOpcodeId()).fusion) {
+        case isa::Fusion::UPPER:
+            // li of a 32-bit constant
+            if (second.getRd() != reg) {
+                return H_END;
+            }
+            if (second.getOpcodeId() == OP_ADDI) {
+                op.imm += imm;
+                return H_CONST;
+            }
+            if (second.getOpcodeId() == OP_ADDIW) {
+                op.imm = static_cast<int64_t>(sext32(static_cast<uint64_t>(op.imm + imm)));
+                return H_CONST;
+            }
+            return H_END;
+        case isa::Fusion::PC_UPPER: {
+            // op.imm holds the auipc result
+            const uint64_t base = static_cast<uint64_t>(op.imm);
+            op.rd2 = static_cast<uint8_t>(second.getRd());
+            switch (second.getOpcodeId()) {
+                case OP_ADDI:
+                    // la
+                    if (op.rd2 != reg) {
+                        return H_END;
+                    }
+                    op.imm += imm;
+                    return H_CONST;
+                case OP_JALR:
+                    // call and tail
+                    op.target = (base + imm) & ~1ull;
+                    return H_AUIPC_JALR;
+                case OP_LD:
+                case OP_LW:
+                    // Global loads
+                    if (op.rd2 == 0) {
+                        return H_END;
+                    }
+                    op.target = base + imm;
+                    return second.getOpcodeId() == OP_LD ? H_AUIPC_LD : H_AUIPC_LW;
+                default:
+                    return H_END;
+            }
+        }
+        case isa::Fusion::COMPARE: {
+            const Opcode branch = second.getOpcodeId();
+            if ((branch != OP_BEQ && branch != OP_BNE) || second.getRs2() != 0) {
+                return H_END;
+            }
+            op.taken_if_set = branch == OP_BNE;
+            op.target = op.pc + first.getSize() + imm;
+            switch (first.getOpcodeId()) {
+                case OP_SLT: return H_SLT_BRANCH;
+                case OP_SLTU: return H_SLTU_BRANCH;
+                case OP_SLTI: return H_SLTI_BRANCH;
+                default: return H_SLTIU_BRANCH;
+            }
+        }
+        case isa::Fusion::NONE:
+            break;
+    }
+    return H_END;
+}
+
+// Handler for a single instruction, filling in op
+HandlerId single(const Instruction& inst, ThreadedOp& op) {
+    const Opcode id = inst.getOpcodeId();
+    switch (id) {
+        case OP_LUI: case OP_AUIPC: return op.rd ? H_CONST : H_NOP;
+        case OP_JAL: op.target = op.pc + op.imm; return H_JAL;
+        case OP_JALR: return H_JALR;
+        case OP_BEQ: op.target = op.pc + op.imm; return H_BEQ;
+        case OP_BNE: op.target = op.pc + op.imm; return H_BNE;
+        case OP_BLT: op.target = op.pc + op.imm; return H_BLT;
+        case OP_BGE: op.target = op.pc + op.imm; return H_BGE;
+        case OP_BLTU: op.target = op.pc + op.imm; return H_BLTU;
+        case OP_BGEU: op.target = op.pc + op.imm; return H_BGEU;
+        case OP_SB: return H_SB;
+        case OP_SH: return H_SH;
+        case OP_SW: return H_SW;
+        case OP_SD: return H_SD;
+        default: break;
+    }
+
+    HandlerId handler;
+    switch (id) {
+        case OP_LB: handler = H_LB; break;
+        case OP_LH: handler = H_LH; break;
+        case OP_LW: handler = H_LW; break;
+        case OP_LD: handler = H_LD; break;
+        case OP_LBU: handler = H_LBU; break;
+        case OP_LHU: handler = H_LHU; break;
+        case OP_LWU: handler = H_LWU; break;
+        case OP_ADDI: handler = H_ADDI; break;
+        case OP_SLTI: handler = H_SLTI; break;
+        case OP_SLTIU: handler = H_SLTIU; break;
+        case OP_XORI: handler = H_XORI; break;
+        case OP_ORI: handler = H_ORI; break;
+        case OP_ANDI: handler = H_ANDI; break;
+        case OP_SLLI: handler = H_SLLI; break;
+        case OP_SRLI: handler = H_SRLI; break;
+        case OP_SRAI: handler = H_SRAI; break;
+        case OP_ADD: handler = H_ADD; break;
+        case OP_SUB: handler = H_SUB; break;
+        case OP_SLL: handler = H_SLL; break;
+        case OP_SLT: handler = H_SLT; break;
+        case OP_SLTU: handler = H_SLTU; break;
+        case OP_XOR: handler = H_XOR; break;
+        case OP_SRL: handler = H_SRL; break;
+        case OP_SRA: handler = H_SRA; break;
+        case OP_OR: handler = H_OR; break;
+        case OP_AND: handler = H_AND; break;
+        case OP_ADDIW: handler = H_ADDIW; break;
+        case OP_SLLIW: handler = H_SLLIW; break;
+        case OP_SRLIW: handler = H_SRLIW; break;
+        case OP_SRAIW: handler = H_SRAIW; break;
+        case OP_ADDW: handler = H_ADDW; break;
+        case OP_SUBW: handler = H_SUBW; break;
+        case OP_MUL: handler = H_MUL; break;
+        default: return H_GENERIC;
+    }
+
+    // Loads into x0 still access memory and may fault; arithmetic into x0
+    // does nothing, e.g. hints and region markers
+    if (op.rd == 0) {
+        return isa::getOpInfo(id).mem_kind == isa::MemKind::LOAD ? H_GENERIC : H_NOP;
+    }
+    return handler;
+}
+
+} // namespace
+
+const void* const* Interpreter::handlers_ = nullptr;
+
+void Interpreter::lower(const std::vector<Instruction>& instructions, uint64_t pc,
+                        std::vector<ThreadedOp>& ops) {
+    // Handler addresses only exist inside run(); fetch them once
+    static const bool linked = (run(nullptr), true);
+    (void)linked;
+
+    ops.clear();
+    ops.reserve(instructions.size() + 1);
+    uint32_t retired = 0;
+    for (size_t i = 0; i < instructions.size(); ++i) {
+        const Instruction& inst = instructions[i];
+        ThreadedOp op{};
+        op.inst = &inst;
+        op.pc = pc;
+        op.imm = inst.getOpcodeId() == OP_AUIPC ? static_cast<int64_t>(pc + inst.getImmediate())
+                                                : inst.getImmediate();
+        op.retired = retired;
+        op.size = static_cast<uint8_t>(inst.getSize());
+        op.rd = static_cast<uint8_t>(inst.getRd());
+        op.rs1 = static_cast<uint8_t>(inst.getRs1());
+        op.rs2 = static_cast<uint8_t>(inst.getRs2());
+
+        HandlerId id = H_END;
+        if (i + 1 < instructions.size()) {
+            id = fuse(inst, instructions[i + 1], op);
+        }
+        if (id != H_END) {
+            ++i;
+            op.size = static_cast<uint8_t>(op.size + instructions[i].getSize());
+            retired += 2;
+        } else {
+            id = single(inst, op);
+            retired += 1;
+        }
+        op.handler = handlers_[id];
+        pc += op.size;
+        ops.push_back(op);
+    }
+
+    // Falling off the end leaves the pc just past the block
+    ThreadedOp end{};
+    end.handler = handlers_[H_END];
+    end.pc = pc;
+    end.retired = retired;
+    ops.push_back(end);
+}
+
+StepResult Interpreter::run(const ThreadedOp* ops) {
+    static const void* const HANDLERS[NUM_HANDLERS] = {
+#define RVPIN_HANDLER_LABEL(name) &&L_##name,
+        RVPIN_THREADED_HANDLERS(RVPIN_HANDLER_LABEL)
+#undef RVPIN_HANDLER_LABEL
+    };
+    if (!ops) {
+        handlers_ = HANDLERS;
+        return StepResult::CONTINUE;
+    }
+
+#define NEXT() do { ++op; goto *const_cast<void*>(op->handler); } while (0)
+#define ALU(name, expr) L_##name: x[op->rd] = (expr); NEXT();
+#define LOAD(name, type) \
+    L_##name: x[op->rd] = static_cast<uint64_t>(static_cast<int64_t>( \
+        memory_.load<type>(x[op->rs1] + op->imm))); NEXT();
+#define STORE(name, type) \
+    L_##name: memory_.store<type>(x[op->rs1] + op->imm, static_cast<type>(x[op->rs2])); NEXT();
+#define FINISH() do { ++op; goto finish; } while (0)
+#define BRANCH(name, cond) \
+    L_##name: s.pc = (cond) ? op->target : op->pc + op->size; FINISH();
+#define COMPARE_BRANCH(name, flag) \
+    L_##name: { \
+        const uint64_t set = (flag); \
+        x[op->rd] = set; \
+        s.pc = (set != 0) == op->taken_if_set ? op->target : op->pc + op->size; \
+        FINISH(); \
+    }
+
+    CpuState& s = state_;
+    uint64_t* const x = s.x;
+    const uint64_t base = s.instret;
+    const ThreadedOp* op = ops;
+    StepResult result = StepResult::CONTINUE;
+    bool synced = false;     // pc and instret already describe the faulting point
+
+    try {
+        goto *const_cast<void*>(op->handler);
+
+    L_END:
+        s.pc = op->pc;
+        goto finish;
+
+    L_GENERIC:
+        s.pc = op->pc;
+        s.instret = base + op->retired;
+        result = step(*op->inst);
+        NEXT();
+
+    L_NOP:
+        NEXT();
+
+    L_CONST:
+        x[op->rd] = static_cast<uint64_t>(op->imm);
+        NEXT();
+
+        ALU(ADDI, x[op->rs1] + op->imm)
+        ALU(SLTI, static_cast<int64_t>(x[op->rs1]) < op->imm)
+        ALU(SLTIU, x[op->rs1] < static_cast<uint64_t>(op->imm))
+        ALU(XORI, x[op->rs1] ^ op->imm)
+        ALU(ORI, x[op->rs1] | op->imm)
+        ALU(ANDI, x[op->rs1] & op->imm)
+        ALU(SLLI, x[op->rs1] << (op->imm & 0x3F))
+        ALU(SRLI, x[op->rs1] >> (op->imm & 0x3F))
+        ALU(SRAI, static_cast<int64_t>(x[op->rs1]) >> (op->imm & 0x3F))
+        ALU(ADD, x[op->rs1] + x[op->rs2])
+        ALU(SUB, x[op->rs1] - x[op->rs2])
+        ALU(SLL, x[op->rs1] << (x[op->rs2] & 0x3F))
+        ALU(SLT, static_cast<int64_t>(x[op->rs1]) < static_cast<int64_t>(x[op->rs2]))
+        ALU(SLTU, x[op->rs1] < x[op->rs2])
+        ALU(XOR, x[op->rs1] ^ x[op->rs2])
+        ALU(SRL, x[op->rs1] >> (x[op->rs2] & 0x3F))
+        ALU(SRA, static_cast<int64_t>(x[op->rs1]) >> (x[op->rs2] & 0x3F))
+        ALU(OR, x[op->rs1] | x[op->rs2])
+        ALU(AND, x[op->rs1] & x[op->rs2])
+        ALU(ADDIW, sext32(x[op->rs1] + op->imm))
+        ALU(SLLIW, sext32(static_cast<uint32_t>(x[op->rs1]) << (op->imm & 0x1F)))
+        ALU(SRLIW, sext32(static_cast<uint32_t>(x[op->rs1]) >> (op->imm & 0x1F)))
+        ALU(SRAIW, sext32(static_cast<int32_t>(x[op->rs1]) >> (op->imm & 0x1F)))
+        ALU(ADDW, sext32(x[op->rs1] + x[op->rs2]))
+        ALU(SUBW, sext32(x[op->rs1] - x[op->rs2]))
+        ALU(MUL, x[op->rs1] * x[op->rs2])
+
+        LOAD(LB, int8_t)
+        LOAD(LH, int16_t)
+        LOAD(LW, int32_t)
+        LOAD(LD, uint64_t)
+        LOAD(LBU, uint8_t)
+        LOAD(LHU, uint16_t)
+        LOAD(LWU, uint32_t)
+        STORE(SB, uint8_t)
+        STORE(SH, uint16_t)
+        STORE(SW, uint32_t)
+        STORE(SD, uint64_t)
+
+    L_JAL:
+        x[op->rd] = op->pc + op->size;
+        x[0] = 0;
+        s.pc = op->target;
+        FINISH();
+
+    L_JALR: {
+        const uint64_t target = (x[op->rs1] + op->imm) & ~1ull;
+        x[op->rd] = op->pc + op->size;
+        x[0] = 0;
+        s.pc = target;
+        FINISH();
+    }
+
+        BRANCH(BEQ, x[op->rs1] == x[op->rs2])
+        BRANCH(BNE, x[op->rs1] != x[op->rs2])
+        BRANCH(BLT, static_cast<int64_t>(x[op->rs1]) < static_cast<int64_t>(x[op->rs2]))
+        BRANCH(BGE, static_cast<int64_t>(x[op->rs1]) >= static_cast<int64_t>(x[op->rs2]))
+        BRANCH(BLTU, x[op->rs1] < x[op->rs2])
+        BRANCH(BGEU, x[op->rs1] >= x[op->rs2])
+
+    L_AUIPC_JALR:
+        x[op->rd] = static_cast<uint64_t>(op->imm);
+        x[op->rd2] = op->pc + op->size;
+        x[0] = 0;
+        s.pc = op->target;
+        FINISH();
+
+    // The auipc has retired if the load faults
+    L_AUIPC_LD:
+        x[op->rd] = static_cast<uint64_t>(op->imm);
+        s.pc = op->pc + 4;
+        s.instret = base + op->retired + 1;
+        synced = true;
+        x[op->rd2] = memory_.load<uint64_t>(op->target);
+        synced = false;
+        NEXT();
+
+    L_AUIPC_LW:
+        x[op->rd] = static_cast<uint64_t>(op->imm);
+        s.pc = op->pc + 4;
+        s.instret = base + op->retired + 1;
+        synced = true;
+        x[op->rd2] = sext32(memory_.load<uint32_t>(op->target));
+        synced = false;
+        NEXT();
+
+        COMPARE_BRANCH(SLT_BRANCH,
+                       static_cast<int64_t>(x[op->rs1]) < static_cast<int64_t>(x[op->rs2]))
+        COMPARE_BRANCH(SLTU_BRANCH, x[op->rs1] < x[op->rs2])
+        COMPARE_BRANCH(SLTI_BRANCH, static_cast<int64_t>(x[op->rs1]) < op->imm)
+        COMPARE_BRANCH(SLTIU_BRANCH, x[op->rs1] < static_cast<uint64_t>(op->imm))
+    } catch (...) {
+        if (!synced) {
+            s.pc = op->pc;
+            s.instret = base + op->retired;
+        }
+        throw;
+    }
+
+finish:
+    // op is the end op, which counts the whole block; control transfers
+    // come last in theirs and step onto it
+    s.instret = base + op->retired;
+    return result;
+
+#undef NEXT
+#undef ALU
+#undef LOAD
+#undef STORE
+#undef FINISH
+#undef BRANCH
+#undef COMPARE_BRANCH
+}
+
+uint64_t Interpreter::readCsr(uint32_t csr, const Instruction& inst) const {
+    switch (csr) {
+        case CSR_FFLAGS: return state_.fcsr & 0x1F;
+        case CSR_FRM: return (state_.fcsr >> 5) & 0x7;
+        case CSR_FCSR: return state_.fcsr & 0xFF;
+        // No timing model: cycles and time both advance with instret
+        case CSR_CYCLE: case CSR_TIME: case CSR_INSTRET: return state_.instret;
+        default: throw IllegalInstruction(state_.pc, inst.getRawInstruction());
+    }
+}
+
+void Interpreter::writeCsr(uint32_t csr, uint64_t value, const Instruction& inst) {
+    switch (csr) {
+        case CSR_FFLAGS: state_.fcsr = (state_.fcsr & ~0x1Fu) | (value & 0x1F); break;
+        case CSR_FRM: state_.fcsr = (state_.fcsr & 0x1F) | ((value & 0x7) << 5); break;
+        case CSR_FCSR: state_.fcsr = value & 0xFF; break;
+        default: throw IllegalInstruction(state_.pc, inst.getRawInstruction());
+    }
+}
+
+} // namespace rvpin
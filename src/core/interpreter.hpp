@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#include "instruction.hpp"
+#include "memory.hpp"
+
+namespace rvpin {
+
+// Architectural state of one RV64 hart
+struct CpuState {
+    uint64_t x[32]{};           // Integer registers, x[0] is kept at 0
+    uint64_t f[32]{};           // FP registers, singles are NaN-boxed
+    uint64_t pc{0};
+    uint32_t fcsr{0};           // frm in [7:5], fflags in [4:0]
+    uint64_t instret{0};        // Retired instructions
+    uint64_t reservation{~0ull};  // LR/SC reservation address
+    uint32_t hart_id{0};        // mhartid
+};
+
+// Raised for encodings the interpreter cannot execute
+class IllegalInstruction : public std::runtime_error {
+public:
+    IllegalInstruction(uint64_t pc, uint32_t raw_inst)
+        : std::runtime_error("illegal instruction"), pc_(pc), raw_inst_(raw_inst) {}
+
+    uint64_t getPc() const { return pc_; }
+    uint32_t getRawInstruction() const { return raw_inst_; }
+
+private:
+    uint64_t pc_;
+    uint32_t raw_inst_;
+};
+
+// What the caller has to do after an instruction retires
+enum class StepResult : uint8_t {
+    CONTINUE,
+    SYSCALL,        // ecall; arguments are in a0-a7
+    BREAKPOINT,     // ebreak
+    FENCE_I         // Cached translations may be stale
+};
+
+// One step of a block lowered for direct-threaded dispatch: a single
+// instruction, or a fused pair of them, with its operands pulled out and
+// the address of the code that runs it
+struct ThreadedOp {
+    const void* handler;
+    const Instruction* inst;    // First instruction covered, for the generic handler
+    uint64_t pc;
+    int64_t imm;                // Immediate, or a value known once lowered
+    uint64_t target;            // Branch or jump target, fused load address
+    uint32_t retired;           // Instructions of the block before this one
+    uint8_t size;               // Bytes covered
+    uint8_t rd;
+    uint8_t rs1;
+    uint8_t rs2;
+    uint8_t rd2;                // Destination of a fused pair's second instruction
+    bool taken_if_set;          // Fused compare and branch: bnez rather than beqz
+};
+
+class Interpreter {
+public:
+    Interpreter(CpuState& state, Memory& memory) : state_(state), memory_(memory) {}
+
+    // Execute inst, which must be the instruction at state.pc, and advance
+    // the pc. Faulting instructions throw and leave the state untouched.
+    StepResult step(const Instruction& inst);
+
+    // Lower the block of instructions starting at pc for run(). Common
+    // pairs become superinstructions: lui+addi(w), auipc+addi/jalr/ld/lw
+    // and slt(i)(u)+beqz/bnez. ops refers to instructions, which must
+    // not move while it is in use.
+    void lower(const std::vector<Instruction>& instructions, uint64_t pc,
+               std::vector<ThreadedOp>& ops);
+
+    // Run a lowered block from its first instruction, which must be the
+    // one at state.pc, jumping from handler to handler with no decode or
+    // switch in between. Ends as stepping through the block would, with
+    // the last instruction's result; a fault leaves the pc and instret on
+    // the faulting instruction.
+    StepResult run(const ThreadedOp* ops);
+
+private:
+    uint64_t readCsr(uint32_t csr, const Instruction& inst) const;
+    void writeCsr(uint32_t csr, uint64_t value, const Instruction& inst);
+
+    CpuState& state_;
+    Memory& memory_;
+
+    // Handler addresses by handler id, filled in by the first run()
+    static const void* const* handlers_;
+};
+
+} // namespace rvpin
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include "encoding.hpp"
+
+namespace rvpin {
+namespace isa {
+
+enum class MemKind : uint8_t {
+    NONE,
+    LOAD,
+    STORE,
+    AMO     // Read-modify-write
+};
+
+// Instructions the threaded interpreter can fuse with the one after them
+// into a superinstruction, and what they fuse with
+enum class Fusion : uint8_t {
+    NONE,
+    UPPER,          // lui: + addi/addiw on the same register, a constant
+    PC_UPPER,       // auipc: + addi, jalr, ld or lw through the same register
+    COMPARE         // slt(i)(u): + beqz/bnez on the result
+};
+
+// Static properties of an opcode id, used when building blocks and when
+// reporting memory accesses
+struct OpInfo {
+    uint8_t mem_size;       // Bytes accessed, 0 if none
+    MemKind mem_kind;
+    bool ends_block;        // Control transfer, trap or fence.i
+    Fusion fusion{Fusion::NONE};
+};
+
+namespace detail {
+
+using namespace encoding;
+
+constexpr OpInfo makeOpInfo(Opcode op) {
+    switch (op) {
+        case OP_LB: case OP_LBU:
+            return {1, MemKind::LOAD, false};
+        case OP_LH: case OP_LHU:
+            return {2, MemKind::LOAD, false};
+        case OP_LW: case OP_LWU: case OP_FLW:
+            return {4, MemKind::LOAD, false};
+        case OP_LD: case OP_FLD:
+            return {8, MemKind::LOAD, false};
+        case OP_SB:
+            return {1, MemKind::STORE, false};
+        case OP_SH:
+            return {2, MemKind::STORE, false};
+        case OP_SW: case OP_FSW:
+            return {4, MemKind::STORE, false};
+        case OP_SD: case OP_FSD:
+            return {8, MemKind::STORE, false};
+        case OP_LR_W:
+            return {4, MemKind::LOAD, false};
+        case OP_LR_D:
+            return {8, MemKind::LOAD, false};
+        case OP_SC_W:
+            return {4, MemKind::STORE, false};
+        case OP_SC_D:
+            return {8, MemKind::STORE, false};
+        case OP_AMOADD_W: case OP_AMOXOR_W:
+        case OP_AMOOR_W: case OP_AMOAND_W: case OP_AMOMIN_W: case OP_AMOMAX_W:
+        case OP_AMOMINU_W: case OP_AMOMAXU_W: case OP_AMOSWAP_W:
+            return {4, MemKind::AMO, false};
+        case OP_AMOADD_D: case OP_AMOXOR_D:
+        case OP_AMOOR_D: case OP_AMOAND_D: case OP_AMOMIN_D: case OP_AMOMAX_D:
+        case OP_AMOMINU_D: case OP_AMOMAXU_D: case OP_AMOSWAP_D:
+            return {8, MemKind::AMO, false};
+        case OP_JAL: case OP_JALR: case OP_BEQ: case OP_BNE: case OP_BLT:
+        case OP_BGE: case OP_BLTU: case OP_BGEU: case OP_ECALL: case OP_EBREAK:
+        case OP_FENCE_I: case OP_UNKNOWN:
+        // Pseudo-instructions, never produced by the decoder
+        case OP_SCALL: case OP_SBREAK: case OP_RET: case OP_BLEU: case OP_BGTU:
+        case OP_BLE: case OP_BGEZ: case OP_BLEZ: case OP_BGT: case OP_BGTZ:
+        case OP_BLTZ: case OP_BNEZ: case OP_BEQZ: case OP_JALR_PSEUDO: case OP_JR:
+        case OP_JAL_PSEUDO: case OP_J:
+            return {0, MemKind::NONE, true};
+        default:
+            return {0, MemKind::NONE, false};
+    }
+}
+
+constexpr Fusion makeFusion(Opcode op) {
+    switch (op) {
+        case OP_LUI: return Fusion::UPPER;
+        case OP_AUIPC: return Fusion::PC_UPPER;
+        case OP_SLT: case OP_SLTU: case OP_SLTI: case OP_SLTIU: return Fusion::COMPARE;
+        default: return Fusion::NONE;
+    }
+}
+
+constexpr std::array<OpInfo, NUM_ENCODINGS + 1> makeOpInfoTable() {
+    std::array<OpInfo, NUM_ENCODINGS + 1> table{};
+    for (size_t i = 0; i <= NUM_ENCODINGS; ++i) {
+        table[i] = makeOpInfo(static_cast<Opcode>(i));
+        table[i].fusion = makeFusion(static_cast<Opcode>(i));
+    }
+    return table;
+}
+
+} // namespace detail
+
+constexpr std::array<OpInfo, encoding::NUM_ENCODINGS + 1> OP_INFO = detail::makeOpInfoTable();
+
+constexpr const OpInfo& getOpInfo(encoding::Opcode op) {
+    return OP_INFO[op];
+}
+
+} // namespace isa
+} // namespace rvpin
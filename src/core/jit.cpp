@@ -0,0 +1,816 @@
+#include "jit.hpp"
+#include "isa.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <sys/mman.h>
+
+namespace rvpin {
+
+#if defined(__x86_64__)
+
+namespace {
+
+using namespace encoding;
+
+// Host registers by encoding. rbx holds the CpuState and r12 the
+// JitContext for the whole block; rax, rcx, rdx, rsi and rdi are scratch.
+enum Reg : uint8_t { RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+                     R12 = 12 };
+
+// Condition codes of jcc, setcc and cmovcc
+enum Cond : uint8_t { CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_A = 0x7, CC_L = 0xC,
+                      CC_GE = 0xD };
+
+// The frame holds the argument array of the analysis call being made and
+// the effective address captured for the instruction's calls
+constexpr int32_t ARGS_SLOT = 0;
+constexpr int32_t EA_SLOT = 48;
+constexpr uint8_t FRAME_SIZE = 64;
+
+constexpr int32_t PC_OFFSET = offsetof(CpuState, pc);
+constexpr int32_t INSTRET_OFFSET = offsetof(CpuState, instret);
+constexpr int32_t HART_ID_OFFSET = offsetof(CpuState, hart_id);
+constexpr int32_t CURRENT_INSTRUCTION_OFFSET = offsetof(JitContext, current_instruction);
+constexpr int32_t FAULT_INDEX_OFFSET = offsetof(JitContext, fault_index);
+constexpr int32_t FAULT_OFFSET = offsetof(JitContext, fault);
+constexpr int32_t INSTRET_LIMIT_OFFSET = offsetof(JitContext, instret_limit);
+
+static_assert(sizeof(Memory::TlbEntry) == 16 && offsetof(Memory::TlbEntry, host) == 8,
+              "Inlined TLB lookups index entries of two words");
+
+constexpr int32_t regOffset(uint32_t reg) {
+    return static_cast<int32_t>(reg * sizeof(uint64_t));
+}
+
+constexpr bool fitsInt32(int64_t value) {
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+// TLB misses and accesses that cross a page go through Memory, which
+// throws on faults. Exceptions must not unwind through generated code, so
+// they are caught here and the block exits for the interpreter to raise
+// the fault again.
+template <typename T>
+uint64_t loadHelper(JitContext* context, uint64_t addr) noexcept {
+    try {
+        // Sign- or zero-extends by T
+        return static_cast<uint64_t>(static_cast<int64_t>(context->memory->load<T>(addr)));
+    } catch (...) {
+        context->fault = true;
+        return 0;
+    }
+}
+
+template <typename T>
+void storeHelper(JitContext* context, uint64_t addr, uint64_t value) noexcept {
+    try {
+        context->memory->store<T>(addr, static_cast<T>(value));
+    } catch (...) {
+        context->fault = true;
+    }
+}
+
+// Non-zero when the routine threw; the exception is kept for the engine
+int callAnalysis(JitContext* context, const api::AnalysisCall* call,
+                 const uint64_t* args) noexcept {
+    try {
+        call->routine(call->context, args);
+        return 0;
+    } catch (...) {
+        context->exception = std::current_exception();
+        return 1;
+    }
+}
+
+using LoadHelper = uint64_t (*)(JitContext*, uint64_t) noexcept;
+using StoreHelper = void (*)(JitContext*, uint64_t, uint64_t) noexcept;
+
+LoadHelper getLoadHelper(Opcode id) {
+    switch (id) {
+        case OP_LB: return &loadHelper<int8_t>;
+        case OP_LH: return &loadHelper<int16_t>;
+        case OP_LW: return &loadHelper<int32_t>;
+        case OP_LD: return &loadHelper<uint64_t>;
+        case OP_LBU: return &loadHelper<uint8_t>;
+        case OP_LHU: return &loadHelper<uint16_t>;
+        case OP_LWU: return &loadHelper<uint32_t>;
+        default: return nullptr;
+    }
+}
+
+StoreHelper getStoreHelper(Opcode id) {
+    switch (id) {
+        case OP_SB: return &storeHelper<uint8_t>;
+        case OP_SH: return &storeHelper<uint16_t>;
+        case OP_SW: return &storeHelper<uint32_t>;
+        case OP_SD: return &storeHelper<uint64_t>;
+        default: return nullptr;
+    }
+}
+
+// Integer ALU instructions: rax = rax op rcx, where rcx is rs2 or the
+// immediate
+struct AluOp {
+    enum Kind { ARITH, SHIFT, COMPARE, MULTIPLY } kind;
+    uint8_t code;       // ARITH opcode, SHIFT /digit or COMPARE condition
+    bool wide;          // 64-bit; 32-bit results are sign-extended
+    bool immediate;
+};
+
+bool getAluOp(Opcode id, AluOp& op) {
+    using K = AluOp::Kind;
+    switch (id) {
+        case OP_ADDI: op = {K::ARITH, 0x01, true, true}; return true;
+        case OP_SLTI: op = {K::COMPARE, CC_L, true, true}; return true;
+        case OP_SLTIU: op = {K::COMPARE, CC_B, true, true}; return true;
+        case OP_XORI: op = {K::ARITH, 0x31, true, true}; return true;
+        case OP_ORI: op = {K::ARITH, 0x09, true, true}; return true;
+        case OP_ANDI: op = {K::ARITH, 0x21, true, true}; return true;
+        case OP_SLLI: op = {K::SHIFT, 4, true, true}; return true;
+        case OP_SRLI: op = {K::SHIFT, 5, true, true}; return true;
+        case OP_SRAI: op = {K::SHIFT, 7, true, true}; return true;
+        case OP_ADD: op = {K::ARITH, 0x01, true, false}; return true;
+        case OP_SUB: op = {K::ARITH, 0x29, true, false}; return true;
+        case OP_SLL: op = {K::SHIFT, 4, true, false}; return true;
+        case OP_SLT: op = {K::COMPARE, CC_L, true, false}; return true;
+        case OP_SLTU: op = {K::COMPARE, CC_B, true, false}; return true;
+        case OP_XOR: op = {K::ARITH, 0x31, true, false}; return true;
+        case OP_SRL: op = {K::SHIFT, 5, true, false}; return true;
+        case OP_SRA: op = {K::SHIFT, 7, true, false}; return true;
+        case OP_OR: op = {K::ARITH, 0x09, true, false}; return true;
+        case OP_AND: op = {K::ARITH, 0x21, true, false}; return true;
+        case OP_ADDIW: op = {K::ARITH, 0x01, false, true}; return true;
+        case OP_SLLIW: op = {K::SHIFT, 4, false, true}; return true;
+        case OP_SRLIW: op = {K::SHIFT, 5, false, true}; return true;
+        case OP_SRAIW: op = {K::SHIFT, 7, false, true}; return true;
+        case OP_ADDW: op = {K::ARITH, 0x01, false, false}; return true;
+        case OP_SUBW: op = {K::ARITH, 0x29, false, false}; return true;
+        case OP_SLLW: op = {K::SHIFT, 4, false, false}; return true;
+        case OP_SRLW: op = {K::SHIFT, 5, false, false}; return true;
+        case OP_SRAW: op = {K::SHIFT, 7, false, false}; return true;
+        case OP_MUL: op = {K::MULTIPLY, 0, true, false}; return true;
+        case OP_MULW: op = {K::MULTIPLY, 0, false, false}; return true;
+        default: return false;
+    }
+}
+
+bool getBranchCondition(Opcode id, Cond& cond) {
+    switch (id) {
+        case OP_BEQ: cond = CC_E; return true;
+        case OP_BNE: cond = CC_NE; return true;
+        case OP_BLT: cond = CC_L; return true;
+        case OP_BGE: cond = CC_GE; return true;
+        case OP_BLTU: cond = CC_B; return true;
+        case OP_BGEU: cond = CC_AE; return true;
+        default: return false;
+    }
+}
+
+// Encodes the handful of x86-64 instructions the compiler uses
+class Emitter {
+public:
+    const std::vector<uint8_t>& getCode() const { return code_; }
+    size_t getPosition() const { return code_.size(); }
+
+    void prologue() {
+        byte(0x55);                             // push rbp
+        rr(true, {0x89}, RSP, RBP);             // mov rbp, rsp
+        byte(0x53);                             // push rbx
+        bytes({0x41, 0x54});                    // push r12
+        rr(true, {0x83}, 5, RSP);               // sub rsp, FRAME_SIZE
+        byte(FRAME_SIZE);
+        rr(true, {0x89}, RDI, RBX);             // mov rbx, rdi
+        rr(true, {0x89}, RSI, R12);             // mov r12, rsi
+    }
+
+    void exit(JitExit code) {
+        byte(0xB8);                             // mov eax, code
+        u32(static_cast<uint32_t>(code));
+        rr(true, {0x83}, 0, RSP);               // add rsp, FRAME_SIZE
+        byte(FRAME_SIZE);
+        bytes({0x41, 0x5C});                    // pop r12
+        byte(0x5B);                             // pop rbx
+        byte(0x5D);                             // pop rbp
+        byte(0xC3);                             // ret
+    }
+
+    void movImm(Reg reg, uint64_t value) {
+        if (value <= UINT32_MAX) {
+            rex(false, 0, reg);
+            byte(0xB8 + (reg & 7));             // mov r32, imm32
+            u32(static_cast<uint32_t>(value));
+        } else if (fitsInt32(static_cast<int64_t>(value))) {
+            rr(true, {0xC7}, 0, reg);           // mov r64, simm32
+            u32(static_cast<uint32_t>(value));
+        } else {
+            rex(true, 0, reg);
+            byte(0xB8 + (reg & 7));             // mov r64, imm64
+            u64(value);
+        }
+    }
+
+    void mov(Reg dst, Reg src) { rr(true, {0x89}, src, dst); }
+
+    void loadGuest(Reg reg, uint32_t guest) {
+        if (guest == 0) {
+            rr(false, {0x31}, reg, reg);        // xor r32, r32
+        } else {
+            mem(true, {0x8B}, reg, RBX, regOffset(guest));
+        }
+    }
+
+    void storeGuest(uint32_t guest, Reg reg) {
+        if (guest != 0) {
+            mem(true, {0x89}, reg, RBX, regOffset(guest));
+        }
+    }
+
+    void storePc(Reg reg) { mem(true, {0x89}, reg, RBX, PC_OFFSET); }
+
+    void setPc(uint64_t pc) {
+        movImm(RDX, pc);
+        storePc(RDX);
+    }
+
+    void addInstret(uint32_t count) {
+        if (count != 0) {
+            mem(true, {0x81}, 0, RBX, INSTRET_OFFSET);
+            u32(count);
+        }
+    }
+
+    void loadPc(Reg reg) { mem(true, {0x8B}, reg, RBX, PC_OFFSET); }
+    void loadInstret(Reg reg) { mem(true, {0x8B}, reg, RBX, INSTRET_OFFSET); }
+
+    // cmp reg, [r12 + instret_limit]
+    void compareInstretLimit(Reg reg) { mem(true, {0x3B}, reg, R12, INSTRET_LIMIT_OFFSET); }
+
+    void loadHartId(Reg reg) { mem(false, {0x8B}, reg, RBX, HART_ID_OFFSET); }
+
+    void addImm(Reg reg, int32_t imm) {
+        if (imm != 0) {
+            rr(true, {0x81}, 0, reg);
+            u32(static_cast<uint32_t>(imm));
+        }
+    }
+
+    // Clears bit 0, for jalr targets
+    void clearLowBit(Reg reg) {
+        rr(true, {0x83}, 4, reg);               // and r64, -2
+        byte(0xFE);
+    }
+
+    void alu(const AluOp& op) {
+        switch (op.kind) {
+            case AluOp::ARITH:
+                rr(op.wide, {op.code}, RCX, RAX);
+                break;
+            case AluOp::SHIFT:
+                rr(op.wide, {0xD3}, op.code, RAX);  // shl/shr/sar rax, cl
+                break;
+            case AluOp::COMPARE:
+                rr(true, {0x39}, RCX, RAX);         // cmp rax, rcx
+                rr(false, {0x0F, static_cast<uint8_t>(0x90 | op.code)}, 0, RAX);
+                rr(false, {0x0F, 0xB6}, RAX, RAX);  // movzx eax, al
+                break;
+            case AluOp::MULTIPLY:
+                rr(op.wide, {0x0F, 0xAF}, RAX, RCX);
+                break;
+        }
+        if (!op.wide) {
+            rr(true, {0x63}, RAX, RAX);             // movsxd rax, eax
+        }
+    }
+
+    void compare(Reg a, Reg b) { rr(true, {0x39}, b, a); }
+
+    void cmov(Cond cond, Reg dst, Reg src) {
+        rr(true, {0x0F, static_cast<uint8_t>(0x40 | cond)}, dst, src);
+    }
+
+    void call(const void* function) {
+        movImm(RAX, reinterpret_cast<uintptr_t>(function));
+        rr(false, {0xFF}, 2, RAX);              // call rax
+    }
+
+    // Leave the host page of the address in rsi in rdi and its offset in
+    // rcx, if the TLB has the page and the size bytes do not cross it.
+    // Otherwise take one of the jumps added to misses, to be patched.
+    void lookupTlb(const Memory::TlbEntry* tlb, uint32_t size, std::vector<size_t>& misses) {
+        rr(true, {0x89}, RSI, RCX);             // mov rcx, rsi
+        rr(true, {0xC1}, 5, RCX);               // shr rcx, PAGE_SHIFT
+        byte(Memory::PAGE_SHIFT);
+        rr(false, {0x89}, RCX, RDI);            // mov edi, ecx
+        rr(false, {0x81}, 4, RDI);              // and edi, TLB_ENTRIES - 1
+        u32(Memory::TLB_ENTRIES - 1);
+        rr(false, {0xC1}, 4, RDI);              // shl edi, 4
+        byte(4);
+        movImm(RAX, reinterpret_cast<uintptr_t>(tlb));
+        rr(true, {0x01}, RAX, RDI);             // add rdi, rax
+        mem(true, {0x39}, RCX, RDI, 0);         // cmp [rdi], rcx
+        misses.push_back(jcc(CC_NE));
+        rr(false, {0x89}, RSI, RCX);            // mov ecx, esi
+        rr(false, {0x81}, 4, RCX);              // and ecx, PAGE_SIZE - 1
+        u32(Memory::PAGE_SIZE - 1);
+        if (size > 1) {
+            rr(false, {0x81}, 7, RCX);          // cmp ecx, PAGE_SIZE - size
+            u32(static_cast<uint32_t>(Memory::PAGE_SIZE - size));
+            misses.push_back(jcc(CC_A));
+        }
+        mem(true, {0x8B}, RDI, RDI, 8);         // mov rdi, [rdi + 8]
+    }
+
+    // rax = the value at [rdi + rcx], extended as the load extends it
+    void loadHost(Opcode id) {
+        switch (id) {
+            case OP_LB: bytes({0x48, 0x0F, 0xBE}); break;   // movsx rax, byte
+            case OP_LBU: bytes({0x0F, 0xB6}); break;        // movzx eax, byte
+            case OP_LH: bytes({0x48, 0x0F, 0xBF}); break;   // movsx rax, word
+            case OP_LHU: bytes({0x0F, 0xB7}); break;        // movzx eax, word
+            case OP_LW: bytes({0x48, 0x63}); break;         // movsxd rax, dword
+            case OP_LWU: byte(0x8B); break;                 // mov eax, dword
+            default: bytes({0x48, 0x8B}); break;            // mov rax, qword
+        }
+        bytes({0x04, 0x0F});                    // [rdi + rcx]
+    }
+
+    // [rdi + rcx] = the low size bytes of rdx
+    void storeHost(uint32_t size) {
+        switch (size) {
+            case 1: byte(0x88); break;
+            case 2: bytes({0x66, 0x89}); break;
+            case 4: byte(0x89); break;
+            default: bytes({0x48, 0x89}); break;
+        }
+        bytes({0x14, 0x0F});                    // [rdi + rcx], dl/dx/edx/rdx
+    }
+
+    // Jump back to target, already emitted
+    void jumpTo(size_t target) {
+        byte(0xE9);
+        u32(static_cast<uint32_t>(target - (code_.size() + 4)));
+    }
+
+    // Conditional jump to be patched
+    size_t jumpIf(Cond cond) { return jcc(cond); }
+
+    // Jump to be patched
+    size_t jump() {
+        byte(0xE9);
+        const size_t jump = code_.size();
+        u32(0);
+        return jump;
+    }
+
+    // Jump taken when the fault flag is set, to be patched
+    size_t jumpIfFault() {
+        mem(false, {0x80}, 7, R12, FAULT_OFFSET);   // cmp byte [r12 + fault], 0
+        byte(0);
+        return jcc(CC_NE);
+    }
+
+    // Jump taken when eax is non-zero, to be patched
+    size_t jumpIfSet() {
+        rr(false, {0x85}, RAX, RAX);            // test eax, eax
+        return jcc(CC_NE);
+    }
+
+    void patch(size_t jump, size_t target) {
+        const uint32_t rel = static_cast<uint32_t>(target - (jump + 4));
+        std::memcpy(&code_[jump], &rel, sizeof(rel));
+    }
+
+    void setFaultIndex(uint32_t index) {
+        mem(false, {0xC7}, 0, R12, FAULT_INDEX_OFFSET);
+        u32(index);
+    }
+
+    void setCurrentInstruction(const Instruction* inst) {
+        movImm(RAX, reinterpret_cast<uintptr_t>(inst));
+        mem(true, {0x8B}, RCX, R12, CURRENT_INSTRUCTION_OFFSET);
+        mem(true, {0x89}, RAX, RCX, 0);         // mov [rcx], rax
+    }
+
+    void storeSlot(int32_t slot, Reg reg) { mem(true, {0x89}, reg, RSP, slot); }
+    void loadSlot(Reg reg, int32_t slot) { mem(true, {0x8B}, reg, RSP, slot); }
+    void leaSlot(Reg reg, int32_t slot) { mem(true, {0x8D}, reg, RSP, slot); }
+
+private:
+    void byte(uint8_t value) { code_.push_back(value); }
+    void bytes(std::initializer_list<uint8_t> values) {
+        code_.insert(code_.end(), values);
+    }
+
+    void u32(uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            byte(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    void u64(uint64_t value) {
+        u32(static_cast<uint32_t>(value));
+        u32(static_cast<uint32_t>(value >> 32));
+    }
+
+    void rex(bool wide, uint8_t reg, uint8_t rm) {
+        const uint8_t prefix = 0x40 | (wide ? 0x08 : 0) | (reg >= 8 ? 0x04 : 0) |
+                               (rm >= 8 ? 0x01 : 0);
+        if (prefix != 0x40) {
+            byte(prefix);
+        }
+    }
+
+    // Register to register form
+    void rr(bool wide, std::initializer_list<uint8_t> opcode, uint8_t reg, uint8_t rm) {
+        rex(wide, reg, rm);
+        bytes(opcode);
+        byte(static_cast<uint8_t>(0xC0 | (reg & 7) << 3 | (rm & 7)));
+    }
+
+    // [base + disp] form
+    void mem(bool wide, std::initializer_list<uint8_t> opcode, uint8_t reg, Reg base,
+             int32_t disp) {
+        rex(wide, reg, base);
+        bytes(opcode);
+        const bool short_disp = disp >= INT8_MIN && disp <= INT8_MAX;
+        byte(static_cast<uint8_t>((short_disp ? 0x40 : 0x80) | (reg & 7) << 3 | (base & 7)));
+        if ((base & 7) == RSP) {
+            byte(0x24);                         // SIB: base only
+        }
+        if (short_disp) {
+            byte(static_cast<uint8_t>(disp));
+        } else {
+            u32(static_cast<uint32_t>(disp));
+        }
+    }
+
+    size_t jcc(Cond cond) {
+        bytes({0x0F, static_cast<uint8_t>(0x80 | cond)});
+        const size_t jump = code_.size();
+        u32(0);
+        return jump;
+    }
+
+    std::vector<uint8_t> code_;
+};
+
+// Compiles one block. Guest registers are loaded from and stored to the
+// CpuState around every instruction, so state is exact at each analysis
+// call and at each fault. The pc and instret are only brought up to date
+// where something may look at them.
+class BlockTranslator {
+public:
+    BlockTranslator(Memory& memory, const std::vector<Instruction>& instructions, uint64_t pc,
+                    const std::vector<api::AnalysisCall>& calls)
+        : memory_(memory), instructions_(instructions), start_pc_(pc), calls_(calls) {}
+
+    bool translate() {
+        e_.prologue();
+        const size_t body = e_.getPosition();
+        const api::AnalysisCall* call = calls_.data();
+        const api::AnalysisCall* end = call + calls_.size();
+        uint64_t pc = start_pc_;
+        bool pc_set = false;
+        JitExit exit = JitExit::CONTINUE;
+        for (uint32_t i = 0; i < instructions_.size(); i++) {
+            const Instruction& inst = instructions_[i];
+            const uint64_t next_pc = pc + inst.getSize();
+
+            // This instruction's calls: [call, after) before it and
+            // [after, last) after it
+            const api::AnalysisCall* after = call;
+            while (after != end && after->inst_index == i && after->point == api::IPoint::BEFORE) {
+                ++after;
+            }
+            const api::AnalysisCall* last = after;
+            while (last != end && last->inst_index == i) {
+                ++last;
+            }
+
+            if (call != last) {
+                // Capture the effective address before the instruction can
+                // overwrite its base register
+                if (std::any_of(call, last, usesEa)) {
+                    e_.loadGuest(RAX, inst.getRs1());
+                    e_.addImm(RAX, inst.getImmediate());
+                    e_.storeSlot(EA_SLOT, RAX);
+                }
+                e_.setCurrentInstruction(&inst);
+            }
+            if (call != after) {
+                e_.setPc(pc);
+                syncInstret(i);
+                emitCalls(call, after, inst, pc);
+            }
+
+            if (!emitInstruction(inst, i, pc, next_pc, exit)) {
+                return false;
+            }
+            pc_set = pc_set || isa::getOpInfo(inst.getOpcodeId()).ends_block;
+
+            if (after != last) {
+                if (!pc_set) {
+                    e_.setPc(next_pc);
+                }
+                syncInstret(i + 1);
+                emitCalls(after, last, inst, pc);
+            }
+            call = last;
+            pc = next_pc;
+        }
+        end_pc_ = pc;
+
+        if (!pc_set) {
+            e_.setPc(pc);
+        }
+        const uint32_t count = static_cast<uint32_t>(instructions_.size());
+        syncInstret(count);
+
+        // Loop back into the block while it branches to itself and fits
+        // under the limit, skipping a return to the engine each time
+        if (branchesToStart()) {
+            e_.loadPc(RDX);
+            e_.movImm(RAX, start_pc_);
+            e_.compare(RDX, RAX);
+            const size_t leave = e_.jumpIf(CC_NE);
+            e_.loadInstret(RAX);
+            e_.addImm(RAX, static_cast<int32_t>(count));
+            e_.compareInstretLimit(RAX);
+            const size_t full = e_.jumpIf(CC_A);
+            e_.jumpTo(body);
+            e_.patch(leave, e_.getPosition());
+            e_.patch(full, e_.getPosition());
+        }
+        e_.exit(exit);
+
+        for (const FaultSite& site : faults_) {
+            e_.patch(site.jump, e_.getPosition());
+            e_.setPc(site.pc);
+            e_.addInstret(site.index - site.synced);
+            e_.setFaultIndex(site.index);
+            e_.exit(JitExit::FAULT);
+        }
+        if (!exceptions_.empty()) {
+            const size_t stub = e_.getPosition();
+            for (size_t jump : exceptions_) {
+                e_.patch(jump, stub);
+            }
+            e_.exit(JitExit::EXCEPTION);
+        }
+        return true;
+    }
+
+    const std::vector<uint8_t>& getCode() const { return e_.getCode(); }
+
+private:
+    // Where a load or store bails out to on a fault
+    struct FaultSite {
+        size_t jump;
+        uint32_t index;
+        uint32_t synced;
+        uint64_t pc;
+    };
+
+    // The block ends in a branch or jal whose target is its first
+    // instruction
+    bool branchesToStart() const {
+        const Instruction& last = instructions_.back();
+        const Opcode id = last.getOpcodeId();
+        Cond cond;
+        if (id != OP_JAL && !getBranchCondition(id, cond)) {
+            return false;
+        }
+        return end_pc_ - last.getSize() + static_cast<int64_t>(last.getImmediate()) == start_pc_;
+    }
+
+    static bool usesEa(const api::AnalysisCall& call) {
+        return std::any_of(call.args, call.args + call.num_args, [](const api::IArg& arg) {
+            return arg.kind == api::IArg::Kind::MEMORY_EA;
+        });
+    }
+
+    // Bring instret up to count instructions of the block
+    void syncInstret(uint32_t count) {
+        e_.addInstret(count - synced_);
+        synced_ = count;
+    }
+
+    void emitCalls(const api::AnalysisCall* call, const api::AnalysisCall* end,
+                   const Instruction& inst, uint64_t pc) {
+        using Kind = api::IArg::Kind;
+        for (; call != end; ++call) {
+            for (uint8_t i = 0; i < call->num_args; ++i) {
+                const api::IArg& arg = call->args[i];
+                switch (arg.kind) {
+                    case Kind::INST_PTR: e_.movImm(RAX, pc); break;
+                    case Kind::RAW_INSTRUCTION: e_.movImm(RAX, inst.getRawInstruction()); break;
+                    case Kind::INSTRUCTION: e_.movImm(RAX, reinterpret_cast<uintptr_t>(&inst)); break;
+                    case Kind::MEMORY_EA: e_.loadSlot(RAX, EA_SLOT); break;
+                    case Kind::MEMORY_SIZE:
+                        e_.movImm(RAX, isa::getOpInfo(inst.getOpcodeId()).mem_size);
+                        break;
+                    case Kind::REG_VALUE: e_.loadGuest(RAX, arg.value & 0x1F); break;
+                    case Kind::HART_ID: e_.loadHartId(RAX); break;
+                    case Kind::CONSTANT: e_.movImm(RAX, arg.value); break;
+                }
+                e_.storeSlot(ARGS_SLOT + 8 * i, RAX);
+            }
+            e_.mov(RDI, R12);
+            e_.movImm(RSI, reinterpret_cast<uintptr_t>(call));
+            e_.leaSlot(RDX, ARGS_SLOT);
+            e_.call(reinterpret_cast<const void*>(&callAnalysis));
+            exceptions_.push_back(e_.jumpIfSet());
+        }
+    }
+
+    // Load or store at the address in rsi, the value to store in rdx.
+    // TLB hits run inline; the rest call the helper.
+    void emitAccess(const Instruction& inst, MemoryAccess access, const void* helper,
+                    uint32_t index, uint64_t pc) {
+        const uint32_t size = isa::getOpInfo(inst.getOpcodeId()).mem_size;
+        std::vector<size_t> misses;
+        e_.lookupTlb(memory_.getTlb(access), size, misses);
+        if (access == MemoryAccess::WRITE) {
+            e_.storeHost(size);
+        } else {
+            e_.loadHost(inst.getOpcodeId());
+        }
+        const size_t hit = e_.jump();
+
+        for (size_t miss : misses) {
+            e_.patch(miss, e_.getPosition());
+        }
+        e_.mov(RDI, R12);
+        e_.call(helper);
+        faults_.push_back({e_.jumpIfFault(), index, synced_, pc});
+        e_.patch(hit, e_.getPosition());
+    }
+
+    bool emitInstruction(const Instruction& inst, uint32_t index, uint64_t pc,
+                         uint64_t next_pc, JitExit& exit) {
+        const Opcode id = inst.getOpcodeId();
+        const uint32_t rd = inst.getRd();
+        const uint32_t rs1 = inst.getRs1();
+        const uint32_t rs2 = inst.getRs2();
+        const int32_t imm = inst.getImmediate();
+
+        AluOp op;
+        if (getAluOp(id, op)) {
+            if (rd == 0) {
+                return true;
+            }
+            e_.loadGuest(RAX, rs1);
+            if (!op.immediate) {
+                e_.loadGuest(RCX, rs2);
+            } else if (op.kind == AluOp::SHIFT) {
+                e_.movImm(RCX, static_cast<uint32_t>(imm) & (op.wide ? 0x3F : 0x1F));
+            } else {
+                e_.movImm(RCX, static_cast<uint64_t>(static_cast<int64_t>(imm)));
+            }
+            e_.alu(op);
+            e_.storeGuest(rd, RAX);
+            return true;
+        }
+
+        Cond cond;
+        if (getBranchCondition(id, cond)) {
+            e_.loadGuest(RAX, rs1);
+            e_.loadGuest(RCX, rs2);
+            e_.compare(RAX, RCX);
+            e_.movImm(RDX, next_pc);
+            e_.movImm(RSI, pc + static_cast<int64_t>(imm));
+            e_.cmov(cond, RDX, RSI);
+            e_.storePc(RDX);
+            return true;
+        }
+
+        if (LoadHelper helper = getLoadHelper(id)) {
+            e_.loadGuest(RAX, rs1);
+            e_.addImm(RAX, imm);
+            e_.mov(RSI, RAX);
+            emitAccess(inst, MemoryAccess::READ, reinterpret_cast<const void*>(helper), index, pc);
+            e_.storeGuest(rd, RAX);
+            return true;
+        }
+
+        if (StoreHelper helper = getStoreHelper(id)) {
+            e_.loadGuest(RAX, rs1);
+            e_.addImm(RAX, imm);
+            e_.mov(RSI, RAX);
+            e_.loadGuest(RDX, rs2);
+            emitAccess(inst, MemoryAccess::WRITE, reinterpret_cast<const void*>(helper), index, pc);
+            return true;
+        }
+
+        switch (id) {
+            case OP_LUI:
+            case OP_AUIPC:
+                if (rd != 0) {
+                    const uint64_t base = id == OP_AUIPC ? pc : 0;
+                    e_.movImm(RAX, base + static_cast<int64_t>(imm));
+                    e_.storeGuest(rd, RAX);
+                }
+                return true;
+            case OP_JAL:
+                e_.movImm(RAX, next_pc);
+                e_.storeGuest(rd, RAX);
+                e_.setPc(pc + static_cast<int64_t>(imm));
+                return true;
+            case OP_JALR:
+                e_.loadGuest(RAX, rs1);
+                e_.addImm(RAX, imm);
+                e_.clearLowBit(RAX);
+                e_.movImm(RCX, next_pc);
+                e_.storeGuest(rd, RCX);
+                e_.storePc(RAX);
+                return true;
+            case OP_FENCE:
+            case OP_FENCE_TSO:
+            case OP_PAUSE:
+                return true;
+            case OP_ECALL:
+            case OP_EBREAK:
+            case OP_FENCE_I:
+                // Ends the block; the engine takes over from the next pc
+                e_.setPc(next_pc);
+                exit = id == OP_ECALL ? JitExit::SYSCALL
+                     : id == OP_EBREAK ? JitExit::BREAKPOINT : JitExit::FENCE_I;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    Memory& memory_;
+    const std::vector<Instruction>& instructions_;
+    uint64_t start_pc_;
+    uint64_t end_pc_ = 0;
+    const std::vector<api::AnalysisCall>& calls_;
+    Emitter e_;
+    uint32_t synced_ = 0;
+    std::vector<FaultSite> faults_;
+    std::vector<size_t> exceptions_;
+};
+
+} // namespace
+
+JitCompiler::JitCompiler(Memory& memory, size_t cache_size) : memory_(memory) {
+    void* cache = ::mmap(nullptr, cache_size, PROT_READ | PROT_WRITE | PROT_EXEC,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (cache != MAP_FAILED) {
+        cache_ = static_cast<uint8_t*>(cache);
+        size_ = cache_size;
+    }
+}
+
+JitCompiler::~JitCompiler() {
+    if (cache_) {
+        ::munmap(cache_, size_);
+    }
+}
+
+JitEntry JitCompiler::compile(const std::vector<Instruction>& instructions, uint64_t pc,
+                              const std::vector<api::AnalysisCall>& calls) {
+    if (!cache_ || instructions.empty()) {
+        return nullptr;
+    }
+    BlockTranslator translator(memory_, instructions, pc, calls);
+    if (!translator.translate()) {
+        return nullptr;
+    }
+    const std::vector<uint8_t>& code = translator.getCode();
+    if (code.size() > size_) {
+        return nullptr;
+    }
+    if (code.size() > size_ - used_) {
+        flush();
+    }
+    uint8_t* entry = cache_ + used_;
+    std::memcpy(entry, code.data(), code.size());
+    // Entries start 16-byte aligned, as the host's own functions do
+    used_ = std::min(size_, (used_ + code.size() + 15) & ~size_t(15));
+    return reinterpret_cast<JitEntry>(entry);
+}
+
+#else
+
+// Other hosts have no code generator; every block stays interpreted
+JitCompiler::JitCompiler(Memory& memory, size_t) : memory_(memory) {}
+
+JitCompiler::~JitCompiler() = default;
+
+JitEntry JitCompiler::compile(const std::vector<Instruction>&, uint64_t,
+                              const std::vector<api::AnalysisCall>&) {
+    return nullptr;
+}
+
+#endif
+
+void JitCompiler::flush() {
+    used_ = 0;
+    generation_++;
+}
+
+} // namespace rvpin
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <vector>
+#include "instruction.hpp"
+#include "interpreter.hpp"
+#include "memory.hpp"
+#include "../api/instrumentation.hpp"
+
+namespace rvpin {
+
+// What compiled code shares with the engine that runs it. Guest registers
+// stay in the CpuState passed alongside; none live in host registers
+// between instructions, so analysis routines see them as the interpreter
+// would leave them.
+struct JitContext {
+    Memory* memory{nullptr};
+    const Instruction** current_instruction{nullptr};  // Set before analysis calls
+    uint64_t instret_limit{~0ull};  // Loops stay in compiled code up to here
+    uint32_t fault_index{0};    // Instruction whose access faulted
+    bool fault{false};
+    std::exception_ptr exception{};     // Thrown by an analysis routine
+};
+
+// How a compiled block ended. The first four are the StepResult of its
+// last instruction.
+enum class JitExit : uint32_t {
+    CONTINUE,
+    SYSCALL,
+    BREAKPOINT,
+    FENCE_I,
+    FAULT,          // A load or store faulted; pc and instret are on it
+    EXCEPTION       // An analysis routine threw; rethrow context.exception
+};
+
+using JitEntry = JitExit (*)(CpuState* state, JitContext* context);
+
+// Translates basic blocks to x86-64 code in a fixed-size executable
+// cache. Integer RV64I instructions and mul(w) are compiled inline, as
+// are loads and stores that hit the Memory TLBs; misses call into Memory.
+// Analysis calls are direct calls made at their IPoint. Blocks holding
+// anything else are left to the interpreter. A block that branches back
+// to its own start loops without returning, while the whole block still
+// fits under the context's instret_limit.
+//
+// A full cache is flushed whole. getGeneration() moves on with every
+// flush, so code compiled before one can be told apart and dropped.
+class JitCompiler {
+public:
+    static constexpr size_t DEFAULT_CACHE_SIZE = 16 << 20;
+
+    // Code compiled for memory accesses it through its TLBs
+    explicit JitCompiler(Memory& memory, size_t cache_size = DEFAULT_CACHE_SIZE);
+    ~JitCompiler();
+    JitCompiler(const JitCompiler&) = delete;
+    JitCompiler& operator=(const JitCompiler&) = delete;
+
+    // False on hosts other than x86-64, or when no executable memory
+    // could be mapped; compile() then always fails
+    bool isAvailable() const { return cache_ != nullptr; }
+
+    // Compile the block of instructions starting at pc, with its analysis
+    // calls in (instruction, point) order. Null when the block cannot be
+    // compiled. The code refers to instructions and calls, which must not
+    // move while it is in use.
+    JitEntry compile(const std::vector<Instruction>& instructions, uint64_t pc,
+                     const std::vector<api::AnalysisCall>& calls);
+
+    void flush();
+    uint64_t getGeneration() const { return generation_; }
+    size_t getUsed() const { return used_; }
+
+private:
+    Memory& memory_;
+    uint8_t* cache_ = nullptr;
+    size_t size_ = 0;
+    size_t used_ = 0;
+    uint64_t generation_ = 1;
+};
+
+} // namespace rvpin
@@ -0,0 +1,319 @@
+#include "memory.hpp"
+#include <algorithm>
+#include <sys/mman.h>
+
+namespace rvpin {
+
+Memory::Memory() : page_table_(std::make_unique<std::unique_ptr<PageEntry[]>[]>(ROOT_ENTRIES)) {}
+
+Memory::~Memory() {
+    for (const auto& mapping : host_mappings_) {
+        ::munmap(mapping.addr, mapping.length);
+    }
+}
+
+void Memory::map(uint64_t addr, uint64_t size, uint8_t perms) {
+    if (size == 0) {
+        return;
+    }
+    uint64_t start = addr & ~(PAGE_SIZE - 1);
+    uint64_t end = (addr + size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+    // Reserve address space only; the host commits pages as they are used
+    void* host = ::mmap(nullptr, end - start, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (host == MAP_FAILED) {
+        throw std::runtime_error("Failed to reserve guest memory");
+    }
+    host_mappings_.push_back({host, end - start});
+    addRegion(start, end, static_cast<uint8_t*>(host), perms);
+}
+
+void Memory::mapFile(uint64_t addr, uint64_t mem_size, int fd, uint64_t offset,
+                     uint64_t file_size, uint8_t perms) {
+    if (file_size == 0) {
+        map(addr, mem_size, perms);
+        return;
+    }
+    if (((addr ^ offset) & (PAGE_SIZE - 1)) != 0) {
+        throw std::runtime_error("File mapping is not page aligned");
+    }
+
+    uint64_t start = addr & ~(PAGE_SIZE - 1);
+    uint64_t file_end = addr + file_size;
+    uint64_t mapped_end = (file_end + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    size_t length = mapped_end - start;
+    void* host = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd,
+                        static_cast<off_t>(offset & ~(PAGE_SIZE - 1)));
+    if (host == MAP_FAILED) {
+        throw std::runtime_error("Failed to map file contents");
+    }
+    host_mappings_.push_back({host, length});
+
+    // The rest of the last file page belongs to the zero-filled part
+    auto* base = static_cast<uint8_t*>(host);
+    std::memset(base + (file_end - start), 0, mapped_end - file_end);
+    addRegion(start, mapped_end, base, perms);
+
+    if (addr + mem_size > mapped_end) {
+        map(mapped_end, addr + mem_size - mapped_end, perms);
+    }
+}
+
+void Memory::addRegion(uint64_t start, uint64_t end, uint8_t* host, uint8_t perms) {
+    if (end > (1ull << VA_BITS) || end < start) {
+        throw std::runtime_error("Guest mapping is outside the address space");
+    }
+    regions_.push_back({start, end, host, perms});
+}
+
+bool Memory::isMapped(uint64_t addr) const {
+    return std::any_of(regions_.begin(), regions_.end(), [addr](const Region& r) {
+        return addr >= r.start && addr < r.end;
+    });
+}
+
+void Memory::splitRegions(uint64_t addr) {
+    for (size_t i = 0; i < regions_.size(); i++) {
+        Region& region = regions_[i];
+        if (addr > region.start && addr < region.end) {
+            const Region tail{addr, region.end, region.host + (addr - region.start), region.perms};
+            region.end = addr;
+            regions_.insert(regions_.begin() + static_cast<ptrdiff_t>(i) + 1, tail);
+            i++;
+        }
+    }
+}
+
+void Memory::unmap(uint64_t addr, uint64_t size) {
+    const uint64_t start = addr & ~(PAGE_SIZE - 1);
+    const uint64_t end = (addr + size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    if (end <= start) {
+        return;
+    }
+    splitRegions(start);
+    splitRegions(end);
+    regions_.erase(std::remove_if(regions_.begin(), regions_.end(),
+                                  [&](const Region& r) {
+                                      if (r.start < start || r.end > end) {
+                                          return false;
+                                      }
+                                      // Hand the pages back; the reservation
+                                      // goes below once no region uses it
+                                      ::madvise(r.host, r.end - r.start, MADV_DONTNEED);
+                                      return true;
+                                  }),
+                   regions_.end());
+    host_mappings_.erase(
+        std::remove_if(host_mappings_.begin(), host_mappings_.end(),
+                       [&](const HostMapping& mapping) {
+                           const auto* base = static_cast<const uint8_t*>(mapping.addr);
+                           const bool used =
+                               std::any_of(regions_.begin(), regions_.end(), [&](const Region& r) {
+                                   return r.host >= base && r.host < base + mapping.length;
+                               });
+                           if (!used) {
+                               ::munmap(mapping.addr, mapping.length);
+                           }
+                           return !used;
+                       }),
+        host_mappings_.end());
+
+    // Leaves never touched are skipped whole, so a large unmap of little
+    // used memory stays cheap
+    for (uint64_t page_number = start >> PAGE_SHIFT; page_number < end >> PAGE_SHIFT;) {
+        if (page_number >> (ROOT_BITS + LEAF_BITS)) {
+            break;
+        }
+        PageEntry* leaf = page_table_[page_number >> LEAF_BITS].get();
+        if (!leaf) {
+            page_number = (page_number | (LEAF_ENTRIES - 1)) + 1;
+            continue;
+        }
+        leaf[page_number & (LEAF_ENTRIES - 1)] = 0;
+        page_number++;
+    }
+    flush();
+}
+
+void Memory::protect(uint64_t addr, uint64_t size, uint8_t perms) {
+    const uint64_t start = addr & ~(PAGE_SIZE - 1);
+    const uint64_t end = (addr + size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    if (end <= start) {
+        return;
+    }
+    splitRegions(start);
+    splitRegions(end);
+    for (Region& region : regions_) {
+        if (region.start >= start && region.end <= end) {
+            region.perms = perms;
+        }
+    }
+
+    // Translated pages keep their host address and dirty bit
+    constexpr PageEntry PERMS_MASK = READABLE | WRITABLE | EXECUTABLE;
+    for (uint64_t page_number = start >> PAGE_SHIFT; page_number < end >> PAGE_SHIFT;
+         page_number++) {
+        if (page_number >> (ROOT_BITS + LEAF_BITS)) {
+            break;
+        }
+        if (PageEntry* leaf = page_table_[page_number >> LEAF_BITS].get()) {
+            PageEntry& entry = leaf[page_number & (LEAF_ENTRIES - 1)];
+            if (entry != 0) {
+                entry = (entry & ~PERMS_MASK) | perms;
+            }
+        }
+    }
+    flush();
+}
+
+void Memory::flush() {
+    for (size_t i = 0; i < TLB_ENTRIES; i++) {
+        read_tlb_[i] = TlbEntry();
+        write_tlb_[i] = TlbEntry();
+    }
+}
+
+void Memory::fill(uint64_t addr, const void* src, size_t size, bool dirty) {
+    if (size == 0) {
+        return;
+    }
+    const Region* region = findRegion(addr, size);
+    if (!region) {
+        throw MemoryFault(addr, MemoryAccess::WRITE);
+    }
+    std::memcpy(region->host + (addr - region->start), src, size);
+    if (dirty) {
+        for (uint64_t page_number = addr >> PAGE_SHIFT;
+             page_number <= (addr + size - 1) >> PAGE_SHIFT; page_number++) {
+            *findEntry(page_number) |= DIRTY;
+        }
+    }
+}
+
+std::vector<Memory::Range> Memory::getMappedRanges() const {
+    std::vector<Range> ranges;
+    for (const Region& region : regions_) {
+        ranges.push_back({region.start, region.end, region.perms});
+    }
+    return ranges;
+}
+
+std::vector<uint64_t> Memory::getDirtyPages() const {
+    std::vector<uint64_t> dirty;
+    for (uint64_t root = 0; root < ROOT_ENTRIES; root++) {
+        const PageEntry* leaf = page_table_[root].get();
+        if (!leaf) {
+            continue;
+        }
+        for (uint64_t i = 0; i < LEAF_ENTRIES; i++) {
+            if (leaf[i] & DIRTY) {
+                dirty.push_back(((root << LEAF_BITS) | i) << PAGE_SHIFT);
+            }
+        }
+    }
+    return dirty;
+}
+
+const Memory::Region* Memory::findRegion(uint64_t addr, size_t size) const {
+    for (const Region& region : regions_) {
+        if (addr >= region.start && addr < region.end) {
+            return size <= region.end - addr ? &region : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+const uint8_t* Memory::view(uint64_t addr, size_t size) {
+    const Region* region = findRegion(addr, size);
+    if (!region || !(region->perms & READABLE)) {
+        return nullptr;
+    }
+    return region->host + (addr - region->start);
+}
+
+uint8_t* Memory::viewMutable(uint64_t addr, size_t size) {
+    const Region* region = findRegion(addr, size);
+    if (!region || !(region->perms & WRITABLE)) {
+        return nullptr;
+    }
+    for (uint64_t page_addr = addr & ~(PAGE_SIZE - 1); page_addr < addr + size;
+         page_addr += PAGE_SIZE) {
+        refill(page_addr, MemoryAccess::WRITE);
+    }
+    return region->host + (addr - region->start);
+}
+
+void Memory::read(uint64_t addr, void* dst, size_t size) {
+    auto* out = static_cast<uint8_t*>(dst);
+    while (size > 0) {
+        uint64_t offset = addr & (PAGE_SIZE - 1);
+        size_t chunk = std::min<uint64_t>(size, PAGE_SIZE - offset);
+        std::memcpy(out, page(addr, MemoryAccess::READ) + offset, chunk);
+        addr += chunk;
+        out += chunk;
+        size -= chunk;
+    }
+}
+
+void Memory::write(uint64_t addr, const void* src, size_t size) {
+    auto* in = static_cast<const uint8_t*>(src);
+    while (size > 0) {
+        uint64_t offset = addr & (PAGE_SIZE - 1);
+        size_t chunk = std::min<uint64_t>(size, PAGE_SIZE - offset);
+        std::memcpy(page(addr, MemoryAccess::WRITE) + offset, in, chunk);
+        addr += chunk;
+        in += chunk;
+        size -= chunk;
+    }
+}
+
+Memory::PageEntry* Memory::findEntry(uint64_t page_number) {
+    if (page_number >> (ROOT_BITS + LEAF_BITS)) {
+        return nullptr;
+    }
+    std::unique_ptr<PageEntry[]>& leaf = page_table_[page_number >> LEAF_BITS];
+    if (!leaf) {
+        leaf = std::make_unique<PageEntry[]>(LEAF_ENTRIES);
+    }
+    PageEntry& entry = leaf[page_number & (LEAF_ENTRIES - 1)];
+    if (entry == 0) {
+        // First touch: the earliest range mapped over the page backs it
+        uint64_t page_addr = page_number << PAGE_SHIFT;
+        auto region = std::find_if(regions_.begin(), regions_.end(), [page_addr](const Region& r) {
+            return page_addr >= r.start && page_addr < r.end;
+        });
+        if (region == regions_.end()) {
+            return nullptr;
+        }
+        entry = reinterpret_cast<PageEntry>(region->host + (page_addr - region->start)) |
+                region->perms;
+    }
+    return &entry;
+}
+
+uint8_t* Memory::translate(uint64_t addr, MemoryAccess access) {
+    PageEntry* entry = findEntry(addr >> PAGE_SHIFT);
+    if (!entry) {
+        throw MemoryFault(addr, access);
+    }
+    if (!(*entry & static_cast<PageEntry>(access))) {
+        throw MemoryFault(addr, access, true);
+    }
+    if (access == MemoryAccess::WRITE) {
+        *entry |= DIRTY;
+    }
+    return reinterpret_cast<uint8_t*>(*entry & ~FLAGS_MASK);
+}
+
+uint8_t* Memory::refill(uint64_t addr, MemoryAccess access) {
+    uint8_t* host = translate(addr, access);
+    const uint64_t page_number = addr >> PAGE_SHIFT;
+    TlbEntry& entry = (access == MemoryAccess::WRITE ? write_tlb_ : read_tlb_)
+        [page_number & (TLB_ENTRIES - 1)];
+    entry.page_number = page_number;
+    entry.host = host;
+    return host;
+}
+
+} // namespace rvpin
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace rvpin {
+
+// How the guest touches memory. Each kind needs the page permission of
+// the same value, see Memory::READABLE.
+enum class MemoryAccess : uint8_t {
+    READ = 1,
+    WRITE = 2,
+    EXECUTE = 4
+};
+
+// Raised when the guest touches an address that is not mapped, or one
+// whose page does not allow the access, e.g. a store into .text
+class MemoryFault : public std::runtime_error {
+public:
+    MemoryFault(uint64_t addr, MemoryAccess access, bool mapped = false)
+        : std::runtime_error(describe(access, mapped)), addr_(addr), access_(access),
+          mapped_(mapped) {}
+
+    uint64_t getAddress() const { return addr_; }
+    MemoryAccess getAccess() const { return access_; }
+    bool isWrite() const { return access_ == MemoryAccess::WRITE; }
+    // Mapped, but without the permission the access needs
+    bool isProtectionFault() const { return mapped_; }
+
+private:
+    static std::string describe(MemoryAccess access, bool mapped) {
+        switch (access) {
+            case MemoryAccess::READ:
+                return mapped ? "load from unreadable address" : "load from unmapped address";
+            case MemoryAccess::WRITE:
+                return mapped ? "store to read-only address" : "store to unmapped address";
+            case MemoryAccess::EXECUTE:
+                break;
+        }
+        return mapped ? "fetch from non-executable address" : "fetch from unmapped address";
+    }
+
+    uint64_t addr_;
+    MemoryAccess access_;
+    bool mapped_;
+};
+
+// Sparse guest address space made of 4 KiB pages. Each mapped range is
+// backed by one contiguous host mapping, zero-filled, whose pages the
+// host only allocates on first touch.
+//
+// Guest pages are translated through a two-level radix table, filled in
+// from the mapped ranges on first touch, in front of which sit two small
+// direct-mapped TLBs, one for loads and one for stores. A load or store
+// that hits its TLB and stays within the page is a tag compare and a
+// memcpy. The store TLB only takes writable pages and marks them dirty
+// as it does, so permissions and dirty tracking cost nothing on a hit.
+class Memory {
+public:
+    static constexpr uint64_t PAGE_SHIFT = 12;
+    static constexpr uint64_t PAGE_SIZE = 1ull << PAGE_SHIFT;
+
+    // Guest addresses below 2^VA_BITS can be mapped, as with Sv39
+    static constexpr uint64_t VA_BITS = 39;
+
+    // Page permissions, a mask
+    static constexpr uint8_t READABLE = static_cast<uint8_t>(MemoryAccess::READ);
+    static constexpr uint8_t WRITABLE = static_cast<uint8_t>(MemoryAccess::WRITE);
+    static constexpr uint8_t EXECUTABLE = static_cast<uint8_t>(MemoryAccess::EXECUTE);
+
+    Memory();
+    ~Memory();
+    Memory(const Memory&) = delete;
+    Memory& operator=(const Memory&) = delete;
+
+    // Make [addr, addr + size) accessible with the given permissions
+    void map(uint64_t addr, uint64_t size, uint8_t perms = READABLE | WRITABLE);
+
+    // Make [addr, addr + mem_size) accessible, backed by file_size bytes
+    // of fd starting at offset and zeroes after that. File pages are
+    // mapped copy-on-write: nothing is copied up front and the file is
+    // never modified. addr and offset must agree modulo PAGE_SIZE.
+    void mapFile(uint64_t addr, uint64_t mem_size, int fd, uint64_t offset, uint64_t file_size,
+                 uint8_t perms = READABLE | WRITABLE);
+    bool isMapped(uint64_t addr) const;
+
+    // Drop the pages of [addr, addr + size), or change what they allow.
+    // Ranges are split at the page boundaries given; pages already
+    // translated are flushed from the page table and TLBs.
+    void unmap(uint64_t addr, uint64_t size);
+    void protect(uint64_t addr, uint64_t size, uint8_t perms);
+
+    // Copy [src, src + size) to addr whatever the permissions, e.g. while
+    // loading the program. The pages stay clean, as part of a fresh load,
+    // unless dirty is set.
+    void fill(uint64_t addr, const void* src, size_t size, bool dirty = false);
+
+    // Page-aligned [start, end) ranges made accessible so far, in the
+    // order they were mapped
+    struct Range {
+        uint64_t start;
+        uint64_t end;
+        uint8_t perms;
+    };
+    std::vector<Range> getMappedRanges() const;
+
+    // Addresses of the pages stored to since they were mapped, ascending.
+    // Every other page still holds what map() or mapFile() put there, so
+    // these pages are all that separates the guest from a fresh load.
+    std::vector<uint64_t> getDirtyPages() const;
+
+    // Bulk copies, may cross pages
+    void read(uint64_t addr, void* dst, size_t size);
+    void write(uint64_t addr, const void* src, size_t size);
+
+    // Host pointer to [addr, addr + size), or null unless the range lies
+    // within one mapped range that allows the access. No copy is made;
+    // the pointer stays valid until the range is unmapped. The writable
+    // form marks the pages dirty up front, as a store would.
+    const uint8_t* view(uint64_t addr, size_t size);
+    uint8_t* viewMutable(uint64_t addr, size_t size);
+
+    template <typename T>
+    T load(uint64_t addr) {
+        T value;
+        uint64_t offset = addr & (PAGE_SIZE - 1);
+        if (offset + sizeof(T) <= PAGE_SIZE) {
+            std::memcpy(&value, page(addr, MemoryAccess::READ) + offset, sizeof(T));
+        } else {
+            read(addr, &value, sizeof(T));
+        }
+        return value;
+    }
+
+    template <typename T>
+    void store(uint64_t addr, T value) {
+        uint64_t offset = addr & (PAGE_SIZE - 1);
+        if (offset + sizeof(T) <= PAGE_SIZE) {
+            std::memcpy(page(addr, MemoryAccess::WRITE) + offset, &value, sizeof(T));
+        } else {
+            write(addr, &value, sizeof(T));
+        }
+    }
+
+    // Direct-mapped TLB entry, for code that inlines the hit path of
+    // load() and store(), such as JitCompiler. Entries for page_number
+    // sit at page_number % TLB_ENTRIES.
+    struct TlbEntry {
+        uint64_t page_number = ~0ull;
+        uint8_t* host = nullptr;
+    };
+    static constexpr size_t TLB_ENTRIES = 256;
+
+    // The load TLB for MemoryAccess::READ, the store TLB for WRITE. Their
+    // addresses are fixed for the life of the Memory.
+    const TlbEntry* getTlb(MemoryAccess access) const {
+        return access == MemoryAccess::WRITE ? write_tlb_ : read_tlb_;
+    }
+
+    // Instruction parcel at addr, which needs execute permission. Parcels
+    // are 2-byte aligned, so one never crosses a page. Only the translator
+    // fetches, once per decoded instruction, so this skips the TLBs.
+    uint16_t fetch(uint64_t addr) {
+        uint16_t parcel;
+        std::memcpy(&parcel, translate(addr, MemoryAccess::EXECUTE) + (addr & (PAGE_SIZE - 1)),
+                    sizeof(parcel));
+        return parcel;
+    }
+
+private:
+    struct Region {
+        uint64_t start;
+        uint64_t end;
+        uint8_t* host;      // Host address of start
+        uint8_t perms;
+    };
+
+    struct HostMapping {
+        void* addr;
+        size_t length;
+    };
+
+    // Radix table entry: the page's host address, page aligned, with its
+    // permissions and DIRTY in the low bits. Zero until first touched.
+    using PageEntry = uintptr_t;
+    static constexpr PageEntry DIRTY = 8;
+    static constexpr PageEntry FLAGS_MASK = PAGE_SIZE - 1;
+
+    // 27-bit page numbers: 13 bits pick a leaf, 14 bits the entry in it.
+    // Leaves cover 64 MiB and are allocated as pages in them are touched.
+    static constexpr uint64_t LEAF_BITS = 14;
+    static constexpr uint64_t ROOT_BITS = VA_BITS - PAGE_SHIFT - LEAF_BITS;
+    static constexpr uint64_t LEAF_ENTRIES = 1ull << LEAF_BITS;
+    static constexpr uint64_t ROOT_ENTRIES = 1ull << ROOT_BITS;
+
+    // Host address of the page containing addr
+    uint8_t* page(uint64_t addr, MemoryAccess access) {
+        const uint64_t page_number = addr >> PAGE_SHIFT;
+        const TlbEntry& entry = (access == MemoryAccess::WRITE ? write_tlb_ : read_tlb_)
+            [page_number & (TLB_ENTRIES - 1)];
+        if (entry.page_number == page_number) {
+            return entry.host;
+        }
+        return refill(addr, access);
+    }
+
+    uint8_t* refill(uint64_t addr, MemoryAccess access);
+    uint8_t* translate(uint64_t addr, MemoryAccess access);
+    PageEntry* findEntry(uint64_t page_number);
+    const Region* findRegion(uint64_t addr, size_t size) const;
+    void addRegion(uint64_t start, uint64_t end, uint8_t* host, uint8_t perms);
+    void splitRegions(uint64_t addr);
+    void flush();
+
+    std::vector<Region> regions_;
+    std::vector<HostMapping> host_mappings_;
+    std::unique_ptr<std::unique_ptr<PageEntry[]>[]> page_table_;
+
+    TlbEntry read_tlb_[TLB_ENTRIES];
+    TlbEntry write_tlb_[TLB_ENTRIES];
+};
+
+} // namespace rvpin
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace rvpin {
+
+// Region markers: slti x0, x0, 1 and slti x0, x0, 2. Both are HINTs, so a
+// marked program still runs unchanged on hardware and other simulators.
+constexpr uint32_t REGION_START_MARKER = 0x00102013;
+constexpr uint32_t REGION_STOP_MARKER = 0x00202013;
+
+// Region of interest for a run. Execution up to the start of the region
+// runs uninstrumented: no analysis calls, tool hooks or callbacks. The
+// start is found by applying each condition that is set in turn: skip
+// instructions, then reach start_symbol or start_pc, then execute a start
+// marker. The run ends after max_instructions in the region, at the next
+// stop marker if markers is set, or when the program exits.
+//
+// With restore set, the run begins at a checkpoint (Engine::saveCheckpoint)
+// rather than the program's entry, and skip counts from there.
+struct RegionOptions {
+    std::string restore;                // Checkpoint to start from
+    uint64_t skip{0};                   // Instructions to fast-forward
+    std::string start_symbol;           // Start on reaching this function
+    uint64_t start_pc{0};               // Start on reaching this pc, 0 for none
+    bool markers{false};                // Start and stop on region markers
+    uint64_t max_instructions{0};       // Instructions in the region, 0 for no limit
+
+    bool fastForwards() const {
+        return skip != 0 || !start_symbol.empty() || start_pc != 0 || markers;
+    }
+};
+
+// Command-line form shared by the example tools:
+//   --restore file  --skip n  --start symbol|pc  --markers  --max n
+// Consumes argv[arg], and its value, if it is one of these, leaving arg
+// on the last argument used. Returns false for anything else.
+inline bool parseRegionOption(int& arg, int argc, char* argv[], RegionOptions& region) {
+    const std::string option = argv[arg];
+    if (option == "--markers") {
+        region.markers = true;
+        return true;
+    }
+    if (arg + 1 >= argc) {
+        return false;
+    }
+    const std::string value = argv[arg + 1];
+    if (option == "--restore") {
+        region.restore = value;
+    } else if (option == "--skip") {
+        region.skip = std::stoull(value, nullptr, 0);
+    } else if (option == "--max") {
+        region.max_instructions = std::stoull(value, nullptr, 0);
+    } else if (option == "--start") {
+        // A pc is written as a number, anything else names a symbol
+        if (value[0] >= '0' && value[0] <= '9') {
+            region.start_pc = std::stoull(value, nullptr, 0);
+        } else {
+            region.start_symbol = value;
+        }
+    } else {
+        return false;
+    }
+    arg++;
+    return true;
+}
+
+} // namespace rvpin
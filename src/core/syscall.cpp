@@ -0,0 +1,504 @@
+#include "engine.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <ctime>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// User-mode Linux syscall emulation. Files, paths and clocks are the
+// host's: each guest fd stands for a host fd of its engine's own, and
+// paths resolve against the host's working directory. Flag and mode bits
+// are the generic Linux values RISC-V shares with x86-64 and AArch64
+// hosts, so they pass through.
+
+namespace rvpin {
+
+using namespace syscall;
+
+namespace {
+
+constexpr uint32_t REG_A0 = 10;
+constexpr uint32_t REG_A7 = 17;
+
+// mmap() places mappings top down from here, below the stack
+constexpr uint64_t MMAP_TOP = 0x3f00000000ull;
+
+// Generic Linux mmap flags
+constexpr uint64_t MAP_FIXED_FLAG = 0x10;
+constexpr uint64_t MAP_ANONYMOUS_FLAG = 0x20;
+
+// Largest host buffer a read or write is staged through
+constexpr size_t MAX_STAGED_BYTES = 1 << 20;
+
+uint64_t pageAlign(uint64_t size) {
+    return (size + Memory::PAGE_SIZE - 1) & ~(Memory::PAGE_SIZE - 1);
+}
+
+// PROT_READ, PROT_WRITE and PROT_EXEC have the values of the page
+// permissions
+uint8_t permsFromProt(uint64_t prot) {
+    return static_cast<uint8_t>(prot & (Memory::READABLE | Memory::WRITABLE | Memory::EXECUTABLE));
+}
+
+// Highest length-byte gap in [low, high) that no range covers, or 0 if
+// there is none. Gaps left by munmap are found again this way.
+uint64_t findGap(std::vector<Memory::Range> ranges, uint64_t low, uint64_t high,
+                 uint64_t length) {
+    std::sort(ranges.begin(), ranges.end(),
+              [](const Memory::Range& a, const Memory::Range& b) { return a.start > b.start; });
+    for (const Memory::Range& range : ranges) {
+        if (range.start >= high) {
+            continue;
+        }
+        if (range.end < high && high - std::max(range.end, low) >= length) {
+            break;
+        }
+        high = range.start;
+    }
+    return high >= low && high - low >= length ? high - length : 0;
+}
+
+int64_t result(int64_t value) {
+    return value < 0 ? -errno : value;
+}
+
+// path as the host resolves it against dir, so it can be opened again
+// from anywhere
+std::string resolvePath(int dir, const std::string& path) {
+    if (dir == AT_FDCWD || path.empty() || path[0] == '/') {
+        return path;
+    }
+    char target[PATH_MAX];
+    const std::string link = "/proc/self/fd/" + std::to_string(dir);
+    const ssize_t length = ::readlink(link.c_str(), target, sizeof(target));
+    if (length <= 0) {
+        return path;
+    }
+    return std::string(target, static_cast<size_t>(length)) + "/" + path;
+}
+
+// An in-memory copy of the file at path for a dry run to write instead.
+// Fails as opening the file would when it does not exist, or O_EXCL finds
+// it does.
+int openShadow(int dir, const std::string& path, int flags) {
+    const int original = ::openat(dir, path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (original < 0 && (errno != ENOENT || !(flags & O_CREAT))) {
+        return -1;
+    }
+    if (original >= 0 && (flags & O_CREAT) && (flags & O_EXCL)) {
+        ::close(original);
+        errno = EEXIST;
+        return -1;
+    }
+    const int shadow = ::memfd_create("rvpin-shadow", MFD_CLOEXEC);
+    if (shadow < 0 || original < 0) {
+        const int error = errno;
+        if (original >= 0) {
+            ::close(original);
+        }
+        errno = error;
+        return shadow;
+    }
+
+    // Only regular files have contents worth copying; devices and pipes
+    // would block or be consumed
+    struct stat st;
+    if (!(flags & O_TRUNC) && ::fstat(original, &st) == 0 && S_ISREG(st.st_mode)) {
+        std::vector<char> buffer(MAX_STAGED_BYTES);
+        ssize_t bytes;
+        while ((bytes = ::read(original, buffer.data(), buffer.size())) > 0) {
+            if (::write(shadow, buffer.data(), static_cast<size_t>(bytes)) != bytes) {
+                break;
+            }
+        }
+        ::lseek(shadow, 0, SEEK_SET);
+    }
+    ::close(original);
+    if (flags & O_APPEND) {
+        ::fcntl(shadow, F_SETFL, O_APPEND);
+    }
+    return shadow;
+}
+
+// struct stat as the RISC-V kernel lays it out
+struct GuestStat {
+    uint64_t dev;
+    uint64_t ino;
+    uint32_t mode;
+    uint32_t nlink;
+    uint32_t uid;
+    uint32_t gid;
+    uint64_t rdev;
+    uint64_t pad1;
+    int64_t size;
+    int32_t blksize;
+    int32_t pad2;
+    int64_t blocks;
+    int64_t atime;
+    uint64_t atime_nsec;
+    int64_t mtime;
+    uint64_t mtime_nsec;
+    int64_t ctime;
+    uint64_t ctime_nsec;
+    uint32_t unused[2];
+};
+static_assert(sizeof(GuestStat) == 128, "RISC-V struct stat is 128 bytes");
+
+GuestStat toGuest(const struct stat& st) {
+    GuestStat guest{};
+    guest.dev = st.st_dev;
+    guest.ino = st.st_ino;
+    guest.mode = st.st_mode;
+    guest.nlink = static_cast<uint32_t>(st.st_nlink);
+    guest.uid = st.st_uid;
+    guest.gid = st.st_gid;
+    guest.rdev = st.st_rdev;
+    guest.size = st.st_size;
+    guest.blksize = static_cast<int32_t>(st.st_blksize);
+    guest.blocks = st.st_blocks;
+    guest.atime = st.st_atim.tv_sec;
+    guest.atime_nsec = static_cast<uint64_t>(st.st_atim.tv_nsec);
+    guest.mtime = st.st_mtim.tv_sec;
+    guest.mtime_nsec = static_cast<uint64_t>(st.st_mtim.tv_nsec);
+    guest.ctime = st.st_ctim.tv_sec;
+    guest.ctime_nsec = static_cast<uint64_t>(st.st_ctim.tv_nsec);
+    return guest;
+}
+
+} // namespace
+
+void Engine::registerSyscallTrace(SyscallCallback callback, size_t batch_size) {
+    syscall_callback_ = std::move(callback);
+    syscall_batch_size_ = std::max<size_t>(batch_size, 1);
+    syscall_events_.reserve(syscall_batch_size_);
+}
+
+void Engine::flushSyscallTrace() {
+    if (!syscall_events_.empty()) {
+        syscall_callback_(syscall_events_);
+        syscall_events_.clear();
+    }
+}
+
+void Engine::handleSyscall() {
+    uint64_t* x = state_.x;
+    const uint64_t number = x[REG_A7];
+    const bool tracing = syscall_callback_ && instrumenting_;
+    const auto start = tracing ? std::chrono::steady_clock::now()
+                               : std::chrono::steady_clock::time_point();
+
+    SyscallEvent event{};
+    if (tracing) {
+        event.number = number;
+        std::copy(x + REG_A0, x + REG_A0 + 6, event.args);
+    }
+
+    // A bad guest pointer fails the call, as the kernel would
+    int64_t value;
+    try {
+        value = emulateSyscall(number, x + REG_A0);
+    } catch (const MemoryFault&) {
+        value = -EFAULT;
+    }
+    if (!exited_) {
+        x[REG_A0] = static_cast<uint64_t>(value);
+    }
+
+    if (tracing) {
+        event.result = value;
+        event.pc = state_.pc - 4;
+        event.instret = state_.instret;
+        event.gap = state_.instret - last_syscall_instret_;
+        event.host_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+        event.hart = state_.hart_id;
+        syscall_events_.push_back(event);
+        if (syscall_events_.size() >= syscall_batch_size_) {
+            flushSyscallTrace();
+        }
+    }
+    last_syscall_instret_ = state_.instret;
+}
+
+int64_t Engine::emulateSyscall(uint64_t number, const uint64_t* args) {
+    const int fd = static_cast<int>(args[0]);
+    switch (number) {
+        case SYS_READ:
+            return syscallRead(fd, args[1], args[2]);
+        case SYS_WRITE:
+            return syscallWrite(fd, args[1], args[2]);
+        case SYS_WRITEV: {
+            int64_t total = 0;
+            for (uint64_t i = 0; i < args[2]; i++) {
+                const uint64_t base = memory_.load<uint64_t>(args[1] + i * 16);
+                const uint64_t length = memory_.load<uint64_t>(args[1] + i * 16 + 8);
+                const int64_t written = syscallWrite(fd, base, length);
+                if (written < 0) {
+                    return total ? total : written;
+                }
+                total += written;
+                if (static_cast<uint64_t>(written) < length) {
+                    break;
+                }
+            }
+            return total;
+        }
+        case SYS_OPENAT:
+            return syscallOpen(fd, readGuestString(args[1]), static_cast<int>(args[2]),
+                               static_cast<uint32_t>(args[3]));
+        case SYS_CLOSE: {
+            // The guest shares the host's standard streams and must not
+            // close them
+            if (fd <= 2) {
+                return 0;
+            }
+            const int host = hostFd(fd);
+            if (host < 0) {
+                return -EBADF;
+            }
+            files_[static_cast<size_t>(fd)] = GuestFile{};
+            return result(::close(host));
+        }
+        case SYS_LSEEK:
+            return result(::lseek(hostFd(fd), static_cast<off_t>(args[1]),
+                                  static_cast<int>(args[2])));
+        case SYS_FSTAT:
+        case SYS_NEWFSTATAT: {
+            struct stat st;
+            uint64_t buffer = args[1];
+            int status;
+            if (number == SYS_FSTAT) {
+                status = ::fstat(hostFd(fd), &st);
+            } else {
+                const std::string path = readGuestString(args[1]);
+                buffer = args[2];
+                status = ::fstatat(fd == AT_FDCWD ? AT_FDCWD : hostFd(fd), path.c_str(), &st,
+                                   static_cast<int>(args[3]));
+            }
+            if (status < 0) {
+                return -errno;
+            }
+            const GuestStat guest = toGuest(st);
+            memory_.write(buffer, &guest, sizeof(guest));
+            return 0;
+        }
+        case SYS_CLOCK_GETTIME: {
+            struct timespec ts;
+            if (::clock_gettime(static_cast<clockid_t>(args[0]), &ts) < 0) {
+                return -errno;
+            }
+            const int64_t guest_ts[2] = {ts.tv_sec, ts.tv_nsec};
+            memory_.write(args[1], guest_ts, sizeof(guest_ts));
+            return 0;
+        }
+        case SYS_EXIT:
+        case SYS_EXIT_GROUP:
+            exited_ = true;
+            exit_code_ = static_cast<int>(args[0]);
+            return 0;
+        case SYS_BRK: {
+            // The heap stops below the lowest mmap() placement. A request
+            // that cannot be met leaves the break where it was, which is
+            // how the kernel reports failure.
+            const uint64_t requested = args[0];
+            const uint64_t limit = mmap_top_ ? mmap_top_ : MMAP_TOP;
+            if (requested > brk_ && requested <= limit) {
+                const uint64_t mapped = pageAlign(brk_);
+                try {
+                    memory_.map(mapped, pageAlign(requested) - mapped);
+                } catch (const std::runtime_error&) {
+                    return static_cast<int64_t>(brk_);
+                }
+                brk_ = requested;
+            }
+            return static_cast<int64_t>(brk_);
+        }
+        case SYS_MMAP:
+            return syscallMmap(args);
+        case SYS_MUNMAP:
+            if (args[0] & (Memory::PAGE_SIZE - 1)) {
+                return -EINVAL;
+            }
+            memory_.unmap(args[0], args[1]);
+            mappings_changed_ = true;
+            return 0;
+        case SYS_MPROTECT:
+            if (args[0] & (Memory::PAGE_SIZE - 1)) {
+                return -EINVAL;
+            }
+            memory_.protect(args[0], args[1], permsFromProt(args[2]));
+            mappings_changed_ = true;
+            return 0;
+        case SYS_SET_TID_ADDRESS:
+        case SYS_GETPID:
+        case SYS_GETTID:
+            return ::getpid();
+        case SYS_SET_ROBUST_LIST:
+            return 0;
+        case SYS_RSEQ:
+            // glibc registers one if it can and carries on without
+            return -ENOSYS;
+        default:
+            std::cerr << "Unsupported syscall " << number << "\n";
+            return -ENOSYS;
+    }
+}
+
+int64_t Engine::syscallRead(int fd, uint64_t addr, uint64_t count) {
+    count = std::min<uint64_t>(count, MAX_STAGED_BYTES);
+    const int host = hostFd(fd);
+    if (uint8_t* direct = memory_.viewMutable(addr, count)) {
+        return result(::read(host, direct, count));
+    }
+    std::vector<uint8_t> buffer(count);
+    const ssize_t bytes = ::read(host, buffer.data(), buffer.size());
+    if (bytes < 0) {
+        return -errno;
+    }
+    memory_.write(addr, buffer.data(), static_cast<size_t>(bytes));
+    return bytes;
+}
+
+int64_t Engine::syscallWrite(int fd, uint64_t addr, uint64_t count) {
+    count = std::min<uint64_t>(count, MAX_STAGED_BYTES);
+    const int host = hostFd(fd);
+    if (dry_run_ && host >= 0 && host <= 2) {
+        return static_cast<int64_t>(count);
+    }
+    // Keep tool output ordered with the guest's
+    std::cout.flush();
+    if (const uint8_t* direct = memory_.view(addr, count)) {
+        return result(::write(host, direct, count));
+    }
+    std::vector<uint8_t> buffer(count);
+    memory_.read(addr, buffer.data(), buffer.size());
+    return result(::write(host, buffer.data(), buffer.size()));
+}
+
+int64_t Engine::syscallOpen(int dirfd, const std::string& path, int flags, uint32_t mode) {
+    const int dir = dirfd == AT_FDCWD ? AT_FDCWD : hostFd(dirfd);
+    const int host = openHost(dir, path, flags, mode);
+    if (host < 0) {
+        return -errno;
+    }
+
+    // The lowest free number, as the kernel hands out
+    size_t fd = 3;
+    while (fd < files_.size() && files_[fd].host >= 0) {
+        fd++;
+    }
+    if (fd == files_.size()) {
+        files_.emplace_back();
+    }
+    files_[fd] = GuestFile{host, resolvePath(dir, path), flags, mode};
+    return static_cast<int64_t>(fd);
+}
+
+int Engine::openHost(int dir, const std::string& path, int flags, uint32_t mode) {
+    const bool writes = (flags & O_ACCMODE) != O_RDONLY || (flags & (O_CREAT | O_TRUNC));
+    if (dry_run_ && writes) {
+        return openShadow(dir, path, flags);
+    }
+    return ::openat(dir, path.c_str(), flags, static_cast<mode_t>(mode));
+}
+
+int Engine::hostFd(int fd) const {
+    if (fd < 0 || static_cast<size_t>(fd) >= files_.size()) {
+        return -1;
+    }
+    return files_[static_cast<size_t>(fd)].host;
+}
+
+void Engine::closeFiles() {
+    for (size_t fd = 3; fd < files_.size(); fd++) {
+        if (files_[fd].host >= 0) {
+            ::close(files_[fd].host);
+        }
+    }
+    files_.resize(3);
+}
+
+int64_t Engine::syscallMmap(const uint64_t* args) {
+    const uint64_t length = pageAlign(args[1]);
+    const uint64_t flags = args[3];
+    const int fd = hostFd(static_cast<int>(args[4]));
+    const off_t offset = static_cast<off_t>(args[5]);
+    if (length == 0 || (offset & (Memory::PAGE_SIZE - 1)) != 0) {
+        return -EINVAL;
+    }
+    const bool anonymous = flags & MAP_ANONYMOUS_FLAG;
+    struct stat st;
+    if (!anonymous && ::fstat(fd, &st) < 0) {
+        return -errno;
+    }
+
+    // Hints are ignored; fixed mappings replace what was there
+    uint64_t addr;
+    if (flags & MAP_FIXED_FLAG) {
+        addr = args[0];
+        if (addr & (Memory::PAGE_SIZE - 1)) {
+            return -EINVAL;
+        }
+        // Checked before anything is unmapped, so a refused request
+        // leaves the old mappings in place
+        if (addr + length < addr || addr + length > (1ull << Memory::VA_BITS)) {
+            return -ENOMEM;
+        }
+        memory_.unmap(addr, length);
+        mappings_changed_ = true;
+    } else {
+        addr = findGap(memory_.getMappedRanges(), pageAlign(brk_), MMAP_TOP, length);
+        if (addr == 0) {
+            return -ENOMEM;
+        }
+        if (mmap_top_ == 0 || addr < mmap_top_) {
+            mmap_top_ = addr;
+        }
+    }
+    try {
+        memory_.map(addr, length, permsFromProt(args[2]));
+    } catch (const std::runtime_error&) {
+        return -ENOMEM;
+    }
+
+    // File contents are copied in as dirty pages rather than mapped, so
+    // checkpoints carry them. Writes never reach the file.
+    if (!anonymous) {
+        std::vector<uint8_t> buffer(std::min<uint64_t>(length, MAX_STAGED_BYTES));
+        for (uint64_t done = 0; done < length;) {
+            const ssize_t bytes = ::pread(fd, buffer.data(),
+                                          std::min<uint64_t>(buffer.size(), length - done),
+                                          offset + static_cast<off_t>(done));
+            if (bytes < 0) {
+                const int64_t error = -errno;
+                memory_.unmap(addr, length);
+                return error;
+            }
+            if (bytes == 0) {
+                break;
+            }
+            memory_.fill(addr + done, buffer.data(), static_cast<size_t>(bytes), true);
+            done += static_cast<uint64_t>(bytes);
+        }
+    }
+    return static_cast<int64_t>(addr);
+}
+
+std::string Engine::readGuestString(uint64_t addr) {
+    std::string text;
+    for (char c; text.size() < PATH_MAX &&
+                 (c = static_cast<char>(memory_.load<uint8_t>(addr))) != '\0';
+         addr++) {
+        text.push_back(c);
+    }
+    return text;
+}
+
+} // namespace rvpin
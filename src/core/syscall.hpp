@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+
+namespace rvpin {
+
+// RISC-V Linux syscall numbers (asm-generic)
+namespace syscall {
+
+constexpr uint64_t SYS_OPENAT = 56;
+constexpr uint64_t SYS_CLOSE = 57;
+constexpr uint64_t SYS_LSEEK = 62;
+constexpr uint64_t SYS_READ = 63;
+constexpr uint64_t SYS_WRITE = 64;
+constexpr uint64_t SYS_WRITEV = 66;
+constexpr uint64_t SYS_NEWFSTATAT = 79;
+constexpr uint64_t SYS_FSTAT = 80;
+constexpr uint64_t SYS_EXIT = 93;
+constexpr uint64_t SYS_EXIT_GROUP = 94;
+constexpr uint64_t SYS_SET_TID_ADDRESS = 96;
+constexpr uint64_t SYS_SET_ROBUST_LIST = 99;
+constexpr uint64_t SYS_CLOCK_GETTIME = 113;
+constexpr uint64_t SYS_GETPID = 172;
+constexpr uint64_t SYS_GETTID = 178;
+constexpr uint64_t SYS_BRK = 214;
+constexpr uint64_t SYS_MUNMAP = 215;
+constexpr uint64_t SYS_MMAP = 222;
+constexpr uint64_t SYS_MPROTECT = 226;
+constexpr uint64_t SYS_RSEQ = 293;
+
+// Name of a syscall the engine emulates, null for the others
+inline const char* getName(uint64_t number) {
+    switch (number) {
+        case SYS_OPENAT: return "openat";
+        case SYS_CLOSE: return "close";
+        case SYS_LSEEK: return "lseek";
+        case SYS_READ: return "read";
+        case SYS_WRITE: return "write";
+        case SYS_WRITEV: return "writev";
+        case SYS_NEWFSTATAT: return "newfstatat";
+        case SYS_FSTAT: return "fstat";
+        case SYS_EXIT: return "exit";
+        case SYS_EXIT_GROUP: return "exit_group";
+        case SYS_SET_TID_ADDRESS: return "set_tid_address";
+        case SYS_SET_ROBUST_LIST: return "set_robust_list";
+        case SYS_CLOCK_GETTIME: return "clock_gettime";
+        case SYS_GETPID: return "getpid";
+        case SYS_GETTID: return "gettid";
+        case SYS_BRK: return "brk";
+        case SYS_MUNMAP: return "munmap";
+        case SYS_MMAP: return "mmap";
+        case SYS_MPROTECT: return "mprotect";
+        case SYS_RSEQ: return "rseq";
+        default: return nullptr;
+    }
+}
+
+} // namespace syscall
+
+// One syscall made by the guest, as passed to Engine::registerSyscallTrace.
+// Syscalls are served by the host and retire as a single ecall, so their
+// cost shows up as host time; gap is the guest work between two of them.
+struct SyscallEvent {
+    uint64_t number;
+    uint64_t args[6];       // a0-a5 at the ecall
+    int64_t result;         // a0 afterwards, -errno on failure
+    uint64_t pc;            // Of the ecall
+    uint64_t instret;       // Instructions retired, the ecall included
+    uint64_t gap;           // Instructions retired since the previous syscall
+    uint64_t host_ns;       // Host time spent serving it
+    uint32_t hart;
+};
+
+} // namespace rvpin
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rvpin {
+namespace tools {
+
+// How a cache keeps its access pattern. Both modes use memory fixed at
+// construction, however long the run.
+struct AccessRecordingConfig {
+    enum class Mode {
+        NONE,
+        HISTOGRAM,      // Online time x address bins, see AccessHistogram
+        SAMPLE          // One access in sample_interval, see AccessSampler
+    };
+
+    Mode mode{Mode::NONE};
+    uint32_t time_bins{1000};
+    uint32_t addr_bins{1000};
+    uint32_t sample_interval{1};
+    size_t max_samples{1u << 20};
+};
+
+struct AccessRecord {
+    uint64_t address;
+    uint64_t time;          // Logical time, 1 for the first access
+    bool is_write;
+};
+
+// Access counts binned by time and address as they arrive. Neither range
+// is known up front, so both axes start fine-grained and double their bin
+// width, merging neighbouring bins, whenever an access falls outside.
+// The result is at most twice as coarse as binning the final ranges.
+class AccessHistogram {
+public:
+    AccessHistogram(uint32_t time_bins, uint32_t addr_bins)
+        : time_bins_(std::max(time_bins, 1u)),
+          addr_bins_(std::max(addr_bins, 1u)),
+          counts_(size_t(time_bins_) * addr_bins_) {}
+
+    void record(uint64_t time, uint64_t addr) {
+        if (empty_) {
+            addr_base_ = addr;
+            empty_ = false;
+        }
+        uint64_t t = (time - 1) >> time_shift_;
+        while (t >= time_bins_) {
+            growTime();
+            t = (time - 1) >> time_shift_;
+        }
+        if (addr < addr_base_ || ((addr - addr_base_) >> addr_shift_) >= addr_bins_) {
+            growAddress(addr);
+        }
+        const uint64_t a = (addr - addr_base_) >> addr_shift_;
+        counts_[t * addr_bins_ + a]++;
+        used_time_bins_ = std::max<uint64_t>(used_time_bins_, t + 1);
+    }
+
+    bool empty() const { return empty_; }
+
+    // Columns that have seen accesses so far
+    uint32_t getTimeBins() const { return static_cast<uint32_t>(used_time_bins_); }
+    uint32_t getAddrBins() const { return addr_bins_; }
+
+    // Each bin covers 2^shift accesses or bytes
+    uint32_t getTimeShift() const { return time_shift_; }
+    uint32_t getAddrShift() const { return addr_shift_; }
+    uint64_t getAddrBase() const { return addr_base_; }
+
+    uint64_t count(uint32_t time_bin, uint32_t addr_bin) const {
+        return counts_[size_t(time_bin) * addr_bins_ + addr_bin];
+    }
+
+private:
+    void growTime() {
+        for (uint64_t t = 0; t < time_bins_; t++) {
+            for (uint32_t a = 0; a < addr_bins_; a++) {
+                uint64_t value = counts_[t * addr_bins_ + a];
+                counts_[t * addr_bins_ + a] = 0;
+                counts_[(t >> 1) * addr_bins_ + a] += value;
+            }
+        }
+        time_shift_++;
+        used_time_bins_ = (used_time_bins_ + 1) >> 1;
+    }
+
+    // Double the bin width until [base, base + bins << shift) covers both
+    // the old range and addr. The new base is aligned to the new width, so
+    // every old bin lands in exactly one new bin.
+    void growAddress(uint64_t addr) {
+        const uint64_t old_base = addr_base_;
+        const uint32_t old_shift = addr_shift_;
+        const uint64_t old_last = old_base + ((uint64_t(addr_bins_) << old_shift) - 1);
+        const uint64_t low = std::min(old_base, addr);
+        const uint64_t high = std::max(old_last, addr);
+
+        uint32_t shift = old_shift;
+        uint64_t base = old_base;
+        do {
+            shift++;
+            base = low & ~((uint64_t(1) << shift) - 1);
+        } while (shift < 63 && ((high - base) >> shift) >= addr_bins_);
+
+        std::vector<uint64_t> merged(counts_.size());
+        for (uint64_t t = 0; t < used_time_bins_; t++) {
+            for (uint32_t a = 0; a < addr_bins_; a++) {
+                const uint64_t start = old_base + (uint64_t(a) << old_shift);
+                merged[t * addr_bins_ + ((start - base) >> shift)] += counts_[t * addr_bins_ + a];
+            }
+        }
+        counts_.swap(merged);
+        addr_base_ = base;
+        addr_shift_ = shift;
+    }
+
+    uint32_t time_bins_;
+    uint32_t addr_bins_;
+    uint32_t time_shift_{0};
+    uint32_t addr_shift_{0};
+    uint64_t addr_base_{0};
+    uint64_t used_time_bins_{0};
+    bool empty_{true};
+    std::vector<uint64_t> counts_;
+};
+
+// Keeps one access in every `interval`. When max_samples are stored,
+// every other sample is dropped and the interval doubles, so the samples
+// stay evenly spaced over the whole run.
+class AccessSampler {
+public:
+    AccessSampler(uint32_t interval, size_t max_samples)
+        : interval_(std::max(interval, 1u)),
+          countdown_(interval_),
+          max_samples_(std::max<size_t>((max_samples + 1) & ~size_t(1), 2)) {
+        samples_.reserve(max_samples_);
+    }
+
+    void record(uint64_t time, uint64_t addr, bool is_write) {
+        if (--countdown_ != 0) {
+            return;
+        }
+        if (samples_.size() == max_samples_) {
+            decimate();
+        }
+        countdown_ = interval_;
+        samples_.push_back({addr, time, is_write});
+    }
+
+    const std::vector<AccessRecord>& getSamples() const { return samples_; }
+    uint64_t getInterval() const { return interval_; }
+
+private:
+    // The dropped last sample was interval_ before the current access, so
+    // the current one keeps the doubled spacing
+    void decimate() {
+        for (size_t i = 0; i < samples_.size() / 2; i++) {
+            samples_[i] = samples_[2 * i];
+        }
+        samples_.resize(samples_.size() / 2);
+        interval_ *= 2;
+    }
+
+    uint64_t interval_;
+    uint64_t countdown_;
+    size_t max_samples_;
+    std::vector<AccessRecord> samples_;
+};
+
+} // namespace tools
+} // namespace rvpin
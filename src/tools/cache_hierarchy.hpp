@@ -0,0 +1,278 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "tools/cache_sim.hpp"
+#include "tools/json.hpp"
+
+namespace rvpin {
+namespace tools {
+
+// How lines are shared between a level and the levels above it
+enum class InclusionPolicy {
+    NINE,           // Non-inclusive non-exclusive: fill every level on a miss
+    INCLUSIVE,      // Lower levels hold everything above; evicting back-invalidates
+    EXCLUSIVE       // A line lives in one level; L1 victims move down
+};
+
+struct CacheLevelConfig {
+    std::string name;           // e.g. "L2C"
+    uint32_t sets;
+    uint32_t ways;
+    std::string replacement;    // Replacement policy name, see replacement.hpp
+};
+
+// Private L1I and L1D over a chain of shared lower levels, all with the
+// same line size
+struct CacheHierarchyConfig {
+    uint32_t block_size{64};
+    InclusionPolicy inclusion{InclusionPolicy::NINE};
+    CacheLevelConfig l1i;
+    CacheLevelConfig l1d;
+    std::vector<CacheLevelConfig> lower;     // Closest to the core first
+};
+
+inline InclusionPolicy parseInclusionPolicy(std::string_view name) {
+    if (name == "nine" || name == "non-inclusive") {
+        return InclusionPolicy::NINE;
+    }
+    if (name == "inclusive") {
+        return InclusionPolicy::INCLUSIVE;
+    }
+    if (name == "exclusive") {
+        return InclusionPolicy::EXCLUSIVE;
+    }
+    throw std::invalid_argument("Unknown inclusion policy: " + std::string(name));
+}
+
+inline const char* inclusionPolicyName(InclusionPolicy inclusion) {
+    switch (inclusion) {
+        case InclusionPolicy::INCLUSIVE: return "inclusive";
+        case InclusionPolicy::EXCLUSIVE: return "exclusive";
+        default: return "nine";
+    }
+}
+
+// Reads the cache part of a ChampSim configuration: "block_size" and the
+// "L1I", "L1D", "L2C" and "LLC" objects with "sets", "ways" and
+// "replacement". L2C and LLC are optional. ChampSim has no inclusion
+// setting, so an optional top-level "inclusion" ("nine", "inclusive" or
+// "exclusive") selects it here.
+inline CacheHierarchyConfig parseCacheHierarchyConfig(const JsonValue& json) {
+    CacheHierarchyConfig config;
+    if (const JsonValue* block_size = json.find("block_size")) {
+        config.block_size = static_cast<uint32_t>(block_size->asNumber());
+    }
+    if (const JsonValue* inclusion = json.find("inclusion")) {
+        config.inclusion = parseInclusionPolicy(inclusion->asString());
+    }
+
+    auto level = [&json](const char* name) {
+        const JsonValue* object = json.find(name);
+        if (!object || !object->isObject()) {
+            throw std::invalid_argument(std::string("Missing cache level ") + name);
+        }
+        CacheLevelConfig level{name, 0, 0, "lru"};
+        const JsonValue* sets = object->find("sets");
+        const JsonValue* ways = object->find("ways");
+        if (!sets || !ways) {
+            throw std::invalid_argument(std::string("Cache level ") + name +
+                                        " needs \"sets\" and \"ways\"");
+        }
+        level.sets = static_cast<uint32_t>(sets->asNumber());
+        level.ways = static_cast<uint32_t>(ways->asNumber());
+        if (const JsonValue* replacement = object->find("replacement")) {
+            level.replacement = replacement->asString();
+        }
+        return level;
+    };
+
+    config.l1i = level("L1I");
+    config.l1d = level("L1D");
+    for (const char* name : {"L2C", "LLC"}) {
+        if (json.find(name)) {
+            config.lower.push_back(level(name));
+        }
+    }
+    return config;
+}
+
+inline CacheHierarchyConfig loadCacheHierarchyConfig(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("Failed to open " + path);
+    }
+    std::stringstream text;
+    text << in.rdbuf();
+    return parseCacheHierarchyConfig(JsonValue::parse(text.str()));
+}
+
+// Traffic leaving the last level
+struct MemoryStats {
+    uint64_t reads{0};
+    uint64_t writes{0};
+};
+
+// Multi-level cache model: L1I and L1D over the lower levels in order.
+// Every level is a concrete BasicCache<Policy> held by value, so an
+// access walks the levels with direct calls. Demand misses fetch from the
+// next level down as reads; dirty victims are written back to the next
+// level (or to memory from the last one). The levels of one hierarchy
+// share a replacement policy, see visitCacheHierarchyPolicy.
+//
+// Stats of a lower level count the demand fetches that reached it.
+// Writebacks and, for EXCLUSIVE, victims moving down are fills and do not
+// show up as accesses.
+template <typename Policy>
+class BasicCacheHierarchy {
+public:
+    explicit BasicCacheHierarchy(const CacheHierarchyConfig& config)
+        : inclusion_(config.inclusion),
+          l1i_(levelConfig(config, config.l1i)),
+          l1d_(levelConfig(config, config.l1d)) {
+        names_.push_back(config.l1i.name);
+        names_.push_back(config.l1d.name);
+        lower_.reserve(config.lower.size());
+        for (const CacheLevelConfig& level : config.lower) {
+            lower_.emplace_back(levelConfig(config, level));
+            names_.push_back(level.name);
+        }
+    }
+
+    // Instruction fetch of the line holding pc
+    void fetch(uint64_t pc) { accessL1(l1i_, pc, pc, false, 0); }
+
+    // Data load or store
+    void access(uint64_t pc, uint64_t addr, bool is_write, uint32_t size) {
+        accessL1(l1d_, pc, addr, is_write, size);
+    }
+
+    InclusionPolicy getInclusion() const { return inclusion_; }
+    const BasicCache<Policy>& getL1I() const { return l1i_; }
+    const BasicCache<Policy>& getL1D() const { return l1d_; }
+    size_t getNumLowerLevels() const { return lower_.size(); }
+    const BasicCache<Policy>& getLowerLevel(size_t level) const { return lower_[level]; }
+    const MemoryStats& getMemoryStats() const { return memory_; }
+
+    // L1I, L1D, then the lower levels, matching getLevelName
+    size_t getNumLevels() const { return 2 + lower_.size(); }
+    const std::string& getLevelName(size_t level) const { return names_[level]; }
+    const CacheStats& getLevelStats(size_t level) const {
+        return level == 0 ? l1i_.getStats()
+             : level == 1 ? l1d_.getStats()
+             : lower_[level - 2].getStats();
+    }
+
+private:
+    static CacheConfig levelConfig(const CacheHierarchyConfig& config,
+                                   const CacheLevelConfig& level) {
+        CacheConfig cache{};
+        cache.line_size = config.block_size;
+        cache.size = level.sets * level.ways * config.block_size;
+        cache.associativity = level.ways;
+        cache.write_back = true;
+        cache.write_allocate = true;
+        return cache;
+    }
+
+    void accessL1(BasicCache<Policy>& l1, uint64_t pc, uint64_t addr, bool is_write,
+                  uint32_t size) {
+        const CacheAccessResult result = l1.access(pc, addr, is_write, size);
+        if (!result.hit) {
+            // An exclusive lower level hands its line over, dirty or not
+            if (fetchFrom(0, pc, addr) && inclusion_ == InclusionPolicy::EXCLUSIVE) {
+                l1.insert(addr, true);
+            }
+        }
+        if (result.evicted) {
+            spill(0, result.victim, result.dirty);
+        }
+    }
+
+    // Demand fetch of a line missing above lower_[level]. Returns whether
+    // the line comes back dirty, which only an exclusive level can do.
+    bool fetchFrom(size_t level, uint64_t pc, uint64_t addr) {
+        if (level == lower_.size()) {
+            memory_.reads++;
+            return false;
+        }
+        BasicCache<Policy>& cache = lower_[level];
+        if (inclusion_ == InclusionPolicy::EXCLUSIVE) {
+            const CacheAccessResult result = cache.take(addr, false);
+            return result.hit ? result.dirty : fetchFrom(level + 1, pc, addr);
+        }
+
+        const CacheAccessResult result = cache.access(pc, addr, false, 0);
+        if (!result.hit) {
+            fetchFrom(level + 1, pc, addr);
+        }
+        if (result.evicted) {
+            evict(level, result);
+        }
+        return false;
+    }
+
+    // A line leaving the level above lower_[level]. Exclusive levels take
+    // every victim; the others only see dirty ones, as writebacks.
+    void spill(size_t level, uint64_t addr, bool dirty) {
+        if (level == lower_.size()) {
+            memory_.writes += dirty;
+            return;
+        }
+        if (!dirty && inclusion_ != InclusionPolicy::EXCLUSIVE) {
+            return;
+        }
+        const CacheAccessResult result = lower_[level].insert(addr, dirty);
+        if (result.evicted) {
+            evict(level, result);
+        }
+    }
+
+    // lower_[level] replaced a line. An inclusive hierarchy first removes
+    // it from every level above, picking up any dirty copy.
+    void evict(size_t level, const CacheAccessResult& result) {
+        bool dirty = result.dirty;
+        if (inclusion_ == InclusionPolicy::INCLUSIVE) {
+            dirty |= l1i_.invalidate(result.victim);
+            dirty |= l1d_.invalidate(result.victim);
+            for (size_t above = 0; above < level; above++) {
+                dirty |= lower_[above].invalidate(result.victim);
+            }
+        }
+        spill(level + 1, result.victim, dirty);
+    }
+
+    InclusionPolicy inclusion_;
+    BasicCache<Policy> l1i_;
+    BasicCache<Policy> l1d_;
+    std::vector<BasicCache<Policy>> lower_;
+    std::vector<std::string> names_;
+    MemoryStats memory_;
+};
+
+using CacheHierarchy = BasicCacheHierarchy<LruPolicy>;
+
+// visitReplacementPolicy for a whole hierarchy. Levels share one policy
+// type so the access path stays free of per-level dispatch; a config that
+// mixes policies is rejected.
+template <typename F>
+decltype(auto) visitCacheHierarchyPolicy(const CacheHierarchyConfig& config, F&& f) {
+    const std::string& name = config.l1i.replacement;
+    bool uniform = config.l1d.replacement == name;
+    for (const CacheLevelConfig& level : config.lower) {
+        uniform = uniform && level.replacement == name;
+    }
+    if (!uniform) {
+        throw std::invalid_argument("All cache levels must use the same replacement policy");
+    }
+    return visitReplacementPolicy(name, std::forward<F>(f));
+}
+
+} // namespace tools
+} // namespace rvpin
@@ -1,23 +1,27 @@
 #pragma once
 
 #include <vector>
+#include <algorithm>
 #include <cstdint>
-#include <unordered_map>
-#include <list>
 #include <memory>
-#include <chrono>
+#include <stdexcept>
+#include <string>
+#include "tools/access_pattern.hpp"
 #include "tools/champsim_tracer.hpp"
+#include "tools/replacement.hpp"
 
 namespace rvpin {
 namespace tools {
 
 struct CacheConfig {
-    uint32_t line_size;        // Cache line size in bytes
-    uint32_t size;            // Total cache size in bytes
-    uint32_t associativity;   // Number of ways
-    bool write_back;          // Write-back or write-through
-    bool write_allocate;      // Write-allocate or write-no-allocate
-    std::string trace_file;   // Optional ChampSim trace file
+    uint32_t line_size{0};        // Cache line size in bytes
+    uint32_t size{0};             // Total cache size in bytes
+    uint32_t associativity{0};    // Number of ways
+    bool write_back{false};       // Write-back or write-through
+    bool write_allocate{false};   // Write-allocate or write-no-allocate
+    std::string trace_file{};     // Optional ChampSim trace file, .xz/.zst compress
+    AccessRecordingConfig recording{};  // Optional access histogram or samples
+    ChampSimTracerConfig trace_config{};  // Buffering and compression of trace_file
 };
 
 struct CacheStats {
@@ -28,136 +32,104 @@ struct CacheStats {
     uint64_t read_misses{0};
     uint64_t write_misses{0};
     uint64_t evictions{0};
+    uint64_t writebacks{0};     // Dirty lines evicted from a write-back cache
     
     void clear() {
         reads = writes = read_hits = write_hits = 0;
-        read_misses = write_misses = evictions = 0;
+        read_misses = write_misses = evictions = writebacks = 0;
     }
-};
 
-// Cache line state
-class CacheLine {
-public:
-    CacheLine(uint32_t line_size) : data_(line_size) {}
-    
-    uint64_t tag{0};
-    bool valid{false};
-    bool dirty{false};
-    uint64_t last_access{0};
-    std::vector<uint8_t> data_;
+    // Accumulate the stats of another run, e.g. another slice
+    void merge(const CacheStats& other) {
+        reads += other.reads;
+        writes += other.writes;
+        read_hits += other.read_hits;
+        write_hits += other.write_hits;
+        read_misses += other.read_misses;
+        write_misses += other.write_misses;
+        evictions += other.evictions;
+        writebacks += other.writebacks;
+    }
 };
 
-// Cache set (group of ways)
-class CacheSet {
-public:
-    CacheSet(uint32_t associativity, uint32_t line_size) {
-        ways_.reserve(associativity);
-        for (uint32_t i = 0; i < associativity; i++) {
-            ways_.emplace_back(std::make_unique<CacheLine>(line_size));
-        }
-    }
-    
-    // Allow move construction and assignment
-    CacheSet(CacheSet&&) = default;
-    CacheSet& operator=(CacheSet&&) = default;
-    
-    // Prevent copying
-    CacheSet(const CacheSet&) = delete;
-    CacheSet& operator=(const CacheSet&) = delete;
-    
-    // Returns nullptr if no hit
-    CacheLine* findLine(uint64_t tag) {
-        for (auto& way : ways_) {
-            if (way->valid && way->tag == tag) {
-                return way.get();
-            }
-        }
-        return nullptr;
-    }
-    
-    // Returns evicted line if any
-    std::unique_ptr<CacheLine> insertLine(uint64_t tag, uint32_t line_size) {
-        // First try to find an invalid line
-        for (auto& way : ways_) {
-            if (!way->valid) {
-                way->tag = tag;
-                way->valid = true;
-                way->dirty = false;
-                way->last_access = getCurrentTime();
-                return nullptr;
-            }
-        }
-        
-        // Need to evict - find LRU
-        size_t lru_idx = 0;
-        uint64_t oldest_access = ways_[0]->last_access;
-        
-        for (size_t i = 1; i < ways_.size(); i++) {
-            if (ways_[i]->last_access < oldest_access) {
-                oldest_access = ways_[i]->last_access;
-                lru_idx = i;
-            }
-        }
-        
-        // Create new line
-        auto new_line = std::make_unique<CacheLine>(line_size);
-        new_line->tag = tag;
-        new_line->valid = true;
-        new_line->dirty = false;
-        new_line->last_access = getCurrentTime();
-        
-        // Swap with LRU line
-        std::unique_ptr<CacheLine> evicted = std::move(ways_[lru_idx]);
-        ways_[lru_idx] = std::move(new_line);
-        
-        return evicted;
-    }
-    
-private:
-    uint64_t getCurrentTime() {
-        return std::chrono::steady_clock::now().time_since_epoch().count();
-    }
-    
-    std::vector<std::unique_ptr<CacheLine>> ways_;
+// Outcome of an access or fill. When a valid line was replaced, victim is
+// the address of its first byte and dirty says whether it must be
+// written back.
+struct CacheAccessResult {
+    bool hit{false};
+    bool evicted{false};
+    bool dirty{false};
+    uint64_t victim{0};
 };
 
-class Cache {
+// Set-associative cache model. All per-line state lives in one
+// allocation, laid out as arrays indexed by set * associativity + way,
+// so a lookup scans the set's tags contiguously and the access path never
+// allocates. Line size and set count must be powers of two. Policy is one
+// of the replacement policies in replacement.hpp.
+template <typename Policy>
+class BasicCache {
 public:
-    Cache(const CacheConfig& config) 
+    BasicCache(const CacheConfig& config)
         : config_(config),
           num_sets_((config.size / config.line_size) / config.associativity) {
-        sets_.reserve(num_sets_);
-        for (uint32_t i = 0; i < num_sets_; i++) {
-            sets_.emplace_back(config.associativity, config.line_size);
+        if (!isPowerOfTwo(config.line_size) || !isPowerOfTwo(num_sets_)) {
+            throw std::invalid_argument("Cache line size and set count must be powers of two");
         }
+        line_shift_ = log2(config.line_size);
+        set_shift_ = log2(num_sets_);
+        set_mask_ = num_sets_ - 1;
+
+        // tags | replacement state | dirty bits
+        const size_t lines = size_t(num_sets_) * config.associativity;
+        const size_t policy_words = Policy::stateWords(num_sets_, config.associativity);
+        storage_ = std::make_unique<uint64_t[]>(lines + policy_words + (lines + 63) / 64);
+        tags_ = storage_.get();
+        dirty_ = reinterpret_cast<uint8_t*>(tags_ + lines + policy_words);
+        std::fill(tags_, tags_ + lines, INVALID_TAG);
+        policy_.init(tags_ + lines, num_sets_, config.associativity);
         stats_.clear();
 
         // Initialize ChampSim tracer if trace file is specified
         if (!config.trace_file.empty()) {
-            tracer_ = std::make_unique<ChampSimTracer>(config.trace_file);
+            tracer_ = std::make_unique<ChampSimTracer>(config.trace_file, config.trace_config);
+        }
+
+        const AccessRecordingConfig& recording = config.recording;
+        if (recording.mode == AccessRecordingConfig::Mode::HISTOGRAM) {
+            histogram_ = std::make_unique<AccessHistogram>(recording.time_bins, recording.addr_bins);
+        } else if (recording.mode == AccessRecordingConfig::Mode::SAMPLE) {
+            sampler_ = std::make_unique<AccessSampler>(recording.sample_interval,
+                                                       recording.max_samples);
         }
     }
     
     // Allow move construction and assignment
-    Cache(Cache&&) = default;
-    Cache& operator=(Cache&&) = default;
+    BasicCache(BasicCache&&) = default;
+    BasicCache& operator=(BasicCache&&) = default;
     
     // Prevent copying
-    Cache(const Cache&) = delete;
-    Cache& operator=(const Cache&) = delete;
+    BasicCache(const BasicCache&) = delete;
+    BasicCache& operator=(const BasicCache&) = delete;
     
-    void access(uint64_t pc, uint64_t addr, bool is_write, uint32_t size) {
+    CacheAccessResult access(uint64_t pc, uint64_t addr, bool is_write, uint32_t size) {
         // Record access in ChampSim trace if enabled
         if (tracer_) {
             tracer_->recordAccess(pc, addr, is_write, size);
         }
 
-        uint64_t line_addr = addr / config_.line_size;
-        uint64_t tag = line_addr / num_sets_;
-        uint64_t set_idx = line_addr % num_sets_;
-        
-        // Record access time and pattern
-        access_pattern_.push_back({addr, getCurrentTime(), is_write});
+        const uint64_t line_addr = addr >> line_shift_;
+        const uint64_t tag = line_addr >> set_shift_;
+        const size_t set = line_addr & set_mask_;
+        const size_t base = set * config_.associativity;
+
+        // Record access time and pattern. Time is logical: accesses so far.
+        ++clock_;
+        if (histogram_) {
+            histogram_->record(clock_, addr);
+        } else if (sampler_) {
+            sampler_->record(clock_, addr, is_write);
+        }
         
         if (is_write) {
             stats_.writes++;
@@ -165,67 +137,177 @@ public:
             stats_.reads++;
         }
         
-        CacheLine* line = sets_[set_idx].findLine(tag);
-        
-        if (line) {  // Cache hit
-            line->last_access = getCurrentTime();
+        const size_t way = findWay(base, tag);
+        if (way != NO_WAY) {  // Cache hit
+            policy_.onHit(set, way);
             if (is_write) {
-                line->dirty = true;
+                setDirty(base + way, true);
                 stats_.write_hits++;
             } else {
                 stats_.read_hits++;
             }
-        } else {  // Cache miss
-            if (is_write) {
-                stats_.write_misses++;
-            } else {
-                stats_.read_misses++;
-            }
-            
-            if (is_write && !config_.write_allocate) {
-                // Write-no-allocate: Don't cache the line
-                return;
-            }
-            
-            auto evicted = sets_[set_idx].insertLine(tag, config_.line_size);
-            if (evicted) {
-                stats_.evictions++;
-                if (evicted->dirty && config_.write_back) {
-                    // Would write back to memory here
-                }
-            }
-            
-            if (is_write) {
-                line = sets_[set_idx].findLine(tag);
-                line->dirty = true;
+            return {true};
+        }
+
+        // Cache miss
+        if (is_write) {
+            stats_.write_misses++;
+        } else {
+            stats_.read_misses++;
+        }
+
+        if (is_write && !config_.write_allocate) {
+            // Write-no-allocate: Don't cache the line
+            return {};
+        }
+
+        return fill(set, base, tag, is_write);
+    }
+
+    // Place a line without counting a demand access, e.g. a writeback or
+    // a victim from the level above. A line already present is refreshed
+    // and becomes dirty if the incoming one is.
+    CacheAccessResult insert(uint64_t addr, bool dirty) {
+        const uint64_t line_addr = addr >> line_shift_;
+        const uint64_t tag = line_addr >> set_shift_;
+        const size_t set = line_addr & set_mask_;
+        const size_t base = set * config_.associativity;
+
+        const size_t way = findWay(base, tag);
+        if (way != NO_WAY) {
+            policy_.onHit(set, way);
+            if (dirty) {
+                setDirty(base + way, true);
             }
+            return {true};
+        }
+        return fill(set, base, tag, dirty);
+    }
+
+    // Demand access that never allocates: on a hit the line leaves this
+    // cache and its dirty bit is returned in the result, as when an
+    // exclusive level hands a line up.
+    CacheAccessResult take(uint64_t addr, bool is_write) {
+        const uint64_t line_addr = addr >> line_shift_;
+        const size_t line = findLine(line_addr);
+        if (is_write) {
+            stats_.writes++;
+            (line != NO_WAY ? stats_.write_hits : stats_.write_misses)++;
+        } else {
+            stats_.reads++;
+            (line != NO_WAY ? stats_.read_hits : stats_.read_misses)++;
+        }
+        if (line == NO_WAY) {
+            return {};
+        }
+        CacheAccessResult result{true, false, isDirty(line) && config_.write_back};
+        tags_[line] = INVALID_TAG;
+        return result;
+    }
+
+    // Drop a line if present. Returns true if it held data that still had
+    // to be written back.
+    bool invalidate(uint64_t addr) {
+        const size_t line = findLine(addr >> line_shift_);
+        if (line == NO_WAY) {
+            return false;
         }
+        tags_[line] = INVALID_TAG;
+        return isDirty(line) && config_.write_back;
     }
+
+    bool contains(uint64_t addr) const { return findLine(addr >> line_shift_) != NO_WAY; }
     
+    const CacheConfig& getConfig() const { return config_; }
+    uint32_t getNumSets() const { return num_sets_; }
     const CacheStats& getStats() const { return stats_; }
     
-    struct AccessRecord {
-        uint64_t address;
-        uint64_t time;
-        bool is_write;
-    };
-    
+    using AccessRecord = tools::AccessRecord;
+
+    // Null unless config.recording selects HISTOGRAM
+    const AccessHistogram* getAccessHistogram() const { return histogram_.get(); }
+
+    // Sampled accesses in time order, empty unless config.recording
+    // selects SAMPLE
     const std::vector<AccessRecord>& getAccessPattern() const {
-        return access_pattern_;
+        static const std::vector<AccessRecord> none;
+        return sampler_ ? sampler_->getSamples() : none;
     }
     
 private:
-    uint64_t getCurrentTime() {
-        return std::chrono::steady_clock::now().time_since_epoch().count();
+    // Tags are addresses shifted right by at least one bit, so all ones
+    // never occurs for a valid line
+    static constexpr uint64_t INVALID_TAG = ~0ull;
+    static constexpr size_t NO_WAY = ~size_t(0);
+
+    static bool isPowerOfTwo(uint32_t value) { return value != 0 && (value & (value - 1)) == 0; }
+    static uint32_t log2(uint32_t value) { return 31 - __builtin_clz(value); }
+
+    size_t findWay(size_t base, uint64_t tag) const {
+        const uint64_t* tags = tags_ + base;
+        for (size_t way = 0; way < config_.associativity; way++) {
+            if (tags[way] == tag) {
+                return way;
+            }
+        }
+        return NO_WAY;
     }
-    
+
+    size_t findFreeWay(size_t base) const { return findWay(base, INVALID_TAG); }
+
+    // Index of the line holding line_addr, or NO_WAY
+    size_t findLine(uint64_t line_addr) const {
+        const size_t base = (line_addr & set_mask_) * config_.associativity;
+        const size_t way = findWay(base, line_addr >> set_shift_);
+        return way != NO_WAY ? base + way : NO_WAY;
+    }
+
+    // Allocate tag in the set, replacing a line if the set is full
+    CacheAccessResult fill(size_t set, size_t base, uint64_t tag, bool dirty) {
+        CacheAccessResult result;
+        const size_t free_way = findFreeWay(base);
+        const size_t victim = base + (free_way != NO_WAY ? free_way : policy_.victim(set));
+        if (tags_[victim] != INVALID_TAG) {
+            stats_.evictions++;
+            result.evicted = true;
+            result.dirty = isDirty(victim) && config_.write_back;
+            result.victim = ((tags_[victim] << set_shift_) | set) << line_shift_;
+            if (result.dirty) {
+                stats_.writebacks++;
+            }
+        }
+        tags_[victim] = tag;
+        setDirty(victim, dirty);
+        policy_.onFill(set, victim - base);
+        return result;
+    }
+
+    bool isDirty(size_t line) const { return (dirty_[line >> 3] >> (line & 7)) & 1; }
+    void setDirty(size_t line, bool dirty) {
+        const uint8_t bit = uint8_t(1u << (line & 7));
+        dirty_[line >> 3] = dirty ? (dirty_[line >> 3] | bit) : (dirty_[line >> 3] & ~bit);
+    }
+
     CacheConfig config_;
     uint32_t num_sets_;
-    std::vector<CacheSet> sets_;
+    uint32_t line_shift_{0};
+    uint32_t set_shift_{0};
+    uint64_t set_mask_{0};
+
+    // Per-line state, all carved out of storage_
+    std::unique_ptr<uint64_t[]> storage_;
+    uint64_t* tags_{nullptr};
+    uint8_t* dirty_{nullptr};
+    Policy policy_;
+
+    uint64_t clock_{0};
     CacheStats stats_;
-    std::vector<AccessRecord> access_pattern_;
+    std::unique_ptr<AccessHistogram> histogram_;
+    std::unique_ptr<AccessSampler> sampler_;
     std::unique_ptr<ChampSimTracer> tracer_;
 };
 
+using Cache = BasicCache<LruPolicy>;
+
 } // namespace tools
 } // namespace rvpin
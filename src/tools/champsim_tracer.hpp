@@ -1,62 +1,352 @@
 #pragma once
 
-#include <string>
-#include <fstream>
-#include <vector>
+#include <algorithm>
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
+#include <exception>
+#include <fstream>
 #include <memory>
-#include "tools/cache_sim.hpp"
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "tools/trace_compression.hpp"
 
 namespace rvpin {
 namespace tools {
 
+namespace champsim {
+
+constexpr size_t NUM_INSTR_DESTINATIONS = 2;
+constexpr size_t NUM_INSTR_SOURCES = 4;
+
+// Registers ChampSim gives a meaning to when it classifies branches
+constexpr uint8_t REG_STACK_POINTER = 6;
+constexpr uint8_t REG_FLAGS = 25;
+constexpr uint8_t REG_INSTRUCTION_POINTER = 26;
+
+// ChampSim's input_instr (inc/trace_instruction.h). Register and memory
+// slots are 0 when unused.
+struct InputInstr {
+    uint64_t ip;
+    uint8_t is_branch;
+    uint8_t branch_taken;
+    uint8_t destination_registers[NUM_INSTR_DESTINATIONS];
+    uint8_t source_registers[NUM_INSTR_SOURCES];
+    uint64_t destination_memory[NUM_INSTR_DESTINATIONS];
+    uint64_t source_memory[NUM_INSTR_SOURCES];
+};
+
+static_assert(sizeof(InputInstr) == 64, "InputInstr must match ChampSim's input_instr");
+
+} // namespace champsim
+
+struct ChampSimTracerConfig {
+    size_t buffer_records{size_t(1) << 16};     // Ring size, 4 MB by default
+    bool background{false};         // Write uncompressed traces from a thread
+    unsigned compress_threads{2};   // Workers for .xz and .zst traces
+    int compression_level{-1};      // See compressTraceChunk
+};
+
+// Writes ChampSim input_instr traces. Records are copied into a ring
+// buffer and leave it in chunks of a fixed fraction of the buffer, each
+// with one write.
+//
+// A trace file ending in .xz or .zst is compressed chunk by chunk on
+// compress_threads worker threads while recording continues, and a
+// writer thread appends the results in trace order. Uncompressed traces
+// are written by the recording thread, or by a writer thread with
+// background set. Either way memory stays at the ring plus one compressed
+// buffer per chunk, and the recording thread only waits when the whole
+// ring is still being compressed or written.
 class ChampSimTracer {
 public:
-    ChampSimTracer(const std::string& trace_file) 
-        : trace_file_(trace_file) {
+    static constexpr size_t DEFAULT_BUFFER_RECORDS = size_t(1) << 16;
+
+    explicit ChampSimTracer(const std::string& trace_file,
+                            const ChampSimTracerConfig& config = {})
+        : trace_file_(trace_file),
+          codec_(traceCodecForPath(trace_file)),
+          level_(config.compression_level) {
         trace_stream_.open(trace_file_, std::ios::binary | std::ios::out);
         if (!trace_stream_) {
             throw std::runtime_error("Failed to open trace file: " + trace_file);
         }
+
+        // Power-of-two ring with enough chunks to keep every worker busy
+        // while the recording thread fills the next one
+        const unsigned workers =
+            codec_ == TraceCodec::NONE ? 0 : std::max(config.compress_threads, 1u);
+        size_t chunks = 4;
+        while (chunks < 2 * size_t(workers)) {
+            chunks *= 2;
+        }
+        capacity_ = chunks;
+        while (capacity_ < config.buffer_records) {
+            capacity_ *= 2;
+        }
+        mask_ = capacity_ - 1;
+        chunk_ = capacity_ / chunks;
+        buffer_ = std::make_unique<champsim::InputInstr[]>(capacity_);
+
+        if (workers != 0 || config.background) {
+            writer_ = std::thread([this] { writerLoop(); });
+        }
+        for (unsigned i = 0; i < workers; i++) {
+            compressors_.emplace_back([this] { compressLoop(); });
+        }
     }
 
+    // Writes what is left and stops the threads without throwing; call
+    // close() first to hear about failures
     ~ChampSimTracer() {
-        if (trace_stream_.is_open()) {
-            trace_stream_.close();
+        drain();
+        stopThreads();
+    }
+
+    ChampSimTracer(const ChampSimTracer&) = delete;
+    ChampSimTracer& operator=(const ChampSimTracer&) = delete;
+
+    void record(const champsim::InputInstr& instr) {
+        buffer_[head_ & mask_] = instr;
+        if ((++head_ & (chunk_ - 1)) == 0) {
+            publish();
+        }
+    }
+
+    // One record per memory access, for tools that only see addresses.
+    // ChampSim records carry no access size.
+    void recordAccess(uint64_t pc, uint64_t addr, bool is_write, uint32_t /*size*/) {
+        champsim::InputInstr& instr = buffer_[head_ & mask_];
+        instr = {};
+        instr.ip = pc;
+        if (is_write) {
+            instr.destination_memory[0] = addr;
+        } else {
+            instr.source_memory[0] = addr;
         }
+        if ((++head_ & (chunk_ - 1)) == 0) {
+            publish();
+        }
+    }
+
+    // Write out everything recorded so far. Throws the first error
+    // compressing or writing the trace met.
+    void flush() {
+        drain();
+        trace_stream_.flush();
+        checkStream();
+        rethrowError();
     }
 
-    // Record a memory access for ChampSim trace
-    void recordAccess(uint64_t pc, uint64_t addr, bool is_write, uint32_t size) {
-        // ChampSim trace format:
-        // uint64_t cycle_count
-        // uint64_t instruction_pointer
-        // uint64_t virtual_address
-        // uint8_t is_write
-        // uint32_t write_size
-        
-        uint64_t cycle = getCycleCount();
-        trace_stream_.write(reinterpret_cast<char*>(&cycle), sizeof(cycle));
-        trace_stream_.write(reinterpret_cast<char*>(&pc), sizeof(pc));
-        trace_stream_.write(reinterpret_cast<char*>(&addr), sizeof(addr));
-        uint8_t write = is_write ? 1 : 0;
-        trace_stream_.write(reinterpret_cast<char*>(&write), sizeof(write));
-        trace_stream_.write(reinterpret_cast<char*>(&size), sizeof(size));
+    // Write out everything, stop the threads and close the file. Throws
+    // as flush() does. Nothing may be recorded afterwards.
+    void close() {
+        drain();
+        stopThreads();
+        trace_stream_.close();
+        checkStream();
+        rethrowError();
     }
 
+    uint64_t getRecordCount() const { return head_; }
+    TraceCodec getCodec() const { return codec_; }
+
     // Get the trace file path
     std::string getTraceFile() const {
         return trace_file_;
     }
 
 private:
-    uint64_t getCycleCount() {
-        return cycle_count_++;
+    // Records [begin, end) of the ring on their way to the file
+    struct Job {
+        uint64_t begin{0};
+        uint64_t end{0};
+        bool claimed{false};
+        bool done{false};
+        std::vector<char> data;     // Compressed records
+    };
+
+    // Hand everything recorded on and wait until it is written
+    void drain() {
+        publish();
+        if (writer_.joinable()) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            written_cv_.wait(lock, [this] { return tail_ == published_; });
+        }
+    }
+
+    void stopThreads() {
+        if (!writer_.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        published_cv_.notify_all();
+        done_cv_.notify_one();
+        writer_.join();
+        for (std::thread& compressor : compressors_) {
+            compressor.join();
+        }
+    }
+
+    // Keep the first failed write for flush() and close() to report. The
+    // stream stays failed, so later writes do nothing.
+    void checkStream() {
+        if (!trace_stream_) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_) {
+                error_ = std::make_exception_ptr(
+                    std::runtime_error("Failed to write trace file: " + trace_file_));
+            }
+        }
+    }
+
+    void rethrowError() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (error_) {
+            std::rethrow_exception(std::exchange(error_, nullptr));
+        }
+    }
+
+    // Hand [published_, head_) on, then make sure the next chunk is free
+    // before the caller fills it
+    void publish() {
+        if (!writer_.joinable()) {
+            writeRange(published_, head_);
+            published_ = tail_ = head_;
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (published_ != head_) {
+            Job& job = jobs_.emplace_back();
+            job.begin = published_;
+            job.end = head_;
+            job.done = codec_ == TraceCodec::NONE;
+            published_ = head_;
+            published_cv_.notify_all();
+            done_cv_.notify_one();
+        }
+        written_cv_.wait(lock, [this] { return head_ + chunk_ - tail_ <= capacity_; });
+    }
+
+    void compressLoop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            Job* job = nullptr;
+            published_cv_.wait(lock, [this, &job] {
+                for (Job& candidate : jobs_) {
+                    if (!candidate.claimed) {
+                        job = &candidate;
+                        return true;
+                    }
+                }
+                return stop_;
+            });
+            if (!job) {
+                return;
+            }
+            job->claimed = true;
+            lock.unlock();
+
+            // The range wraps at most once; compress it as one block
+            std::vector<char> data;
+            std::exception_ptr error;
+            try {
+                const uint64_t offset = job->begin & mask_;
+                const uint64_t count = job->end - job->begin;
+                if (offset + count <= capacity_) {
+                    compressTraceChunk(codec_, level_, &buffer_[offset],
+                                       count * sizeof(champsim::InputInstr), data);
+                } else {
+                    std::vector<champsim::InputInstr> linear(count);
+                    const uint64_t first = capacity_ - offset;
+                    std::copy(buffer_.get() + offset, buffer_.get() + capacity_, linear.begin());
+                    std::copy(buffer_.get(), buffer_.get() + (count - first),
+                              linear.begin() + first);
+                    compressTraceChunk(codec_, level_, linear.data(),
+                                       count * sizeof(champsim::InputInstr), data);
+                }
+            } catch (...) {
+                error = std::current_exception();
+            }
+
+            lock.lock();
+            job->data = std::move(data);
+            job->done = true;
+            if (error && !error_) {
+                error_ = error;
+            }
+            done_cv_.notify_one();
+        }
+    }
+
+    void writerLoop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            done_cv_.wait(lock, [this] {
+                return (!jobs_.empty() && jobs_.front().done) || (stop_ && jobs_.empty());
+            });
+            if (jobs_.empty()) {
+                return;
+            }
+            Job job = std::move(jobs_.front());
+            jobs_.pop_front();
+            lock.unlock();
+            if (codec_ == TraceCodec::NONE) {
+                writeRange(job.begin, job.end);
+            } else {
+                trace_stream_.write(job.data.data(), std::streamsize(job.data.size()));
+                checkStream();
+            }
+            lock.lock();
+            tail_ = job.end;
+            written_cv_.notify_one();
+        }
+    }
+
+    // Records [begin, end) of the ring, in at most two writes
+    void writeRange(uint64_t begin, uint64_t end) {
+        while (begin != end) {
+            const uint64_t offset = begin & mask_;
+            const uint64_t count = std::min<uint64_t>(end - begin, capacity_ - offset);
+            trace_stream_.write(reinterpret_cast<const char*>(&buffer_[offset]),
+                                std::streamsize(count * sizeof(champsim::InputInstr)));
+            begin += count;
+        }
+        checkStream();
     }
 
     std::string trace_file_;
     std::ofstream trace_stream_;
-    uint64_t cycle_count_{0};
+    TraceCodec codec_;
+    int level_;
+
+    std::unique_ptr<champsim::InputInstr[]> buffer_;
+    uint64_t capacity_{0};
+    uint64_t mask_{0};
+    uint64_t chunk_{0};
+
+    // Record counts since the start. head_ belongs to the recording
+    // thread; with a writer thread the rest is guarded by mutex_.
+    uint64_t head_{0};          // Recorded
+    uint64_t published_{0};     // Handed to the writer or compressors
+    uint64_t tail_{0};          // Written
+    std::deque<Job> jobs_;      // Published and not yet written, in order
+    std::exception_ptr error_;
+
+    std::thread writer_;
+    std::vector<std::thread> compressors_;
+    std::mutex mutex_;
+    std::condition_variable published_cv_;     // New job, or stop
+    std::condition_variable done_cv_;          // Front job may be ready
+    std::condition_variable written_cv_;       // tail_ advanced
+    bool stop_{false};
 };
 
 } // namespace tools
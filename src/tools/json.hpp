@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cctype>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rvpin {
+namespace tools {
+
+// Minimal JSON reader for configuration files such as
+// champsim_config.json. Parses the whole document into a tree; numbers
+// are kept as doubles, and string escapes other than \n and \t keep just
+// the escaped character (no \u decoding).
+class JsonValue {
+public:
+    enum class Type {
+        NUL,
+        BOOL,
+        NUMBER,
+        STRING,
+        ARRAY,
+        OBJECT
+    };
+
+    using Array = std::vector<JsonValue>;
+    using Object = std::map<std::string, JsonValue, std::less<>>;
+
+    static JsonValue parse(std::string_view text) {
+        size_t pos = 0;
+        JsonValue value = parseValue(text, pos);
+        skipSpace(text, pos);
+        if (pos != text.size()) {
+            fail("trailing characters", pos);
+        }
+        return value;
+    }
+
+    Type getType() const { return type_; }
+    bool isObject() const { return type_ == Type::OBJECT; }
+
+    bool asBool() const { return expect(Type::BOOL).bool_; }
+    double asNumber() const { return expect(Type::NUMBER).number_; }
+    const std::string& asString() const { return expect(Type::STRING).string_; }
+    const Array& asArray() const { return *expect(Type::ARRAY).array_; }
+    const Object& asObject() const { return *expect(Type::OBJECT).object_; }
+
+    // Member of an object, or null if absent or this is not an object
+    const JsonValue* find(std::string_view key) const {
+        if (type_ != Type::OBJECT) {
+            return nullptr;
+        }
+        auto it = object_->find(key);
+        return it != object_->end() ? &it->second : nullptr;
+    }
+
+private:
+    const JsonValue& expect(Type type) const {
+        if (type_ != type) {
+            throw std::runtime_error("JSON value has unexpected type");
+        }
+        return *this;
+    }
+
+    [[noreturn]] static void fail(const char* what, size_t pos) {
+        throw std::runtime_error(std::string("JSON parse error: ") + what + " at offset " +
+                                 std::to_string(pos));
+    }
+
+    static void skipSpace(std::string_view text, size_t& pos) {
+        while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) {
+            pos++;
+        }
+    }
+
+    static bool consume(std::string_view text, size_t& pos, std::string_view token) {
+        if (text.substr(pos, token.size()) != token) {
+            return false;
+        }
+        pos += token.size();
+        return true;
+    }
+
+    static JsonValue parseValue(std::string_view text, size_t& pos) {
+        skipSpace(text, pos);
+        if (pos == text.size()) {
+            fail("unexpected end of input", pos);
+        }
+
+        JsonValue value;
+        const char c = text[pos];
+        if (c == '{') {
+            value.type_ = Type::OBJECT;
+            value.object_ = std::make_shared<Object>();
+            pos++;
+            skipSpace(text, pos);
+            if (consume(text, pos, "}")) {
+                return value;
+            }
+            do {
+                skipSpace(text, pos);
+                std::string key = parseString(text, pos);
+                skipSpace(text, pos);
+                if (!consume(text, pos, ":")) {
+                    fail("expected ':'", pos);
+                }
+                (*value.object_)[std::move(key)] = parseValue(text, pos);
+                skipSpace(text, pos);
+            } while (consume(text, pos, ","));
+            if (!consume(text, pos, "}")) {
+                fail("expected '}'", pos);
+            }
+        } else if (c == '[') {
+            value.type_ = Type::ARRAY;
+            value.array_ = std::make_shared<Array>();
+            pos++;
+            skipSpace(text, pos);
+            if (consume(text, pos, "]")) {
+                return value;
+            }
+            do {
+                value.array_->push_back(parseValue(text, pos));
+                skipSpace(text, pos);
+            } while (consume(text, pos, ","));
+            if (!consume(text, pos, "]")) {
+                fail("expected ']'", pos);
+            }
+        } else if (c == '"') {
+            value.type_ = Type::STRING;
+            value.string_ = parseString(text, pos);
+        } else if (consume(text, pos, "true")) {
+            value.type_ = Type::BOOL;
+            value.bool_ = true;
+        } else if (consume(text, pos, "false")) {
+            value.type_ = Type::BOOL;
+            value.bool_ = false;
+        } else if (consume(text, pos, "null")) {
+            value.type_ = Type::NUL;
+        } else {
+            const std::string rest(text.substr(pos, 64));
+            char* end = nullptr;
+            value.type_ = Type::NUMBER;
+            value.number_ = std::strtod(rest.c_str(), &end);
+            if (end == rest.c_str()) {
+                fail("unexpected character", pos);
+            }
+            pos += end - rest.c_str();
+        }
+        return value;
+    }
+
+    static std::string parseString(std::string_view text, size_t& pos) {
+        if (!consume(text, pos, "\"")) {
+            fail("expected string", pos);
+        }
+        std::string result;
+        while (pos < text.size() && text[pos] != '"') {
+            char c = text[pos++];
+            if (c == '\\' && pos < text.size()) {
+                c = text[pos++];
+                c = c == 'n' ? '\n' : c == 't' ? '\t' : c;
+            }
+            result.push_back(c);
+        }
+        if (!consume(text, pos, "\"")) {
+            fail("unterminated string", pos);
+        }
+        return result;
+    }
+
+    Type type_{Type::NUL};
+    bool bool_{false};
+    double number_{0};
+    std::string string_;
+    std::shared_ptr<Array> array_;
+    std::shared_ptr<Object> object_;
+};
+
+} // namespace tools
+} // namespace rvpin
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "core/engine.hpp"
+
+namespace rvpin {
+namespace tools {
+
+struct ParallelSlicesConfig {
+    uint64_t interval_size{100000000};  // Instructions per slice
+    unsigned threads{0};                // Instrumenting threads, 0 for one per core
+    std::vector<uint64_t> intervals;    // Slices to run, every one if empty
+    std::string checkpoint_prefix{"rvpin"};  // Checkpoints go to prefix.<n>.ckpt
+    bool keep_checkpoints{false};
+};
+
+// Interval index of the program, covering instructions
+// [index * interval_size, (index + 1) * interval_size)
+struct Slice {
+    uint64_t index;
+    std::string checkpoint;     // Where it starts, empty for the program's entry
+    uint32_t hart{0};           // Worker running it, also the engine's hart id
+};
+
+// Worker threads runParallelSlices uses, so Slice::hart is below this.
+// Size PerHart tool state shared between slices with it.
+inline uint32_t parallelSliceThreads(const ParallelSlicesConfig& config) {
+    const unsigned threads =
+        config.threads ? config.threads : std::thread::hardware_concurrency();
+    return std::max(threads, 1u);
+}
+
+// Instrument a program one interval at a time, each in its own Engine on
+// a pool of threads. The calling thread runs the program uninstrumented
+// and checkpoints it at the start of every wanted interval; workers pick
+// the slices up as their checkpoints appear, restore them and run
+// run_slice(engine, slice), which registers the slice's instrumentation,
+// runs the engine and returns what it measured. run_slice is called from
+// several threads at once.
+//
+// Results come back in slice order whatever thread ran them, so folding
+// them from the front merges per-slice results deterministically. Each
+// slice starts with cold tool state, e.g. empty caches. The first
+// exception thrown by run_slice is rethrown here once all threads stop.
+//
+// The pass is a dry run (Engine::setDryRun), so each guest syscall takes
+// effect once, in the slice that runs it. Slices open the files a
+// checkpoint lists for themselves, and their output reaches the standard
+// streams in whatever order they run. The pass waits while as many
+// slices as there are workers are queued, so at most twice that many
+// checkpoints, plus the one being written, are on disk at once.
+template <typename RunSlice>
+auto runParallelSlices(int argc, char* argv[], const ParallelSlicesConfig& config,
+                       RunSlice run_slice)
+    -> std::vector<std::invoke_result_t<RunSlice&, Engine&, const Slice&>> {
+    using Result = std::invoke_result_t<RunSlice&, Engine&, const Slice&>;
+    if (config.interval_size == 0) {
+        throw std::invalid_argument("Slices need a non-zero interval size");
+    }
+
+    std::mutex mutex;
+    std::condition_variable ready_cv;
+    std::condition_variable space_cv;
+    std::deque<Slice> pending;
+    std::vector<std::pair<uint64_t, Result>> results;
+    std::exception_ptr error;
+    bool finished = false;
+
+    auto discard = [&](const std::string& checkpoint) {
+        if (!checkpoint.empty() && !config.keep_checkpoints) {
+            std::remove(checkpoint.c_str());
+        }
+    };
+    auto worker = [&](uint32_t hart) {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            ready_cv.wait(lock, [&] { return !pending.empty() || finished || error; });
+            if (pending.empty() || error) {
+                return;
+            }
+            Slice slice = std::move(pending.front());
+            pending.pop_front();
+            space_cv.notify_one();
+            lock.unlock();
+            slice.hart = hart;
+
+            try {
+                Engine engine;
+                engine.setVerbose(false);
+                engine.setHartId(hart);
+                RegionOptions region;
+                region.restore = slice.checkpoint;
+                region.max_instructions = config.interval_size;
+                if (!engine.initialize(argc, argv, region)) {
+                    throw std::runtime_error("Failed to start slice " +
+                                             std::to_string(slice.index));
+                }
+                Result result = run_slice(engine, slice);
+                discard(slice.checkpoint);
+                lock.lock();
+                results.emplace_back(slice.index, std::move(result));
+            } catch (...) {
+                discard(slice.checkpoint);
+                lock.lock();
+                if (!error) {
+                    error = std::current_exception();
+                }
+                ready_cv.notify_all();
+                space_cv.notify_all();
+            }
+        }
+    };
+
+    const uint32_t threads = parallelSliceThreads(config);
+    std::vector<std::thread> workers;
+    for (uint32_t hart = 0; hart < threads; hart++) {
+        workers.emplace_back(worker, hart);
+    }
+
+    auto publish = [&](uint64_t index, std::string checkpoint) {
+        std::unique_lock<std::mutex> lock(mutex);
+        space_cv.wait(lock, [&] { return pending.size() < threads || error; });
+        if (error) {
+            discard(checkpoint);
+            return;
+        }
+        pending.push_back({index, std::move(checkpoint), 0});
+        ready_cv.notify_one();
+    };
+    auto failed = [&] {
+        std::lock_guard<std::mutex> lock(mutex);
+        return error != nullptr;
+    };
+
+    // Functional pass: uninstrumented, stopping only to checkpoint
+    try {
+        std::vector<uint64_t> wanted = config.intervals;
+        std::sort(wanted.begin(), wanted.end());
+        wanted.erase(std::unique(wanted.begin(), wanted.end()), wanted.end());
+
+        Engine pass;
+        pass.setVerbose(false);
+        pass.setDryRun(true);
+        if (!pass.initialize(argc, argv)) {
+            throw std::runtime_error("Failed to load the program");
+        }
+        uint64_t position = 0;
+        for (size_t next = 0; !failed(); next++) {
+            uint64_t index = next;
+            if (!wanted.empty()) {
+                if (next == wanted.size()) {
+                    break;
+                }
+                index = wanted[next];
+            }
+            if (index == 0) {
+                publish(0, std::string());
+                continue;
+            }
+            if (!pass.fastForward(index * config.interval_size - position)) {
+                break;
+            }
+            position = index * config.interval_size;
+            std::string checkpoint =
+                config.checkpoint_prefix + "." + std::to_string(index) + ".ckpt";
+            if (!pass.saveCheckpoint(checkpoint)) {
+                throw std::runtime_error("Failed to write " + checkpoint);
+            }
+            publish(index, std::move(checkpoint));
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error) {
+            error = std::current_exception();
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+    }
+    ready_cv.notify_all();
+    for (std::thread& thread : workers) {
+        thread.join();
+    }
+    // Slices left queued after a failure
+    for (const Slice& slice : pending) {
+        discard(slice.checkpoint);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    std::sort(results.begin(), results.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+    std::vector<Result> ordered;
+    ordered.reserve(results.size());
+    for (auto& [index, result] : results) {
+        ordered.push_back(std::move(result));
+    }
+    return ordered;
+}
+
+} // namespace tools
+} // namespace rvpin
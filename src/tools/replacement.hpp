@@ -0,0 +1,245 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace rvpin {
+namespace tools {
+
+// Replacement policies for BasicCache. A policy keeps its per-set or
+// per-line state in a block of words that the cache allocates together
+// with its tags (see stateWords). The cache fills invalid ways first and
+// only asks victim() for a full set.
+//
+//   static constexpr const char* NAME;      // As in champsim_config.json
+//   static size_t stateWords(size_t sets, size_t ways);
+//   void init(uint64_t* state, size_t sets, size_t ways);
+//   void onHit(size_t set, size_t way);
+//   void onFill(size_t set, size_t way);
+//   size_t victim(size_t set);
+
+// Least recently used, ordered by a per-cache access counter
+class LruPolicy {
+public:
+    static constexpr const char* NAME = "lru";
+
+    static size_t stateWords(size_t sets, size_t ways) { return sets * ways; }
+
+    void init(uint64_t* state, size_t, size_t ways) {
+        stamps_ = state;
+        ways_ = ways;
+    }
+
+    void onHit(size_t set, size_t way) { stamps_[set * ways_ + way] = ++clock_; }
+    void onFill(size_t set, size_t way) { stamps_[set * ways_ + way] = ++clock_; }
+
+    size_t victim(size_t set) const {
+        const uint64_t* stamps = stamps_ + set * ways_;
+        size_t victim = 0;
+        for (size_t way = 1; way < ways_; way++) {
+            victim = stamps[way] < stamps[victim] ? way : victim;
+        }
+        return victim;
+    }
+
+private:
+    uint64_t* stamps_{nullptr};
+    size_t ways_{0};
+    uint64_t clock_{0};
+};
+
+// Tree pseudo-LRU: ways - 1 bits per set, each pointing at the colder
+// half of its subtree. Needs a power-of-two associativity up to 64.
+class TreePlruPolicy {
+public:
+    static constexpr const char* NAME = "plru";
+
+    static size_t stateWords(size_t sets, size_t) { return sets; }
+
+    void init(uint64_t* state, size_t, size_t ways) {
+        if (ways == 0 || ways > 64 || (ways & (ways - 1)) != 0) {
+            throw std::invalid_argument("Tree-PLRU needs a power-of-two associativity up to 64");
+        }
+        trees_ = state;
+        levels_ = 0;
+        while ((size_t(1) << levels_) < ways) {
+            levels_++;
+        }
+    }
+
+    void onHit(size_t set, size_t way) { touch(set, way); }
+    void onFill(size_t set, size_t way) { touch(set, way); }
+
+    size_t victim(size_t set) const {
+        const uint64_t tree = trees_[set];
+        size_t node = 1;
+        for (uint32_t level = 0; level < levels_; level++) {
+            node = 2 * node + ((tree >> node) & 1);
+        }
+        return node - (size_t(1) << levels_);
+    }
+
+private:
+    // Point every node on the way's path away from it. Nodes are numbered
+    // from 1 like a heap; bit n holds node n.
+    void touch(size_t set, size_t way) {
+        uint64_t tree = trees_[set];
+        size_t node = way + (size_t(1) << levels_);
+        for (uint32_t level = 0; level < levels_; level++) {
+            const uint64_t went_right = node & 1;
+            node >>= 1;
+            tree = (tree & ~(uint64_t(1) << node)) | ((went_right ^ 1) << node);
+        }
+        trees_[set] = tree;
+    }
+
+    uint64_t* trees_{nullptr};
+    uint32_t levels_{0};
+};
+
+// Re-reference interval prediction with 2-bit values (Jaleel et al.,
+// ISCA 2010). Static RRIP inserts with a long interval; bimodal RRIP
+// inserts with a distant one except for one fill in 32.
+template <bool Bimodal>
+class RripPolicy {
+public:
+    static constexpr const char* NAME = Bimodal ? "brrip" : "srrip";
+
+    static size_t stateWords(size_t sets, size_t ways) { return (sets * ways + 7) / 8; }
+
+    void init(uint64_t* state, size_t, size_t ways) {
+        rrpv_ = reinterpret_cast<uint8_t*>(state);
+        ways_ = ways;
+    }
+
+    void onHit(size_t set, size_t way) { rrpv_[set * ways_ + way] = 0; }
+
+    void onFill(size_t set, size_t way) {
+        uint8_t value = MAX_RRPV - 1;
+        if constexpr (Bimodal) {
+            value = (++fills_ & 31) == 0 ? MAX_RRPV - 1 : MAX_RRPV;
+        }
+        rrpv_[set * ways_ + way] = value;
+    }
+
+    // Age the whole set at once by the amount that brings its oldest line
+    // to MAX_RRPV, then take the first line there
+    size_t victim(size_t set) {
+        uint8_t* rrpv = rrpv_ + set * ways_;
+        uint8_t oldest = 0;
+        for (size_t way = 0; way < ways_; way++) {
+            oldest = rrpv[way] > oldest ? rrpv[way] : oldest;
+        }
+        const uint8_t age = MAX_RRPV - oldest;
+        size_t victim = ways_;
+        for (size_t way = ways_; way-- > 0;) {
+            rrpv[way] += age;
+            victim = rrpv[way] == MAX_RRPV ? way : victim;
+        }
+        return victim;
+    }
+
+private:
+    static constexpr uint8_t MAX_RRPV = 3;
+
+    uint8_t* rrpv_{nullptr};
+    size_t ways_{0};
+    uint64_t fills_{0};
+};
+
+using SrripPolicy = RripPolicy<false>;
+using BrripPolicy = RripPolicy<true>;
+
+// Uniformly random victim from a fixed-seed xorshift generator, so runs
+// are reproducible
+class RandomPolicy {
+public:
+    static constexpr const char* NAME = "random";
+
+    static size_t stateWords(size_t, size_t) { return 0; }
+
+    void init(uint64_t*, size_t, size_t ways) { ways_ = ways; }
+    void onHit(size_t, size_t) {}
+    void onFill(size_t, size_t) {}
+
+    size_t victim(size_t) {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 7;
+        state_ ^= state_ << 17;
+        return static_cast<size_t>(((state_ & 0xFFFFFFFF) * ways_) >> 32);
+    }
+
+private:
+    size_t ways_{0};
+    uint64_t state_{0x2545F4914F6CDD1Dull};
+};
+
+// First in, first out, ordered by a per-cache fill counter. Each line
+// keeps the time it was filled, so the order survives invalidations that
+// let a later fill take a way in the middle of the set.
+class FifoPolicy {
+public:
+    static constexpr const char* NAME = "fifo";
+
+    static size_t stateWords(size_t sets, size_t ways) { return sets * ways; }
+
+    void init(uint64_t* state, size_t, size_t ways) {
+        stamps_ = state;
+        ways_ = ways;
+    }
+
+    void onHit(size_t, size_t) {}
+    void onFill(size_t set, size_t way) { stamps_[set * ways_ + way] = ++clock_; }
+
+    size_t victim(size_t set) const {
+        const uint64_t* stamps = stamps_ + set * ways_;
+        size_t victim = 0;
+        for (size_t way = 1; way < ways_; way++) {
+            victim = stamps[way] < stamps[victim] ? way : victim;
+        }
+        return victim;
+    }
+
+private:
+    uint64_t* stamps_{nullptr};
+    size_t ways_{0};
+    uint64_t clock_{0};
+};
+
+// Calls f with a default-constructed policy selected by name, e.g. the
+// "replacement" field of a champsim_config.json cache level:
+//
+//   visitReplacementPolicy(name, [&](auto policy) {
+//       BasicCache<decltype(policy)> cache(config);
+//       ...
+//   });
+//
+// f must return the same type for every policy.
+template <typename F>
+decltype(auto) visitReplacementPolicy(std::string_view name, F&& f) {
+    if (name == LruPolicy::NAME) {
+        return f(LruPolicy{});
+    }
+    if (name == TreePlruPolicy::NAME) {
+        return f(TreePlruPolicy{});
+    }
+    if (name == SrripPolicy::NAME) {
+        return f(SrripPolicy{});
+    }
+    if (name == BrripPolicy::NAME) {
+        return f(BrripPolicy{});
+    }
+    if (name == RandomPolicy::NAME) {
+        return f(RandomPolicy{});
+    }
+    if (name == FifoPolicy::NAME) {
+        return f(FifoPolicy{});
+    }
+    throw std::invalid_argument("Unknown replacement policy: " + std::string(name));
+}
+
+} // namespace tools
+} // namespace rvpin
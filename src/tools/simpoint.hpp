@@ -0,0 +1,361 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace rvpin {
+namespace tools {
+
+// Phase analysis in the style of SimPoint (Sherwood et al., ASPLOS 2002).
+// Execution is cut into fixed instruction intervals, each summarized by a
+// basic block vector: instructions executed per block. Clustering the
+// vectors groups intervals that behave alike, and one interval per
+// cluster, weighted by the cluster size, stands for the whole run.
+
+struct SimPointConfig {
+    uint64_t interval_size{10'000'000};     // Instructions per interval
+    uint32_t max_k{30};                     // Largest cluster count tried
+    uint32_t dimensions{15};                // Random projection size
+    uint32_t max_iterations{100};
+    double bic_threshold{0.9};      // Smallest k scoring this share of the best BIC
+    uint64_t seed{1};
+};
+
+struct SimPoint {
+    uint64_t interval;      // Index of the representative interval
+    uint32_t cluster;
+    double weight;          // Share of all intervals in the cluster
+};
+
+// Collects one basic block vector per interval. Blocks are identified by
+// their start address and numbered in order of first execution; call
+// addBlock each time a block runs.
+class BbvProfiler {
+public:
+    explicit BbvProfiler(uint64_t interval_size) : interval_size_(interval_size) {
+        if (interval_size == 0) {
+            throw std::invalid_argument("SimPoint interval size must be non-zero");
+        }
+    }
+
+    // Dense id for the block at address, to pass to addBlock
+    uint32_t getBlockId(uint64_t address) {
+        auto [it, inserted] =
+            block_ids_.try_emplace(address, static_cast<uint32_t>(block_ids_.size()));
+        if (inserted) {
+            current_.push_back(0);
+        }
+        return it->second;
+    }
+
+    // A block of instructions instructions ran. A block is counted in the
+    // interval it starts in, as SimPoint does.
+    void addBlock(uint32_t id, uint32_t instructions) {
+        if (current_[id] == 0) {
+            touched_.push_back(id);
+        }
+        current_[id] += instructions;
+        executed_ += instructions;
+        if (executed_ >= interval_end_) {
+            endInterval();
+        }
+    }
+
+    // Close the last, partial interval
+    void finish() {
+        if (!touched_.empty()) {
+            endInterval();
+        }
+    }
+
+    uint64_t getIntervalSize() const { return interval_size_; }
+    uint64_t getInstructionCount() const { return executed_; }
+    size_t getNumIntervals() const { return intervals_.size(); }
+    size_t getNumBlocks() const { return block_ids_.size(); }
+
+    // (block id, instructions) pairs of one interval
+    const std::vector<std::pair<uint32_t, uint64_t>>& getVector(size_t interval) const {
+        return intervals_[interval];
+    }
+
+    // SimPoint's .bb format: one "T:id:count :id:count ..." line per
+    // interval, ids starting at 1
+    void writeBbv(const std::string& path) const {
+        std::ofstream out(path);
+        if (!out) {
+            throw std::runtime_error("Failed to open " + path);
+        }
+        for (const auto& vector : intervals_) {
+            out << "T";
+            for (const auto& [id, count] : vector) {
+                out << ":" << id + 1 << ":" << count << " ";
+            }
+            out << "\n";
+        }
+    }
+
+private:
+    void endInterval() {
+        std::sort(touched_.begin(), touched_.end());
+        std::vector<std::pair<uint32_t, uint64_t>>& vector = intervals_.emplace_back();
+        vector.reserve(touched_.size());
+        for (uint32_t id : touched_) {
+            vector.emplace_back(id, current_[id]);
+            current_[id] = 0;
+        }
+        touched_.clear();
+        interval_end_ = (executed_ / interval_size_ + 1) * interval_size_;
+    }
+
+    uint64_t interval_size_;
+    uint64_t executed_{0};
+    uint64_t interval_end_{interval_size_};
+    std::unordered_map<uint64_t, uint32_t> block_ids_;
+    std::vector<uint64_t> current_;     // Counts of the open interval, by id
+    std::vector<uint32_t> touched_;     // Ids with a non-zero count there
+    std::vector<std::vector<std::pair<uint32_t, uint64_t>>> intervals_;
+};
+
+namespace detail {
+
+constexpr double TWO_PI = 6.283185307179586;
+
+// splitmix64, so runs with the same seed pick the same points
+inline uint64_t mix(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+inline double squaredDistance(const double* a, const double* b, size_t dims) {
+    double sum = 0;
+    for (size_t d = 0; d < dims; d++) {
+        const double diff = a[d] - b[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+struct Clustering {
+    std::vector<double> centers;        // k x dims
+    std::vector<uint32_t> assignment;   // Cluster of each point
+    double bic{0};
+};
+
+// Lloyd's k-means from a k-means++ start
+inline Clustering kmeans(const std::vector<double>& points, size_t n, size_t dims, uint32_t k,
+                         uint32_t max_iterations, uint64_t seed) {
+    Clustering result;
+    result.centers.resize(size_t(k) * dims);
+    result.assignment.assign(n, 0);
+    auto uniform = [&seed]() { return (mix(seed++) >> 11) * 0x1.0p-53; };
+
+    std::vector<double> nearest(n, std::numeric_limits<double>::max());
+    size_t first = static_cast<size_t>(uniform() * n);
+    std::copy_n(&points[first * dims], dims, &result.centers[0]);
+    for (uint32_t c = 1; c < k; c++) {
+        double total = 0;
+        for (size_t i = 0; i < n; i++) {
+            nearest[i] = std::min(nearest[i], squaredDistance(&points[i * dims],
+                                                              &result.centers[(c - 1) * dims], dims));
+            total += nearest[i];
+        }
+        double target = uniform() * total;
+        size_t pick = n - 1;
+        for (size_t i = 0; i < n; i++) {
+            target -= nearest[i];
+            if (target <= 0) {
+                pick = i;
+                break;
+            }
+        }
+        std::copy_n(&points[pick * dims], dims, &result.centers[c * dims]);
+    }
+
+    std::vector<double> sums(size_t(k) * dims);
+    std::vector<size_t> sizes(k);
+    for (uint32_t iteration = 0; iteration < max_iterations; iteration++) {
+        bool changed = iteration == 0;
+        for (size_t i = 0; i < n; i++) {
+            uint32_t best = 0;
+            double best_distance = std::numeric_limits<double>::max();
+            for (uint32_t c = 0; c < k; c++) {
+                const double distance = squaredDistance(&points[i * dims],
+                                                        &result.centers[c * dims], dims);
+                if (distance < best_distance) {
+                    best_distance = distance;
+                    best = c;
+                }
+            }
+            changed |= result.assignment[i] != best;
+            result.assignment[i] = best;
+        }
+        if (!changed) {
+            break;
+        }
+
+        std::fill(sums.begin(), sums.end(), 0.0);
+        std::fill(sizes.begin(), sizes.end(), 0);
+        for (size_t i = 0; i < n; i++) {
+            const uint32_t c = result.assignment[i];
+            sizes[c]++;
+            for (size_t d = 0; d < dims; d++) {
+                sums[c * dims + d] += points[i * dims + d];
+            }
+        }
+        for (uint32_t c = 0; c < k; c++) {
+            for (size_t d = 0; d < dims && sizes[c] != 0; d++) {
+                result.centers[c * dims + d] = sums[c * dims + d] / sizes[c];
+            }
+        }
+    }
+
+    // Bayesian information criterion of a spherical Gaussian mixture, as
+    // in X-means (Pelleg and Moore, ICML 2000)
+    std::fill(sizes.begin(), sizes.end(), 0);
+    double distortion = 0;
+    for (size_t i = 0; i < n; i++) {
+        const uint32_t c = result.assignment[i];
+        sizes[c]++;
+        distortion += squaredDistance(&points[i * dims], &result.centers[c * dims], dims);
+    }
+    const double variance = n > k ? std::max(distortion / double(n - k), 1e-12) : 1e-12;
+    double likelihood = 0;
+    for (uint32_t c = 0; c < k; c++) {
+        const double size = double(sizes[c]);
+        if (size == 0) {
+            continue;
+        }
+        likelihood += size * std::log(size) - size * std::log(double(n)) -
+                      size / 2 * std::log(TWO_PI) - size * dims / 2 * std::log(variance) -
+                      (size - 1) / 2;
+    }
+    const double parameters = (k - 1) + double(k) * dims + 1;
+    result.bic = likelihood - parameters / 2 * std::log(double(n));
+    return result;
+}
+
+} // namespace detail
+
+// Cluster the profiled intervals and pick one simulation point per
+// cluster: the interval nearest its center. Vectors are normalized and
+// randomly projected to config.dimensions before clustering. The cluster
+// count is the smallest k up to max_k whose BIC reaches bic_threshold of
+// the way from the worst score to the best.
+inline std::vector<SimPoint> selectSimPoints(const BbvProfiler& profiler,
+                                             const SimPointConfig& config) {
+    const size_t n = profiler.getNumIntervals();
+    if (n == 0) {
+        return {};
+    }
+
+    const size_t dims = config.dimensions;
+    std::vector<double> points(n * dims, 0.0);
+    for (size_t i = 0; i < n; i++) {
+        const auto& vector = profiler.getVector(i);
+        double total = 0;
+        for (const auto& entry : vector) {
+            total += double(entry.second);
+        }
+        for (const auto& [id, count] : vector) {
+            for (size_t d = 0; d < dims; d++) {
+                // Projection entries uniform in [-1, 1), fixed per (block, dimension)
+                const uint64_t bits = detail::mix(config.seed ^ (uint64_t(id) * dims + d));
+                const double weight = (bits >> 11) * 0x1.0p-52 - 1.0;
+                points[i * dims + d] += weight * double(count) / total;
+            }
+        }
+    }
+
+    const uint32_t max_k = static_cast<uint32_t>(std::min<size_t>(config.max_k, n));
+    std::vector<detail::Clustering> clusterings;
+    double best_bic = -std::numeric_limits<double>::max();
+    double worst_bic = std::numeric_limits<double>::max();
+    for (uint32_t k = 1; k <= std::max(max_k, 1u); k++) {
+        clusterings.push_back(detail::kmeans(points, n, dims, k, config.max_iterations,
+                                             config.seed + k));
+        best_bic = std::max(best_bic, clusterings.back().bic);
+        worst_bic = std::min(worst_bic, clusterings.back().bic);
+    }
+    const detail::Clustering* chosen = &clusterings.back();
+    for (const detail::Clustering& clustering : clusterings) {
+        if (clustering.bic >= worst_bic + config.bic_threshold * (best_bic - worst_bic)) {
+            chosen = &clustering;
+            break;
+        }
+    }
+
+    const size_t k = chosen->centers.size() / dims;
+    std::vector<size_t> sizes(k, 0);
+    std::vector<size_t> representative(k, n);
+    std::vector<double> closest(k, std::numeric_limits<double>::max());
+    for (size_t i = 0; i < n; i++) {
+        const uint32_t c = chosen->assignment[i];
+        sizes[c]++;
+        const double distance = detail::squaredDistance(&points[i * dims],
+                                                        &chosen->centers[c * dims], dims);
+        if (distance < closest[c]) {
+            closest[c] = distance;
+            representative[c] = i;
+        }
+    }
+
+    std::vector<SimPoint> simpoints;
+    for (size_t c = 0; c < k; c++) {
+        if (sizes[c] != 0) {
+            simpoints.push_back({representative[c], static_cast<uint32_t>(simpoints.size()),
+                                 double(sizes[c]) / n});
+        }
+    }
+    std::sort(simpoints.begin(), simpoints.end(),
+              [](const SimPoint& a, const SimPoint& b) { return a.interval < b.interval; });
+    return simpoints;
+}
+
+// SimPoint's output files: "<interval> <cluster>" lines in
+// prefix.simpoints and "<weight> <cluster>" lines in prefix.weights
+inline void writeSimPoints(const std::string& prefix, const std::vector<SimPoint>& simpoints) {
+    std::ofstream points(prefix + ".simpoints");
+    std::ofstream weights(prefix + ".weights");
+    if (!points || !weights) {
+        throw std::runtime_error("Failed to write " + prefix + ".simpoints/.weights");
+    }
+    for (const SimPoint& point : simpoints) {
+        points << point.interval << " " << point.cluster << "\n";
+        weights << point.weight << " " << point.cluster << "\n";
+    }
+}
+
+inline std::vector<SimPoint> readSimPoints(const std::string& prefix) {
+    std::ifstream points(prefix + ".simpoints");
+    std::ifstream weights(prefix + ".weights");
+    if (!points || !weights) {
+        throw std::runtime_error("Failed to read " + prefix + ".simpoints/.weights");
+    }
+    std::unordered_map<uint32_t, double> weight_by_cluster;
+    double weight;
+    uint32_t cluster;
+    while (weights >> weight >> cluster) {
+        weight_by_cluster[cluster] = weight;
+    }
+    std::vector<SimPoint> simpoints;
+    uint64_t interval;
+    while (points >> interval >> cluster) {
+        simpoints.push_back({interval, cluster, weight_by_cluster[cluster]});
+    }
+    std::sort(simpoints.begin(), simpoints.end(),
+              [](const SimPoint& a, const SimPoint& b) { return a.interval < b.interval; });
+    return simpoints;
+}
+
+} // namespace tools
+} // namespace rvpin
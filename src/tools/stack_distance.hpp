@@ -0,0 +1,245 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+#include "tools/cache_sim.hpp"
+
+namespace rvpin {
+namespace tools {
+
+// Geometries covered by one StackDistanceProfiler: every power-of-two set
+// count from min_sets to max_sets, each with 1 to max_associativity ways
+struct StackDistanceConfig {
+    uint32_t line_size{64};
+    uint32_t min_sets{1};
+    uint32_t max_sets{1024};
+    uint32_t max_associativity{16};
+};
+
+// Single-pass LRU simulation of many cache geometries (Mattson et al.,
+// 1970). An access hits in an LRU cache with A ways iff fewer than A
+// distinct lines of its set were touched since the line's previous
+// access, so one stack-distance histogram per set count gives the stats
+// of every associativity at once.
+//
+// Distances are counted with a Fenwick tree per set (Bennett and Kruskal,
+// 1975): each access takes the next slot of its set's local clock, and
+// the tree marks the slot of each line's latest access, so the distance is
+// the number of marks after the line's previous slot. When a set runs out
+// of slots, its live slots are renumbered, so memory is bounded by the
+// distinct lines rather than the trace length.
+//
+// Results are those of a write-back, write-allocate BasicCache<LruPolicy>.
+class StackDistanceProfiler {
+public:
+    explicit StackDistanceProfiler(const StackDistanceConfig& config)
+        : config_(config) {
+        if (!isPowerOfTwo(config.line_size) || !isPowerOfTwo(config.min_sets) ||
+            !isPowerOfTwo(config.max_sets) || config.min_sets > config.max_sets ||
+            config.max_associativity == 0) {
+            throw std::invalid_argument("Invalid stack distance configuration");
+        }
+        line_shift_ = log2(config.line_size);
+        for (uint32_t sets = config.min_sets; sets && sets <= config.max_sets; sets *= 2) {
+            Geometry geometry;
+            geometry.sets.resize(sets);
+            geometry.read_hist.resize(config.max_associativity);
+            geometry.write_hist.resize(config.max_associativity);
+            geometries_.push_back(std::move(geometry));
+        }
+    }
+
+    void access(uint64_t addr, bool is_write) {
+        const uint64_t line_addr = addr >> line_shift_;
+        if (is_write) {
+            writes_++;
+        } else {
+            reads_++;
+        }
+
+        const size_t num_geometries = geometries_.size();
+        auto [it, cold] = lines_.try_emplace(line_addr, static_cast<uint32_t>(lines_.size()));
+        const uint32_t line = it->second;
+        if (cold) {
+            slots_.resize(slots_.size() + num_geometries);
+            (is_write ? write_cold_ : read_cold_)++;
+        }
+
+        uint32_t* slots = &slots_[size_t(line) * num_geometries];
+        for (size_t g = 0; g < num_geometries; g++) {
+            Geometry& geometry = geometries_[g];
+            SetState& set = geometry.sets[line_addr & (geometry.sets.size() - 1)];
+            if (set.clock == set.slot_line.size()) {
+                compact(set, g);
+            }
+            if (cold) {
+                set.lines++;
+            } else {
+                const uint32_t last = slots[g];
+                const uint32_t distance = prefix(set, set.clock) - prefix(set, last + 1);
+                if (distance < config_.max_associativity) {
+                    (is_write ? geometry.write_hist : geometry.read_hist)[distance]++;
+                }
+                add(set, last, -1);
+            }
+            const uint32_t slot = set.clock++;
+            add(set, slot, 1);
+            set.slot_line[slot] = line;
+            slots[g] = slot;
+        }
+    }
+
+    const StackDistanceConfig& getConfig() const { return config_; }
+
+    // Set counts covered, smallest first
+    std::vector<uint32_t> getSetCounts() const {
+        std::vector<uint32_t> counts;
+        for (const Geometry& geometry : geometries_) {
+            counts.push_back(static_cast<uint32_t>(geometry.sets.size()));
+        }
+        return counts;
+    }
+
+    // The BasicCache configuration a (sets, ways) result corresponds to
+    CacheConfig getCacheConfig(uint32_t sets, uint32_t ways) const {
+        CacheConfig cache{};
+        cache.line_size = config_.line_size;
+        cache.size = sets * ways * config_.line_size;
+        cache.associativity = ways;
+        cache.write_back = true;
+        cache.write_allocate = true;
+        return cache;
+    }
+
+    // Stats an LRU cache of this geometry would have reported. Writebacks
+    // depend on more than reuse distance and are left at zero.
+    CacheStats getStats(uint32_t sets, uint32_t ways) const {
+        const Geometry& geometry = findGeometry(sets);
+        if (ways == 0 || ways > config_.max_associativity) {
+            throw std::out_of_range("Associativity outside the profiled range");
+        }
+
+        CacheStats stats;
+        stats.reads = reads_;
+        stats.writes = writes_;
+        for (uint32_t distance = 0; distance < ways; distance++) {
+            stats.read_hits += geometry.read_hist[distance];
+            stats.write_hits += geometry.write_hist[distance];
+        }
+        stats.read_misses = reads_ - stats.read_hits;
+        stats.write_misses = writes_ - stats.write_hits;
+
+        // Every miss fills a line; those that did not find a free way
+        // evicted one
+        uint64_t resident = 0;
+        for (const SetState& set : geometry.sets) {
+            resident += std::min(set.lines, ways);
+        }
+        stats.evictions = stats.read_misses + stats.write_misses - resident;
+        return stats;
+    }
+
+    double getMissRatio(uint32_t sets, uint32_t ways) const {
+        const CacheStats stats = getStats(sets, ways);
+        const uint64_t accesses = stats.reads + stats.writes;
+        return accesses ? double(stats.read_misses + stats.write_misses) / accesses : 0.0;
+    }
+
+    uint64_t getAccesses() const { return reads_ + writes_; }
+    uint64_t getColdMisses() const { return read_cold_ + write_cold_; }
+
+private:
+    static constexpr uint32_t INITIAL_SLOTS = 16;
+
+    // Per-set clock and Fenwick tree over its slots. tree is 1-based;
+    // slot_line maps a slot to the line that took it.
+    struct SetState {
+        std::vector<uint32_t> tree;
+        std::vector<uint32_t> slot_line;
+        uint32_t clock{0};
+        uint32_t lines{0};      // Distinct lines seen, all marked in tree
+    };
+
+    struct Geometry {
+        std::vector<SetState> sets;
+        std::vector<uint64_t> read_hist;    // Hits at each stack distance
+        std::vector<uint64_t> write_hist;
+    };
+
+    static bool isPowerOfTwo(uint32_t value) { return value != 0 && (value & (value - 1)) == 0; }
+    static uint32_t log2(uint32_t value) { return 31 - __builtin_clz(value); }
+
+    // Marks in slots [0, end)
+    static uint32_t prefix(const SetState& set, uint32_t end) {
+        uint32_t sum = 0;
+        for (uint32_t i = end; i > 0; i &= i - 1) {
+            sum += set.tree[i];
+        }
+        return sum;
+    }
+
+    static void add(SetState& set, uint32_t slot, int32_t delta) {
+        const uint32_t size = static_cast<uint32_t>(set.slot_line.size());
+        for (uint32_t i = slot + 1; i <= size; i += i & (0 - i)) {
+            set.tree[i] += delta;
+        }
+    }
+
+    // Renumber the live slots of a full set from zero, keeping their
+    // order, and grow it if more than half the slots stay live
+    void compact(SetState& set, size_t g) {
+        const size_t num_geometries = geometries_.size();
+        uint32_t live = 0;
+        for (uint32_t slot = 0; slot < set.clock; slot++) {
+            const uint32_t line = set.slot_line[slot];
+            uint32_t& line_slot = slots_[size_t(line) * num_geometries + g];
+            if (line_slot == slot) {
+                line_slot = live;
+                set.slot_line[live++] = line;
+            }
+        }
+        set.clock = live;
+
+        size_t size = std::max<size_t>(set.slot_line.size(), INITIAL_SLOTS);
+        while (live * 2 > size) {
+            size *= 2;
+        }
+        set.slot_line.resize(size);
+
+        // Slots [0, live) are marked; a Fenwick node covers lowbit(i) slots
+        set.tree.assign(size + 1, 0);
+        for (uint32_t i = 1; i <= size; i++) {
+            const uint32_t first = i - (i & (0 - i));
+            set.tree[i] = first < live ? std::min(i, live) - first : 0;
+        }
+    }
+
+    const Geometry& findGeometry(uint32_t sets) const {
+        for (const Geometry& geometry : geometries_) {
+            if (geometry.sets.size() == sets) {
+                return geometry;
+            }
+        }
+        throw std::out_of_range("Set count outside the profiled range");
+    }
+
+    StackDistanceConfig config_;
+    uint32_t line_shift_{0};
+    std::vector<Geometry> geometries_;
+
+    // Line address -> dense line index; slots_ holds each line's latest
+    // slot for every geometry, line-major
+    std::unordered_map<uint64_t, uint32_t> lines_;
+    std::vector<uint32_t> slots_;
+
+    uint64_t reads_{0};
+    uint64_t writes_{0};
+    uint64_t read_cold_{0};
+    uint64_t write_cold_{0};
+};
+
+} // namespace tools
+} // namespace rvpin
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef RVPIN_HAVE_LZMA
+#include <lzma.h>
+#endif
+#ifdef RVPIN_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace rvpin {
+namespace tools {
+
+enum class TraceCodec {
+    NONE,
+    XZ,
+    ZSTD
+};
+
+// Codec named by a trace file's extension: .xz or .zst, otherwise none.
+// Throws if the codec was not available at build time.
+inline TraceCodec traceCodecForPath(std::string_view path) {
+    auto endsWith = [path](std::string_view suffix) {
+        return path.size() >= suffix.size() &&
+               path.substr(path.size() - suffix.size()) == suffix;
+    };
+    if (endsWith(".xz")) {
+#ifndef RVPIN_HAVE_LZMA
+        throw std::runtime_error("Built without liblzma, cannot write " + std::string(path));
+#endif
+        return TraceCodec::XZ;
+    }
+    if (endsWith(".zst")) {
+#ifndef RVPIN_HAVE_ZSTD
+        throw std::runtime_error("Built without libzstd, cannot write " + std::string(path));
+#endif
+        return TraceCodec::ZSTD;
+    }
+    return TraceCodec::NONE;
+}
+
+// Compress one chunk into out as a complete .xz stream or zstd frame.
+// Both formats allow streams to be concatenated, so chunks compressed
+// independently and written in order decompress to the original data.
+// level < 0 picks a default suited to streaming traces: xz preset 1,
+// zstd level 3. Without either library, level goes unused.
+inline void compressTraceChunk(TraceCodec codec, [[maybe_unused]] int level,
+                               const void* data, size_t size, std::vector<char>& out) {
+    switch (codec) {
+        case TraceCodec::XZ: {
+#ifdef RVPIN_HAVE_LZMA
+            out.resize(lzma_stream_buffer_bound(size));
+            size_t out_pos = 0;
+            const uint32_t preset = level < 0 ? 1 : static_cast<uint32_t>(level);
+            lzma_ret ret = lzma_easy_buffer_encode(preset, LZMA_CHECK_CRC64, nullptr,
+                                                   static_cast<const uint8_t*>(data), size,
+                                                   reinterpret_cast<uint8_t*>(out.data()),
+                                                   &out_pos, out.size());
+            if (ret != LZMA_OK) {
+                throw std::runtime_error("xz compression failed");
+            }
+            out.resize(out_pos);
+            return;
+#else
+            break;
+#endif
+        }
+        case TraceCodec::ZSTD: {
+#ifdef RVPIN_HAVE_ZSTD
+            out.resize(ZSTD_compressBound(size));
+            const size_t written = ZSTD_compress(out.data(), out.size(), data, size,
+                                                 level < 0 ? 3 : level);
+            if (ZSTD_isError(written)) {
+                throw std::runtime_error(std::string("zstd compression failed: ") +
+                                         ZSTD_getErrorName(written));
+            }
+            out.resize(written);
+            return;
+#else
+            break;
+#endif
+        }
+        case TraceCodec::NONE:
+            break;
+    }
+    out.assign(static_cast<const char*>(data), static_cast<const char*>(data) + size);
+}
+
+} // namespace tools
+} // namespace rvpin
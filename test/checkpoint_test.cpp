@@ -0,0 +1,41 @@
+#include <catch2/catch.hpp>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "core/engine.hpp"
+#include "guest.hpp"
+
+using namespace rvpin;
+using namespace rvpin::test;
+
+TEST_CASE("A heap grown with brk survives a checkpoint", "[checkpoint]") {
+    // Grow the heap twice by amounts that are not whole pages, store into
+    // its second page, and after the checkpoint exit with what is there
+    std::vector<uint32_t> code = growHeap();
+    code.insert(code.end(), {
+        add(T1, S0, T0), addi(T2, ZERO, 42), sd(T2, 800, T1),
+        // Checkpoint here
+        ld(A0, 800, T1),
+        addi(A7, ZERO, syscall::SYS_EXIT), ECALL,
+    });
+    const uint64_t before_load = 13;
+    const std::string program = tempPath("rvpin_brk_guest");
+    const std::string checkpoint = tempPath("rvpin_brk.ckpt");
+    writeGuest(program, code);
+
+    {
+        Engine engine;
+        REQUIRE(startGuest(engine, program));
+        REQUIRE(engine.fastForward(before_load));
+        REQUIRE(engine.saveCheckpoint(checkpoint));
+        REQUIRE(engine.run() == 42);
+    }
+
+    Engine restored;
+    REQUIRE(startGuest(restored, program, checkpoint));
+    CHECK(restored.getState().instret == before_load);
+    CHECK(restored.run() == 42);
+
+    std::remove(checkpoint.c_str());
+    std::remove(program.c_str());
+}
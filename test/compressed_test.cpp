@@ -0,0 +1,132 @@
+#include <catch2/catch.hpp>
+#include <cstdint>
+#include <iterator>
+#include "core/decoder.hpp"
+
+using rvpin::Decoder;
+
+namespace {
+
+// A parcel and the 32-bit instruction it stands for, as the assembler
+// writes them
+struct Expansion {
+    uint16_t parcel;
+    uint32_t expanded;
+    const char* text;
+};
+
+constexpr Expansion QUADRANT_0[] = {
+    {0x0808, 0x01010513, "c.addi4spn a0, sp, 16"},
+    {0x2588, 0x0085b507, "c.fld fa0, 8(a1)"},
+    {0x415c, 0x00452783, "c.lw a5, 4(a0)"},
+    {0x6588, 0x0085b503, "c.ld a0, 8(a1)"},
+    {0xa588, 0x00a5b427, "c.fsd fa0, 8(a1)"},
+    {0xc15c, 0x00f52223, "c.sw a5, 4(a0)"},
+    {0xe588, 0x00a5b423, "c.sd a0, 8(a1)"},
+};
+
+constexpr Expansion QUADRANT_1[] = {
+    {0x0001, 0x00000013, "c.nop"},
+    {0x157d, 0xfff50513, "c.addi a0, -1"},
+    {0x1141, 0xff010113, "c.addi sp, -16"},
+    {0x2505, 0x0015051b, "c.addiw a0, 1"},
+    {0x4515, 0x00500513, "c.li a0, 5"},
+    {0x717d, 0xff010113, "c.addi16sp sp, -16"},
+    {0x6505, 0x00001537, "c.lui a0, 1"},
+    {0x8105, 0x00155513, "c.srli a0, 1"},
+    {0x8505, 0x40155513, "c.srai a0, 1"},
+    {0x893d, 0x00f57513, "c.andi a0, 15"},
+    {0x8d0d, 0x40b50533, "c.sub a0, a1"},
+    {0x8d2d, 0x00b54533, "c.xor a0, a1"},
+    {0x8d4d, 0x00b56533, "c.or a0, a1"},
+    {0x8d6d, 0x00b57533, "c.and a0, a1"},
+    {0x9d0d, 0x40b5053b, "c.subw a0, a1"},
+    {0x9d2d, 0x00b5053b, "c.addw a0, a1"},
+    {0xa001, 0x0000006f, "c.j 0"},
+    {0xc501, 0x00050463, "c.beqz a0, 8"},
+    {0xe501, 0x00051463, "c.bnez a0, 8"},
+};
+
+constexpr Expansion QUADRANT_2[] = {
+    {0x050a, 0x00251513, "c.slli a0, 2"},
+    {0x2522, 0x00813507, "c.fldsp fa0, 8(sp)"},
+    {0x4512, 0x00412503, "c.lwsp a0, 4(sp)"},
+    {0x60a2, 0x00813083, "c.ldsp ra, 8(sp)"},
+    {0x8082, 0x00008067, "c.jr ra"},
+    {0x852e, 0x00b00533, "c.mv a0, a1"},
+    {0x9002, 0x00100073, "c.ebreak"},
+    {0x9502, 0x000500e7, "c.jalr a0"},
+    {0x952e, 0x00b50533, "c.add a0, a1"},
+    {0xa42a, 0x00a13427, "c.fsdsp fa0, 8(sp)"},
+    {0xc22a, 0x00a12223, "c.swsp a0, 4(sp)"},
+    {0xe406, 0x00113423, "c.sdsp ra, 8(sp)"},
+};
+
+// HINTs expand to base instructions without architectural effect
+constexpr Expansion HINTS[] = {
+    {0x0005, 0x00100013, "c.nop 1"},
+    {0x4005, 0x00100013, "c.li zero, 1"},
+    {0x0002 | (1 << 2), 0x00101013, "c.slli zero, 1"},
+    {0x8006 | (1 << 12), 0x00100033, "c.add zero, ra"},
+};
+
+// Reserved and illegal parcels, and parcels of longer instructions
+constexpr uint16_t INVALID[] = {
+    0x0000,     // All zeros, defined illegal
+    0x0004,     // c.addi4spn with a zero immediate
+    0x8000,     // Quadrant 0 funct3 4, reserved
+    0x2001,     // c.addiw to x0
+    0x6101,     // c.addi16sp with a zero immediate
+    0x6501,     // c.lui with a zero immediate
+    0x9c41,     // Quadrant 1 arithmetic, reserved
+    0x9c61,     // Quadrant 1 arithmetic, reserved
+    0x4002,     // c.lwsp to x0
+    0x6002,     // c.ldsp to x0
+    0x8002,     // c.jr through x0
+    0x0003,     // Low bits 11: a 32-bit instruction
+    0xffff,
+};
+
+void checkExpansions(const Expansion* begin, const Expansion* end) {
+    for (const Expansion* e = begin; e != end; ++e) {
+        INFO(e->text);
+        CHECK(Decoder::expandCompressed(e->parcel) == e->expanded);
+        CHECK(Decoder::lookup(e->expanded) >= 0);
+    }
+}
+
+} // namespace
+
+TEST_CASE("RVC quadrant 0 expands to loads, stores and addi", "[compressed]") {
+    checkExpansions(std::begin(QUADRANT_0), std::end(QUADRANT_0));
+}
+
+TEST_CASE("RVC quadrant 1 expands to arithmetic, jumps and branches", "[compressed]") {
+    checkExpansions(std::begin(QUADRANT_1), std::end(QUADRANT_1));
+}
+
+TEST_CASE("RVC quadrant 2 expands to stack accesses, moves and jumps", "[compressed]") {
+    checkExpansions(std::begin(QUADRANT_2), std::end(QUADRANT_2));
+}
+
+TEST_CASE("RVC hints expand to instructions without effect", "[compressed]") {
+    checkExpansions(std::begin(HINTS), std::end(HINTS));
+}
+
+TEST_CASE("Reserved and illegal RVC parcels do not expand", "[compressed]") {
+    for (uint16_t parcel : INVALID) {
+        INFO("parcel 0x" << std::hex << parcel);
+        CHECK(Decoder::expandCompressed(parcel) == 0);
+    }
+}
+
+TEST_CASE("Every RVC expansion is a 32-bit instruction the decoder knows", "[compressed]") {
+    for (uint32_t parcel = 0; parcel < 0x10000; parcel++) {
+        const uint32_t expanded = Decoder::expandCompressed(static_cast<uint16_t>(parcel));
+        if (expanded != 0) {
+            INFO("parcel 0x" << std::hex << parcel);
+            REQUIRE((expanded & 3) == 3);
+            REQUIRE(Decoder::lookup(expanded) >= 0);
+        }
+    }
+}
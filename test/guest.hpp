@@ -0,0 +1,208 @@
+#pragma once
+
+#include <catch2/catch.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+#include "core/engine.hpp"
+#include "core/syscall.hpp"
+
+// Tiny RISC-V guests for engine tests, assembled by hand so the tests need
+// no cross toolchain. The code is one RWX segment at GUEST_BASE, and the
+// ELF is written to a file for Engine::initialize to load.
+
+namespace rvpin {
+namespace test {
+
+constexpr uint64_t GUEST_BASE = 0x10000;
+
+// Registers by ABI name
+enum Reg : uint32_t {
+    ZERO = 0, RA = 1, SP = 2, T0 = 5, T1 = 6, T2 = 7, S0 = 8, S1 = 9,
+    A0 = 10, A1 = 11, A2 = 12, A3 = 13, A4 = 14, A5 = 15, A7 = 17
+};
+
+inline uint32_t addi(uint32_t rd, uint32_t rs1, int32_t imm) {
+    return (uint32_t(imm & 0xfff) << 20) | (rs1 << 15) | (rd << 7) | 0x13;
+}
+
+inline uint32_t slti(uint32_t rd, uint32_t rs1, int32_t imm) {
+    return addi(rd, rs1, imm) | (2 << 12);
+}
+
+inline uint32_t sltiu(uint32_t rd, uint32_t rs1, int32_t imm) {
+    return addi(rd, rs1, imm) | (3 << 12);
+}
+
+inline uint32_t addiw(uint32_t rd, uint32_t rs1, int32_t imm) {
+    return (uint32_t(imm & 0xfff) << 20) | (rs1 << 15) | (rd << 7) | 0x1b;
+}
+
+inline uint32_t slli(uint32_t rd, uint32_t rs1, uint32_t shamt) {
+    return (shamt << 20) | (rs1 << 15) | (1 << 12) | (rd << 7) | 0x13;
+}
+
+inline uint32_t lui(uint32_t rd, int32_t imm) {
+    return (uint32_t(imm & 0xfffff) << 12) | (rd << 7) | 0x37;
+}
+
+inline uint32_t auipc(uint32_t rd, int32_t imm) {
+    return (uint32_t(imm & 0xfffff) << 12) | (rd << 7) | 0x17;
+}
+
+inline uint32_t add(uint32_t rd, uint32_t rs1, uint32_t rs2) {
+    return (rs2 << 20) | (rs1 << 15) | (rd << 7) | 0x33;
+}
+
+inline uint32_t sub(uint32_t rd, uint32_t rs1, uint32_t rs2) {
+    return add(rd, rs1, rs2) | 0x40000000;
+}
+
+inline uint32_t slt(uint32_t rd, uint32_t rs1, uint32_t rs2) {
+    return add(rd, rs1, rs2) | (2 << 12);
+}
+
+inline uint32_t sltu(uint32_t rd, uint32_t rs1, uint32_t rs2) {
+    return add(rd, rs1, rs2) | (3 << 12);
+}
+
+inline uint32_t lw(uint32_t rd, int32_t offset, uint32_t rs1) {
+    return (uint32_t(offset & 0xfff) << 20) | (rs1 << 15) | (2 << 12) | (rd << 7) | 0x03;
+}
+
+inline uint32_t ld(uint32_t rd, int32_t offset, uint32_t rs1) {
+    return (uint32_t(offset & 0xfff) << 20) | (rs1 << 15) | (3 << 12) | (rd << 7) | 0x03;
+}
+
+inline uint32_t sd(uint32_t rs2, int32_t offset, uint32_t rs1) {
+    return (uint32_t((offset >> 5) & 0x7f) << 25) | (rs2 << 20) | (rs1 << 15) | (3 << 12) |
+           (uint32_t(offset & 0x1f) << 7) | 0x23;
+}
+
+inline uint32_t jalr(uint32_t rd, int32_t offset, uint32_t rs1) {
+    return (uint32_t(offset & 0xfff) << 20) | (rs1 << 15) | (rd << 7) | 0x67;
+}
+
+// Branches take a byte offset from the branch itself
+inline uint32_t bne(uint32_t rs1, uint32_t rs2, int32_t offset) {
+    return (uint32_t((offset >> 12) & 1) << 31) | (uint32_t((offset >> 5) & 0x3f) << 25) |
+           (rs2 << 20) | (rs1 << 15) | (1 << 12) | (uint32_t((offset >> 1) & 0xf) << 8) |
+           (uint32_t((offset >> 11) & 1) << 7) | 0x63;
+}
+
+inline uint32_t beq(uint32_t rs1, uint32_t rs2, int32_t offset) {
+    return bne(rs1, rs2, offset) & ~(7u << 12);
+}
+
+inline uint32_t blt(uint32_t rs1, uint32_t rs2, int32_t offset) {
+    return (bne(rs1, rs2, offset) & ~(7u << 12)) | (4 << 12);
+}
+
+constexpr uint32_t ECALL = 0x73;
+
+// Write code as a static RV64 executable entered at its first instruction
+inline void writeGuest(const std::string& path, const std::vector<uint32_t>& code) {
+    constexpr uint64_t TEXT_OFFSET = 0x1000;
+    const uint64_t text_size = code.size() * sizeof(uint32_t);
+    std::vector<uint8_t> image(TEXT_OFFSET + text_size);
+    auto put = [&](size_t offset, auto value) {
+        std::memcpy(image.data() + offset, &value, sizeof(value));
+    };
+
+    // ELF header: 64-bit, little endian, EXEC, RISC-V, one program header
+    const uint8_t ident[16] = {0x7f, 'E', 'L', 'F', 2, 1, 1};
+    std::memcpy(image.data(), ident, sizeof(ident));
+    put(16, uint16_t(2));
+    put(18, uint16_t(0xf3));
+    put(20, uint32_t(1));
+    put(24, GUEST_BASE);
+    put(32, uint64_t(64));
+    put(52, uint16_t(64));
+    put(54, uint16_t(56));
+    put(56, uint16_t(1));
+
+    // PT_LOAD, RWX
+    put(64, uint32_t(1));
+    put(68, uint32_t(7));
+    put(72, TEXT_OFFSET);
+    put(80, GUEST_BASE);
+    put(88, GUEST_BASE);
+    put(96, text_size);
+    put(104, text_size);
+    put(112, uint64_t(0x1000));
+
+    std::memcpy(image.data() + TEXT_OFFSET, code.data(), text_size);
+    std::ofstream(path, std::ios::binary)
+        .write(reinterpret_cast<const char*>(image.data()), std::streamsize(image.size()));
+}
+
+inline std::string tempPath(const std::string& name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+// Load program into engine quietly, restored from a checkpoint if one is
+// given
+inline bool startGuest(Engine& engine, const std::string& program,
+                       const std::string& restore = "") {
+    std::string arg = program;
+    char* argv[] = {arg.data(), nullptr};
+    RegionOptions region;
+    region.restore = restore;
+    engine.setVerbose(false);
+    return engine.initialize(1, argv, region);
+}
+
+// How a guest run ended
+struct GuestRun {
+    int exit_code;
+    CpuState state;
+};
+
+// Run code to the end in one dispatch mode. setup runs on the engine
+// after loading, to register analysis calls.
+inline GuestRun runGuest(const std::vector<uint32_t>& code, DispatchMode mode,
+                         const std::function<void(Engine&)>& setup = {},
+                         size_t jit_cache_size = JitCompiler::DEFAULT_CACHE_SIZE) {
+    const std::string program = tempPath("rvpin_dispatch_guest");
+    writeGuest(program, code);
+    Engine engine;
+    engine.setDispatchMode(mode, jit_cache_size);
+    REQUIRE(startGuest(engine, program));
+    if (setup) {
+        setup(engine);
+    }
+    const int exit_code = engine.run();
+    std::remove(program.c_str());
+    return {exit_code, engine.getState()};
+}
+
+// Runs in two dispatch modes must agree on everything the guest can see
+inline void checkSameRun(const GuestRun& expected, const GuestRun& actual) {
+    CHECK(actual.exit_code == expected.exit_code);
+    CHECK(actual.state.pc == expected.state.pc);
+    CHECK(actual.state.instret == expected.state.instret);
+    for (int i = 0; i < 32; i++) {
+        INFO("x" << i);
+        CHECK(actual.state.x[i] == expected.state.x[i]);
+    }
+}
+
+// Grows the heap twice by amounts that are not whole pages, 100 and then
+// 5000 bytes, so both growths end mid-page. Leaves the initial break in
+// s0, 4096 in t0, the new break in a0 and SYS_BRK in a7.
+inline std::vector<uint32_t> growHeap() {
+    return {
+        addi(A7, ZERO, syscall::SYS_BRK), addi(A0, ZERO, 0), ECALL,
+        addi(S0, A0, 0),
+        addi(A0, S0, 100), ECALL,
+        lui(T0, 1), add(A0, S0, T0), addi(A0, A0, 904), ECALL,
+    };
+}
+
+} // namespace test
+} // namespace rvpin
@@ -0,0 +1,98 @@
+#include <catch2/catch.hpp>
+#include <cstdint>
+#include <vector>
+#include "core/engine.hpp"
+#include "guest.hpp"
+
+using namespace rvpin;
+using namespace rvpin::test;
+
+// Threaded code runs common pairs as one op (Interpreter::lower); it must
+// leave the guest exactly as stepping each instruction does.
+
+TEST_CASE("Threaded code matches stepping on every fused pair", "[interpreter]") {
+    // Four rounds with s1 counting down, so each compare-and-branch pair
+    // is taken in some rounds and not in others. Everything is summed
+    // into s0, the exit code.
+    const std::vector<uint32_t> code = {
+        addi(S1, ZERO, 4), addi(S0, ZERO, 0),
+        // lui + addi, lui + addiw wrapping past 32 bits
+        lui(T0, 0x12345), addi(T0, T0, 0x678), add(S0, S0, T0),
+        lui(T1, 0x80000), addiw(T1, T1, -1), add(S0, S0, T1),
+        // auipc + addi, ld and lw of the data words at the end
+        auipc(T2, 0), addi(T2, T2, 36), add(S0, S0, T2),
+        auipc(A1, 0), ld(A1, (40 - 11) * 4, A1), add(S0, S0, A1),
+        auipc(A2, 0), lw(A2, (42 - 14) * 4, A2), add(S0, S0, A2),
+        // slt, sltu, slti and sltiu, each followed by bnez or beqz
+        addi(A3, ZERO, 2),
+        slt(T0, S1, A3), bne(T0, ZERO, 8), addi(S0, S0, 100),
+        sltu(T0, A3, S1), beq(T0, ZERO, 8), addi(S0, S0, 200),
+        slti(T0, S1, 3), bne(T0, ZERO, 8), addi(S0, S0, 400),
+        sltiu(T0, S1, 2), beq(T0, ZERO, 8), addi(S0, S0, 800),
+        // auipc + jalr, a call over one instruction
+        auipc(RA, 0), jalr(RA, 12, RA), addi(S0, S0, 1600), add(S0, S0, RA),
+        addi(S1, S1, -1), bne(S1, ZERO, (2 - 35) * 4),
+        addi(A0, S0, 0), addi(A7, ZERO, syscall::SYS_EXIT), ECALL,
+        // Padding, then a doubleword and a negative word
+        0, 0x55667788, 0x11223344, 0x80000001,
+    };
+    const GuestRun expected = runGuest(code, DispatchMode::SWITCH);
+    const GuestRun actual = runGuest(code, DispatchMode::THREADED);
+    checkSameRun(expected, actual);
+    CHECK(expected.state.x[A1] == 0x1122334455667788ull);
+    CHECK(expected.state.x[A2] == 0xffffffff80000001ull);
+}
+
+TEST_CASE("Threaded code faults on the second half of a pair as stepping does", "[interpreter]") {
+    // auipc + ld of a megabyte past the code, which is unmapped
+    const std::vector<uint32_t> code = {
+        addi(S0, ZERO, 5), addi(S1, S0, 1),
+        auipc(A1, 0x100), ld(A1, 0, A1),
+        addi(A0, ZERO, 0), addi(A7, ZERO, syscall::SYS_EXIT), ECALL,
+    };
+    const GuestRun expected = runGuest(code, DispatchMode::SWITCH);
+    const GuestRun actual = runGuest(code, DispatchMode::THREADED);
+    checkSameRun(expected, actual);
+    CHECK(expected.exit_code == 1);
+    CHECK(expected.state.pc == GUEST_BASE + 3 * 4);
+    CHECK(expected.state.instret == 3);
+}
+
+TEST_CASE("Threaded code resyncs pc and instret where a block splits a pair", "[interpreter]") {
+    SECTION("branch into the second half") {
+        // The loop branches back to the addi of lui + addi, so its block
+        // starts mid-pair
+        const std::vector<uint32_t> code = {
+            addi(S1, ZERO, 3), addi(T1, ZERO, 0),
+            lui(T0, 1), addi(T0, T0, 5),
+            add(T1, T1, T0), addi(S1, S1, -1), bne(S1, ZERO, -12),
+            addi(A0, T1, 0), addi(A7, ZERO, syscall::SYS_EXIT), ECALL,
+        };
+        checkSameRun(runGuest(code, DispatchMode::SWITCH),
+                     runGuest(code, DispatchMode::THREADED));
+    }
+
+    SECTION("block size limit") {
+        // 255 instructions first, so the block ends after the lui
+        std::vector<uint32_t> code(255, addi(T2, T2, 1));
+        code.insert(code.end(), {
+            lui(T0, 1), addi(T0, T0, 5), add(A0, T0, T2),
+            addi(A7, ZERO, syscall::SYS_EXIT), ECALL,
+        });
+        checkSameRun(runGuest(code, DispatchMode::SWITCH),
+                     runGuest(code, DispatchMode::THREADED));
+    }
+
+    SECTION("phase ending between the halves") {
+        // Fast-forward stops after the lui; the run then starts at the addi
+        const std::vector<uint32_t> code = {
+            addi(T1, ZERO, 7), lui(T0, 1), addi(T0, T0, 5), add(A0, T0, T1),
+            addi(A7, ZERO, syscall::SYS_EXIT), ECALL,
+        };
+        auto stopAfterLui = [](Engine& engine) { REQUIRE(engine.fastForward(2)); };
+        const GuestRun expected = runGuest(code, DispatchMode::SWITCH, stopAfterLui);
+        const GuestRun actual = runGuest(code, DispatchMode::THREADED, stopAfterLui);
+        checkSameRun(expected, actual);
+        CHECK(expected.state.x[A0] == 0x1005 + 7);
+    }
+}
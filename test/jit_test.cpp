@@ -0,0 +1,105 @@
+#include <catch2/catch.hpp>
+#include <cstdint>
+#include <vector>
+#include "core/engine.hpp"
+#include "guest.hpp"
+
+using namespace rvpin;
+using namespace rvpin::test;
+
+// Compiled blocks must leave the guest exactly as the interpreter does.
+// Each guest runs its blocks well past the JIT threshold.
+
+namespace {
+
+// Sums a falling counter through a stack slot 1000 times and exits with
+// the low byte of the mix in t1
+std::vector<uint32_t> hotLoop() {
+    return {
+        addi(S1, ZERO, 1000), addi(T0, ZERO, 0), addi(T1, ZERO, 1),
+        add(T0, T0, S1),
+        sd(T0, -8, SP), ld(T2, -8, SP),
+        slli(T2, T2, 3), sub(T1, T2, T1),
+        addi(S1, S1, -1), bne(S1, ZERO, -24),
+        addi(A0, T1, 0), addi(A7, ZERO, syscall::SYS_EXIT), ECALL,
+    };
+}
+
+} // namespace
+
+TEST_CASE("JIT matches the interpreter on a hot loop", "[jit]") {
+    const GuestRun expected = runGuest(hotLoop(), DispatchMode::SWITCH);
+    const GuestRun actual = runGuest(hotLoop(), DispatchMode::JIT);
+    checkSameRun(expected, actual);
+    CHECK(expected.state.x[S1] == 0);
+}
+
+TEST_CASE("JIT stops on a faulting store where the interpreter does", "[jit]") {
+    // A writable page at 0x100000 with a read-only one above it. The loop
+    // stores through t1 a word at a time and faults on the store of its
+    // 513th round, in the middle of its block.
+    const std::vector<uint32_t> code = {
+        lui(A0, 0x100), lui(A1, 1), addi(A2, ZERO, 3), addi(A3, ZERO, 0x32),
+        addi(A4, ZERO, -1), addi(A5, ZERO, 0),
+        addi(A7, ZERO, syscall::SYS_MMAP), ECALL,
+        lui(A0, 0x101), addi(A2, ZERO, 1), ECALL,
+        lui(T1, 0x100), addi(S1, ZERO, 0),
+        addi(S1, S1, 1), sd(S1, 0, T1), addi(T1, T1, 8), bne(S1, ZERO, -12),
+    };
+    const GuestRun expected = runGuest(code, DispatchMode::SWITCH);
+    const GuestRun actual = runGuest(code, DispatchMode::JIT);
+    checkSameRun(expected, actual);
+    CHECK(expected.exit_code == 1);
+    CHECK(expected.state.x[S1] == 513);
+    CHECK(expected.state.pc == GUEST_BASE + 14 * 4);
+}
+
+TEST_CASE("JIT runs inserted analysis calls as the interpreter does", "[jit]") {
+    struct Counts {
+        uint64_t before = 0;
+        uint64_t after = 0;
+        uint64_t stores = 0;
+        uint64_t addresses = 0;
+    };
+    auto run = [](DispatchMode mode, Counts& counts) {
+        return runGuest(hotLoop(), mode, [&](Engine& engine) {
+            engine.registerBeforeInstruction([&](const Instruction&) { counts.before++; });
+            engine.registerAfterInstruction([&](const Instruction&) { counts.after++; });
+            engine.registerMemoryAccess([&](uint64_t addr, bool is_write, uint32_t) {
+                counts.stores += is_write;
+                counts.addresses += addr;
+            });
+        });
+    };
+    Counts expected_counts;
+    Counts actual_counts;
+    const GuestRun expected = run(DispatchMode::SWITCH, expected_counts);
+    const GuestRun actual = run(DispatchMode::JIT, actual_counts);
+    checkSameRun(expected, actual);
+    CHECK(actual_counts.before == expected_counts.before);
+    CHECK(actual_counts.after == expected_counts.after);
+    CHECK(actual_counts.stores == expected_counts.stores);
+    CHECK(actual_counts.addresses == expected_counts.addresses);
+    CHECK(expected_counts.stores == 1000);
+}
+
+TEST_CASE("JIT survives a cache too small for its hot blocks", "[jit]") {
+    // Eight blocks, each ended by an always-taken branch, run in turn 300
+    // times. A 1 KiB cache cannot hold them all, so compiling one flushes
+    // the others and they are compiled again on their way round.
+    std::vector<uint32_t> code = {addi(S1, ZERO, 300), addi(T0, ZERO, 0), addi(T1, ZERO, 7)};
+    for (int32_t i = 1; i <= 8; i++) {
+        code.insert(code.end(), {
+            addi(T0, T0, i), add(T1, T1, T0), slli(T2, T1, i), sub(T1, T2, T1),
+            sd(T1, -8 * i, SP), ld(T2, -8 * i, SP), add(T0, T0, T2),
+            beq(ZERO, ZERO, 4),
+        });
+    }
+    code.insert(code.end(), {
+        addi(S1, S1, -1), bne(S1, ZERO, -8 * 8 * 4 - 4),
+        addi(A0, T0, 0), addi(A7, ZERO, syscall::SYS_EXIT), ECALL,
+    });
+    const GuestRun expected = runGuest(code, DispatchMode::SWITCH);
+    const GuestRun actual = runGuest(code, DispatchMode::JIT, {}, 1024);
+    checkSameRun(expected, actual);
+}
@@ -0,0 +1,127 @@
+#include <catch2/catch.hpp>
+#include <cstdint>
+#include <vector>
+#include "core/memory.hpp"
+
+using namespace rvpin;
+
+// Memory on its own, with no program loaded
+
+namespace {
+
+constexpr uint64_t TEXT = 0x10000;
+constexpr uint64_t DATA = 0x20000;
+constexpr uint64_t PAGE = Memory::PAGE_SIZE;
+
+const Memory::TlbEntry& tlbEntry(const Memory& memory, MemoryAccess access, uint64_t addr) {
+    const uint64_t page_number = addr >> Memory::PAGE_SHIFT;
+    return memory.getTlb(access)[page_number % Memory::TLB_ENTRIES];
+}
+
+} // namespace
+
+TEST_CASE("Stores to read-only .text fault", "[memory]") {
+    Memory memory;
+    memory.map(TEXT, PAGE, Memory::READABLE | Memory::EXECUTABLE);
+    const uint32_t nop = 0x13;
+    memory.fill(TEXT, &nop, sizeof(nop));
+
+    CHECK(memory.load<uint32_t>(TEXT) == nop);
+    CHECK(memory.fetch(TEXT) == nop);
+    try {
+        memory.store<uint32_t>(TEXT + 4, 0);
+        FAIL("store to .text did not fault");
+    } catch (const MemoryFault& e) {
+        CHECK(e.getAddress() == TEXT + 4);
+        CHECK(e.isWrite());
+        CHECK(e.isProtectionFault());
+    }
+    CHECK(memory.viewMutable(TEXT, 4) == nullptr);
+    CHECK(memory.getDirtyPages().empty());
+}
+
+TEST_CASE("Unmap and protect flush the TLBs", "[memory]") {
+    Memory memory;
+    memory.map(DATA, 2 * PAGE);
+    memory.store<uint64_t>(DATA, 1);
+    memory.store<uint64_t>(DATA + PAGE, 2);
+    CHECK(memory.load<uint64_t>(DATA + PAGE) == 2);
+    REQUIRE(tlbEntry(memory, MemoryAccess::WRITE, DATA).page_number ==
+            DATA >> Memory::PAGE_SHIFT);
+    REQUIRE(tlbEntry(memory, MemoryAccess::READ, DATA + PAGE).page_number ==
+            (DATA + PAGE) >> Memory::PAGE_SHIFT);
+
+    SECTION("protect") {
+        memory.protect(DATA, PAGE, Memory::READABLE);
+        CHECK(tlbEntry(memory, MemoryAccess::WRITE, DATA).page_number !=
+              DATA >> Memory::PAGE_SHIFT);
+        CHECK_THROWS_AS(memory.store<uint64_t>(DATA, 3), MemoryFault);
+        CHECK(memory.load<uint64_t>(DATA) == 1);
+
+        // The page next to it keeps its permissions
+        memory.store<uint64_t>(DATA + PAGE, 4);
+        CHECK(memory.load<uint64_t>(DATA + PAGE) == 4);
+    }
+
+    SECTION("unmap") {
+        memory.unmap(DATA + PAGE, PAGE);
+        CHECK(tlbEntry(memory, MemoryAccess::READ, DATA + PAGE).page_number !=
+              (DATA + PAGE) >> Memory::PAGE_SHIFT);
+        CHECK_THROWS_AS(memory.load<uint64_t>(DATA + PAGE), MemoryFault);
+        CHECK_THROWS_AS(memory.store<uint64_t>(DATA + PAGE, 5), MemoryFault);
+        CHECK(memory.load<uint64_t>(DATA) == 1);
+
+        // Mapped again, the page is fresh
+        memory.map(DATA + PAGE, PAGE);
+        CHECK(memory.load<uint64_t>(DATA + PAGE) == 0);
+    }
+}
+
+TEST_CASE("Mutable views mark their pages dirty", "[memory]") {
+    Memory memory;
+    memory.map(DATA, 4 * PAGE);
+    CHECK(memory.view(DATA, 2 * PAGE) != nullptr);
+    CHECK(memory.getDirtyPages().empty());
+
+    // Two bytes either side of the boundary between the second and third
+    // pages
+    uint8_t* host = memory.viewMutable(DATA + 2 * PAGE - 2, 4);
+    REQUIRE(host != nullptr);
+    CHECK(memory.getDirtyPages() == std::vector<uint64_t>{DATA + PAGE, DATA + 2 * PAGE});
+
+    memory.store<uint8_t>(DATA + 3 * PAGE, 1);
+    CHECK(memory.getDirtyPages() ==
+          std::vector<uint64_t>{DATA + PAGE, DATA + 2 * PAGE, DATA + 3 * PAGE});
+}
+
+TEST_CASE("Accesses crossing a page boundary", "[memory]") {
+    Memory memory;
+    memory.map(DATA, 2 * PAGE);
+    const uint64_t addr = DATA + PAGE - 3;
+
+    memory.store<uint64_t>(addr, 0x1122334455667788ull);
+    CHECK(memory.load<uint64_t>(addr) == 0x1122334455667788ull);
+    CHECK(memory.load<uint32_t>(DATA + PAGE) == 0x22334455);
+    CHECK(memory.load<uint8_t>(DATA + PAGE - 1) == 0x66);
+
+    uint8_t bytes[8];
+    memory.read(addr, bytes, sizeof(bytes));
+    CHECK(bytes[0] == 0x88);
+    CHECK(bytes[7] == 0x11);
+
+    // A view is one host range, which both pages are part of
+    const uint8_t* host = memory.view(addr, 8);
+    REQUIRE(host != nullptr);
+    CHECK(host[7] == 0x11);
+
+    // Running off the end faults on the unmapped page
+    try {
+        memory.store<uint64_t>(DATA + 2 * PAGE - 4, 0);
+        FAIL("store past the mapping did not fault");
+    } catch (const MemoryFault& e) {
+        CHECK(e.getAddress() == DATA + 2 * PAGE);
+        CHECK_FALSE(e.isProtectionFault());
+    }
+    CHECK_THROWS_AS(memory.load<uint64_t>(DATA + 2 * PAGE - 4), MemoryFault);
+    CHECK(memory.view(DATA + 2 * PAGE - 4, 8) == nullptr);
+}
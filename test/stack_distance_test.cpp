@@ -0,0 +1,74 @@
+#include <catch2/catch.hpp>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "tools/cache_sim.hpp"
+#include "tools/stack_distance.hpp"
+
+using namespace rvpin::tools;
+
+namespace {
+
+struct Access {
+    uint64_t addr;
+    bool is_write;
+};
+
+// Random trace over footprint bytes: mostly reuse of a small hot region,
+// so every associativity sees both hits and misses, plus a cold tail
+std::vector<Access> randomTrace(uint64_t seed, size_t length, uint64_t footprint) {
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<uint64_t> anywhere(0, footprint - 1);
+    std::uniform_int_distribution<uint64_t> hot(0, footprint / 16);
+    std::bernoulli_distribution pick_hot(0.7);
+    std::bernoulli_distribution pick_write(0.3);
+    std::vector<Access> trace(length);
+    for (Access& access : trace) {
+        access.addr = (pick_hot(rng) ? hot(rng) : anywhere(rng)) & ~uint64_t(7);
+        access.is_write = pick_write(rng);
+    }
+    return trace;
+}
+
+} // namespace
+
+TEST_CASE("Stack distances give the stats of an LRU cache of every geometry",
+          "[stack_distance]") {
+    StackDistanceConfig config;
+    config.line_size = 64;
+    config.min_sets = 1;
+    config.max_sets = 128;
+    config.max_associativity = 12;
+
+    // Footprints from well inside the smallest cache to well past the
+    // largest, 128 sets x 12 ways x 64 bytes
+    const uint64_t footprints[] = {1 << 10, 1 << 16, 1 << 20};
+    uint64_t seed = 1;
+    for (uint64_t footprint : footprints) {
+        const std::vector<Access> trace = randomTrace(seed++, 50000, footprint);
+        StackDistanceProfiler profiler(config);
+        for (const Access& access : trace) {
+            profiler.access(access.addr, access.is_write);
+        }
+
+        for (uint32_t sets : profiler.getSetCounts()) {
+            for (uint32_t ways = 1; ways <= config.max_associativity; ways++) {
+                INFO("footprint " << footprint << ", " << sets << " sets, " << ways << " ways");
+                BasicCache<LruPolicy> cache(profiler.getCacheConfig(sets, ways));
+                for (const Access& access : trace) {
+                    cache.access(0, access.addr, access.is_write, 8);
+                }
+
+                const CacheStats& expected = cache.getStats();
+                const CacheStats actual = profiler.getStats(sets, ways);
+                CHECK(actual.reads == expected.reads);
+                CHECK(actual.writes == expected.writes);
+                CHECK(actual.read_hits == expected.read_hits);
+                CHECK(actual.write_hits == expected.write_hits);
+                CHECK(actual.read_misses == expected.read_misses);
+                CHECK(actual.write_misses == expected.write_misses);
+                CHECK(actual.evictions == expected.evictions);
+            }
+        }
+    }
+}
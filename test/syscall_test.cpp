@@ -0,0 +1,83 @@
+#include <catch2/catch.hpp>
+#include <cerrno>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "core/engine.hpp"
+#include "guest.hpp"
+
+using namespace rvpin;
+using namespace rvpin::test;
+
+TEST_CASE("brk maps whole pages and refuses what it cannot give", "[syscall]") {
+    // Grow the heap by a part page twice, then ask for an address past
+    // the address space; exit with 1 if the break stayed put
+    std::vector<uint32_t> code = growHeap();
+    code.insert(code.end(), {
+        addi(S1, A0, 0),
+        addi(A0, ZERO, -1), ECALL,
+        sub(A0, A0, S1), addi(A0, A0, 1),
+        addi(A7, ZERO, syscall::SYS_EXIT), ECALL,
+    });
+    const std::string program = tempPath("rvpin_brk_limit_guest");
+    writeGuest(program, code);
+
+    Engine engine;
+    REQUIRE(startGuest(engine, program));
+    CHECK(engine.run() == 1);
+
+    // The two part-page requests share a page rather than mapping it twice
+    std::vector<Memory::Range> ranges = engine.getMemory().getMappedRanges();
+    for (size_t i = 0; i < ranges.size(); i++) {
+        for (size_t j = i + 1; j < ranges.size(); j++) {
+            CHECK((ranges[i].end <= ranges[j].start || ranges[j].end <= ranges[i].start));
+        }
+    }
+    std::remove(program.c_str());
+}
+
+TEST_CASE("mmap refuses fixed mappings outside the address space", "[syscall]") {
+    // mmap(1 << 40, 4096, PROT_READ | PROT_WRITE,
+    //      MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0), exit with -a0
+    const std::vector<uint32_t> code = {
+        addi(A0, ZERO, 1), slli(A0, A0, 40),
+        lui(A1, 1), addi(A2, ZERO, 3), addi(A3, ZERO, 0x32),
+        addi(A4, ZERO, -1), addi(A5, ZERO, 0),
+        addi(A7, ZERO, syscall::SYS_MMAP), ECALL,
+        sub(A0, ZERO, A0),
+        addi(A7, ZERO, syscall::SYS_EXIT), ECALL,
+    };
+    const std::string program = tempPath("rvpin_mmap_fixed_guest");
+    writeGuest(program, code);
+
+    Engine engine;
+    REQUIRE(startGuest(engine, program));
+    CHECK(engine.run() == ENOMEM);
+    std::remove(program.c_str());
+}
+
+TEST_CASE("munmap hands address space back for reuse", "[syscall]") {
+    // Map, touch and unmap 64 GiB 4096 times: more than the guest's
+    // mmap area, or the host's, could hold without reuse. Exit with 1
+    // if an mmap fails.
+    const std::vector<uint32_t> code = {
+        lui(S1, 1),
+        addi(A0, ZERO, 0), addi(A1, ZERO, 1), slli(A1, A1, 36),
+        addi(A2, ZERO, 3), addi(A3, ZERO, 0x22), addi(A4, ZERO, -1), addi(A5, ZERO, 0),
+        addi(A7, ZERO, syscall::SYS_MMAP), ECALL,
+        blt(A0, ZERO, 44),
+        sd(S1, 0, A0),
+        addi(A1, ZERO, 1), slli(A1, A1, 36),
+        addi(A7, ZERO, syscall::SYS_MUNMAP), ECALL,
+        addi(S1, S1, -1), bne(S1, ZERO, -64),
+        addi(A0, ZERO, 0), addi(A7, ZERO, syscall::SYS_EXIT), ECALL,
+        addi(A0, ZERO, 1), addi(A7, ZERO, syscall::SYS_EXIT), ECALL,
+    };
+    const std::string program = tempPath("rvpin_munmap_reuse_guest");
+    writeGuest(program, code);
+
+    Engine engine;
+    REQUIRE(startGuest(engine, program));
+    CHECK(engine.run() == 0);
+    std::remove(program.c_str());
+}